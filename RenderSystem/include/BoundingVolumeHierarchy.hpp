@@ -0,0 +1,40 @@
+#ifndef BOUNDING_VOLUME_HIERARCHY_HPP
+#define BOUNDING_VOLUME_HIERARCHY_HPP
+#include<SimdMath.hpp>
+#include<cstdint>
+#include<vector>
+
+class BoundingVolumeHierarchy       // binary tree over boxes, built with a binned surface area heuristic
+{
+public:
+    BoundingVolumeHierarchy();
+    void build(const std::vector<BoundingVolume>& volumes);
+    void refit(const std::vector<BoundingVolume>& volumes);     // same primitives in the same order, only their bounds changed; the topology is kept
+    void cull(const glm::vec4* planes, uint8_t* visible, std::vector<uint32_t>& pendingNodes) const;     // visible[primitive] is 1 if its box intersects the frustum; pendingNodes is the caller's scratch, so queries can run concurrently without allocating
+    const uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance, std::vector<uint32_t>& pendingNodes) const;   // closest primitive box hit, ~0U if none; distance in direction lengths
+    const uint32_t getPrimitiveCount() const;
+    void clear();
+    ~BoundingVolumeHierarchy();
+private:
+    struct TreeNode
+    {
+        glm::vec3 min;
+        glm::vec3 max;
+        uint32_t firstPrimitive;    // subtrees cover contiguous ranges of the leaf order
+        uint32_t primitiveCount;
+        uint32_t leftChild;         // right child follows it, 0 for leaves
+    };
+    static const uint32_t MAX_LEAF_SIZE = 4;
+    static const uint32_t BIN_COUNT = 12;
+    static const uint32_t BATCH_SIZE = 32;     // intersecting subtrees this small are tested box by box
+    const bool split(const uint32_t nodeIndex, const std::vector<BoundingVolume>& volumes);    // false if the node stays a leaf
+    void computeNodeBounds(TreeNode& node, const std::vector<BoundingVolume>& volumes) const;
+    void storeLeafOrderBounds(const std::vector<BoundingVolume>& volumes);
+    static const bool intersectBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection, const float maxDistance, float& entry);
+    std::vector<TreeNode> nodes;
+    std::vector<uint32_t> primitives;      // leaf order -> primitive
+    std::vector<float> centers[3];         // of the primitives in leaf order, one array per axis
+    std::vector<float> extents[3];
+};
+
+#endif
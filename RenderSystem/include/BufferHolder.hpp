@@ -7,6 +7,15 @@ class BufferHolder
 {
 public:
     BufferHolder();
+    static void recordOwnershipTransferCommands(const VkCommandBuffer& cmd, 
+        const VkBuffer& buffer, 
+        const VkDeviceSize offset, 
+        const VkDeviceSize size, 
+        const uint32_t srcQueueFamily, 
+        const uint32_t dstQueueFamily, 
+        const VkAccessFlags access,         // writes being released or reads being acquired
+        const VkPipelineStageFlags stages,
+        const bool release);                // release is recorded on the source queue, acquire on the destination one
     void create(const System* system);
     void addBuffers(const uint32_t count);
     void initBuffer(const uint32_t index, const VkDeviceSize size, const VkBufferUsageFlags usage);
@@ -14,7 +23,7 @@ public:
     const size_t getCurrentBufferCount() const;
     void destroyBuffer(const uint32_t index);
     const VkMemoryRequirements getMemoryRequirements(const uint32_t index);
-    void bindMemory(const VkDeviceMemory& memory, const uint32_t offset, const uint32_t bufferIndex);
+    void bindMemory(const VkDeviceMemory& memory, const VkDeviceSize offset, const uint32_t bufferIndex);
     const VkBuffer& operator[](const uint32_t index) const;
     VkBuffer& operator[](const uint32_t index);
     void destroy();
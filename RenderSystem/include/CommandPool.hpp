@@ -8,7 +8,7 @@ class CommandPool
 public:
     CommandPool();
     const VkCommandPool& getPool() const;
-    void create(const System* system, const bool dynamicPool = false);
+    void create(const System* system, const bool dynamicPool = false, const uint32_t queueFamilyIndex = ~0U);  // graphics family by default
     void addCommandBuffers(uint32_t count);
     const size_t getCurrentPoolSize() const;
     void allocateCommandBuffers(const uint32_t first, const uint32_t count, const VkCommandBufferLevel level);
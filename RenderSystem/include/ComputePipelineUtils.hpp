@@ -0,0 +1,19 @@
+#ifndef COMPUTE_PIPELINE_UTILS_HPP
+#define COMPUTE_PIPELINE_UTILS_HPP
+#include<System.hpp>
+
+class ComputePipelinePool
+{
+public:
+    ComputePipelinePool();
+    void create(const System* system, const uint32_t pipelineCount);
+    void createPipeline(const uint32_t index, const ShaderStageInfo& shader, const VkPipelineLayout& layout, const VkPipelineCache& cache = VkPipelineCache());
+    const VkPipeline& operator[](const uint32_t index) const;
+    void destroy();
+    ~ComputePipelinePool();
+private:
+    const System* system;
+    Array<VkPipeline> pipelines;
+};
+
+#endif
\ No newline at end of file
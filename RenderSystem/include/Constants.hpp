@@ -6,6 +6,12 @@
 #define MAX_IMAGE_DIMENSION 2048
 #define MAX_TEXTURE_COUNT 10
 #define MAX_UNIFORM_COUNT 15
+#define STAGING_FRAME_COUNT 3
+#define MAX_INSTANCE_COUNT 1024
+#define MAX_COMPUTE_SET_COUNT 4
+#define COMPUTE_STORAGE_BINDING_COUNT 3
+#define COMPUTE_PUSH_CONSTANT_SIZE 128      // the smallest maxPushConstantsSize a device may have
+#define MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
 
 enum DrawableType
 {
@@ -8,7 +8,7 @@ public:
     DescriptorLayoutHolder();
     void create(const System* system, const uint32_t setLayoutCount, const uint32_t pipelineLayoutCount);
     void createSetLayout(const uint32_t index, const Array<VkDescriptorSetLayoutBinding>& bindings);
-    void createPipelineLayout(const uint32_t index, const Array<uint32_t>& setLayoutIndices);
+    void createPipelineLayout(const uint32_t index, const Array<uint32_t>& setLayoutIndices, const Array<VkPushConstantRange>& pushConstantRanges = Array<VkPushConstantRange>());
     const VkPipelineLayout& getPipelineLayout(const uint32_t index) const;
     const VkDescriptorSetLayout& getSetLayout(const uint32_t index) const;
     void destroy();
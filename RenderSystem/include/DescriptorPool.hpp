@@ -6,8 +6,9 @@ class DescriptorPool
 {
 public:
     DescriptorPool();
-    void create(const System* system, const uint32_t setCount, const Array<VkDescriptorPoolSize>& poolSizes);
+    void create(const System* system, const uint32_t setCount, const Array<VkDescriptorPoolSize>& poolSizes, const VkDescriptorPoolCreateFlags flags = 0);
     void allocateSets(const uint32_t first, const Array<VkDescriptorSetLayout>& layouts);
+    void freeSets(const uint32_t first, const uint32_t count = 1);     // the pool must be created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
     void updateImage(const VkDescriptorImageInfo& info, const VkDescriptorType type, const uint32_t set, const uint32_t binding, const uint32_t arrayElement = 0, const uint32_t descriptorCount = 1);
     void updateBuffer(const VkDescriptorBufferInfo& info, const VkDescriptorType type, const uint32_t set, const uint32_t binding, const uint32_t arrayElement = 0, const uint32_t descriptorCount = 1);
     const VkDescriptorSet& operator[](const uint32_t index) const;
@@ -26,6 +27,7 @@ struct DescriptorInfo
     uint32_t setIndex;
     uint32_t binding;
     uint32_t arrayElement;
+    uint32_t dynamicOffset;     // passed when binding the set, 0 for sets without dynamic descriptors
 };
 
 #endif
\ No newline at end of file
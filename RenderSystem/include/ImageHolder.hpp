@@ -8,6 +8,15 @@ class ImageHolder
 public:
     ImageHolder();
     static void recordLayoutChangeCommands(const VkCommandBuffer& cmd, const VkImageLayout oldLayout, const VkImageLayout newLayout, const VkImage& img, const VkImageSubresourceRange& subresource);
+    static void recordOwnershipTransferCommands(const VkCommandBuffer& cmd, 
+        const VkImage& img, 
+        const VkImageLayout layout, 
+        const VkImageSubresourceRange& subresource, 
+        const uint32_t srcQueueFamily, 
+        const uint32_t dstQueueFamily, 
+        const VkAccessFlags access,         // writes being released or reads being acquired
+        const VkPipelineStageFlags stages,
+        const bool release);                // release is recorded on the source queue, acquire on the destination one
     static void recordMipmapGenCommands(const VkCommandBuffer& cmd, const VkImageLayout oldLayout, const VkImageLayout newLayout, const VkImage& img, const VkExtent2D& imageExtent, const uint32_t mipmapLevelCount, const VkImageLayout mipmapImageLayout = VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED); // first mipmap image must have oldLayout layout, and other mipmap images must have Undefined layout
     void create(const System* system);
     bool checkFormatSupport(const VkFormat format, const VkFormatFeatureFlags features, const VkImageTiling tiling = VkImageTiling::VK_IMAGE_TILING_OPTIMAL) const;
@@ -20,7 +29,7 @@ public:
         const VkFormat format, 
         const VkExtent3D& extent, 
         const bool enableMipmapping,
-        uint32_t& mipmapLevels,                 // if mipmapping is enabled, rewrites with mipmap level count
+        uint32_t& mipmapLevels,                 // if mipmapping is enabled, rewrites with mipmap level count, nonzero counts are only clamped to the format limit
         const VkSampleCountFlagBits samples,
         const VkImageTiling tiling, 
         const VkImageUsageFlags usage);
@@ -33,7 +42,7 @@ public:
     void destroyView(const uint32_t index);
     void destroySampler(const uint32_t index);
     const VkMemoryRequirements getMemoryRequirements(const uint32_t imageIndex) const;
-    void bindMemory(const VkDeviceMemory& memory, const uint32_t offset, const uint32_t imageIndex) const;
+    void bindMemory(const VkDeviceMemory& memory, const VkDeviceSize offset, const uint32_t imageIndex) const;
     const VkImage& getImage(const uint32_t index) const;
     const VkImageView& getView(const uint32_t index) const;
     const VkSampler& getSampler(const uint32_t index) const;
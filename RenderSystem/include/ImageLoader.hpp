@@ -1,6 +1,8 @@
 #ifndef IMAGE_LOADER_HPP
 #define IMAGE_LOADER_HPP
+#include<MappedFile.hpp>
 #include<Utils.hpp>
+#include<vector>
 
 class ImageLoader
 {
@@ -9,7 +11,10 @@ public:
     {
     public:
         Image();
-        void load(const char* filename, int forcedChannels = 0);        // 0 channels -> auto-check
+        void load(const char* filename, int forcedChannels = 0);        // 0 channels -> auto-check, decoded from a mapping of the file
+        void generateMipmaps(const VkFormat format, const bool normalMap = false);  // replaces decoded RGBA pixels with a filtered mipmap chain, block compressed unless the format is R8G8B8A8_UNORM
+        const bool loadMipmaps(const char* filename, const char* sourceFilename, const VkFormat format, const bool normalMap = false);     // false if the cache file is missing or was made from another source, format or version; the levels stay in the mapped file
+        void saveMipmaps(const char* filename, const char* sourceFilename) const;
         Image& operator=(Image&& img);
         Image& operator=(const Image& img) = delete;
         Image& operator=(Image& img) = delete;
@@ -17,6 +22,10 @@ public:
         const unsigned char* getData() const;
         const VkExtent2D getExtent() const;
         const uint32_t getChannelCount() const;
+        const VkFormat getFormat() const;           // undefined for decoded pixels without mipmaps
+        const uint32_t getLevelCount() const;       // mipmap levels in the data, 1 for decoded pixels without mipmaps
+        const size_t getLevelOffset(const uint32_t level) const;
+        const size_t getSize() const;               // of all levels
         void unload();
         ~Image();
     private:
@@ -24,6 +33,13 @@ public:
         int height;
         int channels;
         unsigned char* data = nullptr;
+        VkFormat format = VkFormat::VK_FORMAT_UNDEFINED;
+        bool normalMap = false;
+        std::vector<unsigned char> levelData;
+        MappedFile cacheFile;
+        const unsigned char* cachedLevelData = nullptr;   // points into cacheFile when the levels came from a cache
+        size_t cachedLevelSize = 0;
+        std::vector<size_t> levelOffsets;
     };
     ImageLoader();
     void create(const uint32_t maxImageCount);
@@ -0,0 +1,26 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+#include<cstddef>
+#include<cstdint>
+
+class MappedFile        // read-only view of a whole file, pages are read in by the kernel when they are first touched
+{
+public:
+    MappedFile();
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    MappedFile& operator=(MappedFile&& other);
+    const bool open(const char* filename);      // false if the file is missing, empty or can't be mapped
+    const unsigned char* getData() const;
+    const size_t getSize() const;
+    const bool isOpen() const;
+    void close();
+    static const bool getStamp(const char* filename, uint64_t& size, int64_t& modificationTime);     // what cache files record of their source, false if it can't be read
+    static const uint64_t hashData(const void* data, const size_t size, const uint64_t hash = 14695981039346656037ull);     // FNV-1a, pass a previous result to continue it
+    ~MappedFile();
+private:
+    unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+#endif
\ No newline at end of file
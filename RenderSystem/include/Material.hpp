@@ -2,6 +2,7 @@
 #define MATERIAL_HPP
 #include<Constants.hpp>
 #include<optional>
+#include<ostream>
 #include<string>
 #include<Utils.hpp>
 #include<ImageHolder.hpp>
@@ -14,11 +15,26 @@ class Material
 public:
     enum Descriptors{Colors, Texture, NormalMap};
     Material();
-    void create(ObjectManagementStrategy* allocator, const aiMaterial* mat, const std::string& pathToTextures = "");
+    void load(const aiMaterial* mat, 
+        const std::string& pathToTextures = "", 
+        const VkFormat textureFormat = VkFormat::VK_FORMAT_UNDEFINED,      // textures of a defined format get their mipmaps on the CPU, undefined ones get them blitted
+        const VkFormat normalMapFormat = VkFormat::VK_FORMAT_UNDEFINED, 
+        const bool cacheMipmaps = false);               // reads colors and texture paths, doesn't decode images
+    const bool loadCache(const unsigned char* data, const size_t size, size_t& offset, 
+        const std::string& pathToTextures = "", 
+        const VkFormat textureFormat = VkFormat::VK_FORMAT_UNDEFINED, 
+        const VkFormat normalMapFormat = VkFormat::VK_FORMAT_UNDEFINED, 
+        const bool cacheMipmaps = false);               // instead of load(), false if the record doesn't fit the data
+    void saveCache(std::ostream& stream) const;         // after load(), writes what loadCache() reads back
+    static const size_t getMinimumCacheSize();          // bytes of the smallest record loadCache() accepts
+    void loadImages();                                  // decodes textures and builds their mipmaps or loads them from the cache, safe to call from a worker thread
+    void create(ObjectManagementStrategy* allocator);   // registers GPU resources, must be called on the allocator's thread after loadImages()
+    void reloadImages();                                // after create(), decodes the textures again and replaces their images, uploaded on the allocator's next update()
     const DrawableType getType() const;
     const ImageLoader::Image& getTextureImage() const;
     const ImageLoader::Image& getNormalMapImage() const;
     const Array<DescriptorInfo>& getDescriptorInfos() const;
+    const uint32_t getCachedImageCount() const;         // images loadImages() took from the mipmap cache
     void clearExtraResources();
     void destroy();
     ~Material();
@@ -33,13 +49,31 @@ private:
     {
         std::optional<ImageLoader::Image> texture;
         std::optional<ImageLoader::Image> normalMap;
+        std::string pathToTextures;
+        std::string textureName;        // as the scene file names them
+        std::string normalMapName;
+        VkFormat textureFormat;
+        VkFormat normalMapFormat;
+        bool cacheMipmaps;
     } tempImages;
 
+    struct CacheRecord      // followed by the texture and normal map names
+    {
+        struct Colors colors;       // the enumerator of the same name hides the type
+        uint32_t hasTexture;
+        uint32_t hasNormalMap;
+        uint32_t textureNameLength;
+        uint32_t normalMapNameLength;
+    };
+    void setTextures(const std::string& pathToTextures, const VkFormat textureFormat, const VkFormat normalMapFormat, const bool cacheMipmaps);     // picks the type once colors and texture names are set
+    void loadImage(ImageLoader::Image& image, const std::string& path, const VkFormat format, const bool normalMap);
+    void createImages();
     const bool hasTexture() const;
     const bool hasNormalMap() const;
 
-    ObjectManagementStrategy* allocator;
+    ObjectManagementStrategy* allocator = nullptr;
     DrawableType type;
+    uint32_t cachedImageCount = 0;
     Array<DescriptorInfo> descriptorInfos;
     BufferInfo colorsBuffer;
     SampledImageInfo texture;
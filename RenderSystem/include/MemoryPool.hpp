@@ -1,27 +1,68 @@
 #ifndef MEMORY_POOL_HPP
 #define MEMORY_POOL_HPP
 #include<System.hpp>
+#include<Constants.hpp>
+#include<map>
+#include<vector>
+
+struct MemoryAllocation
+{
+    uint32_t heapIndex;         // memory type * 2 + linearity
+    uint32_t blockIndex;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+};
 
 class MemoryPool
 {
 public:
+    struct Statistics           // of one heap, free ranges of different heaps can't serve each other's allocations
+    {
+        uint32_t memoryType;
+        bool linear;                    // the heap of buffers and linear images
+        uint32_t blockCount;
+        uint32_t allocationCount;
+        VkDeviceSize allocatedBytes;    // sum of block sizes
+        VkDeviceSize usedBytes;
+        VkDeviceSize largestFreeRange;
+        float fragmentation;            // 0 when all free space is contiguous, close to 1 when it is scattered in small ranges
+    };
+
     MemoryPool();
-    void create(const System* system, const uint32_t memoryObjectCount);
-    const VkDeviceMemory& operator[](const uint32_t index) const;
-    VkDeviceMemory& operator[](const uint32_t index);
-    Array<uint32_t> allocate(const uint32_t memoryObjectIndex, const VkMemoryPropertyFlags property, const Array<VkMemoryRequirements>& group);   // returns offsets
-    void allocate(const uint32_t memoryObjectIndex, const VkMemoryPropertyFlags property, const VkMemoryRequirements& mem);
-    void* map(const uint32_t memoryObjectIndex, const VkDeviceSize offset, const VkDeviceSize size);
-    void flush(const uint32_t memoryObjectIndex, const VkDeviceSize offset, const VkDeviceSize size);
-    void unmap(const uint32_t memoryObjectIndex);
+    void create(const System* system, const VkDeviceSize blockSize = MEMORY_BLOCK_SIZE);
+    const MemoryAllocation allocate(const VkMemoryPropertyFlags property, const VkMemoryRequirements& requirements, const bool linear);   // linear is true for buffers and linear images
+    void free(const MemoryAllocation& allocation);
+    const VkDeviceMemory& getMemory(const MemoryAllocation& allocation) const;
+    void* map(const MemoryAllocation& allocation);     // blocks stay mapped until they are freed
+    void flush(const MemoryAllocation& allocation, const VkDeviceSize offset, const VkDeviceSize size);
+    const std::vector<Statistics> getStatistics() const;     // heaps without blocks are left out
     static void align(uint32_t& size, const uint32_t alignment);
     static void align(uint32_t& alignment1, uint32_t& alignment2);
     static const uint32_t align(const uint32_t alignment1, const uint32_t alignment2);
     void destroy();
     ~MemoryPool();
 private:
-    Array<VkDeviceMemory> memory;
+    struct Block
+    {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        VkDeviceSize usedSize;
+        uint32_t allocationCount;
+        bool dedicated;                                     // holds a single resource larger than a regular block
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;    // offset -> size
+        void* mapped;
+    };
+
+    const uint32_t findMemoryType(const uint32_t memoryTypeBits, const VkMemoryPropertyFlags property) const;
+    const bool allocateFromBlock(Block& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset);
+    const uint32_t addBlock(const uint32_t heapIndex, const VkDeviceSize size);
+    void freeBlock(Block& block);
+
     const System* system;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize blockSize;
+    VkDeviceSize nonCoherentAtomSize;
+    std::vector<std::vector<Block>> heaps;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -8,33 +8,115 @@
 #include<Utils.hpp>
 #include<BufferHolder.hpp>
 #include<MeshUtils.hpp>
+#include<MeshOptimizer.hpp>
+#include<SimdMath.hpp>
 #include<ObjectManagementStrategy.hpp>
+#include<ostream>
+
+struct MeshLoadOptions
+{
+    bool packedVertices = false;        // quantized vertex layouts
+    bool optimizeVertexCache = false;   // reorder triangles for the vertex cache and overdraw, vertices for fetch locality
+    bool generateLevelsOfDetail = false;    // simplified index lists after the full one, sharing its vertices
+    bool buildMeshlets = false;         // split the full level into runs of triangles culled one by one
+    bool compressTextures = false;      // block compress the scene's textures with mipmaps filtered on the CPU
+    bool cacheTextures = false;         // filter mipmaps of all textures on the CPU and keep them in cache files next to the sources
+    bool cacheScene = false;            // keep the node tree, the materials and the built meshes in a cache file next to the scene, mapped instead of imported on the next start
+};
 
 class Mesh
 {
 public:
+    static const uint32_t MAX_LEVEL_COUNT = 4;
     Mesh();
-    void create(ObjectManagementStrategy* allocator, const aiMesh* mesh, const Material* mat);
+    void load(const aiMesh* mesh, const Material* mat, const MeshLoadOptions& options = MeshLoadOptions());    // builds vertex and index data, safe to call from a worker thread
+    const bool loadCache(const unsigned char* data, const size_t size, size_t& offset, const Material* mat);    // instead of load(), false if the record doesn't fit the data or the material; vertices and indices are uploaded from the data, which has to outlive the allocator's update
+    void saveCache(std::ostream& stream) const;    // after load(), writes what loadCache() reads back
+    static const size_t getMinimumCacheSize();      // bytes of the smallest record loadCache() accepts
+    void create(ObjectManagementStrategy* allocator);      // registers GPU resources, must be called on the allocator's thread after load() or loadCache()
     const Material* getMaterial() const;
-    const BufferInfo& getVertexBuffer() const;
-    const BufferInfo& getIndexBuffer() const;
-    const uint32_t getIndexCount() const;
+    const BufferInfo& getVertexBuffer() const;     // range of the vertex buffer shared by the meshes of the material's type
+    const BufferInfo& getIndexBuffer() const;      // range of the index buffer shared by the meshes of the material's type
+    const uint32_t getBaseVertex() const;          // of the vertex range within the shared buffer
+    const uint32_t getFirstIndex(const uint32_t level = 0) const;      // of the level's index range within the shared buffer, in getIndexType() units
+    const uint32_t getIndexCount(const uint32_t level = 0) const;
+    const uint32_t getLevelCount() const;          // level 0 is the full mesh
+    const float getLevelError(const uint32_t level) const;     // largest distance of the level's surface from the full one, in mesh space
+    const std::vector<MeshOptimizer::Meshlet>& getMeshlets() const;     // of the full level, index ranges relative to getFirstIndex()
+    const float* const* getMeshletCenters() const;     // per axis arrays of the meshlet boxes, in mesh space
+    const float* const* getMeshletExtents() const;
+    const VkIndexType getIndexType() const;     // 16-bit whenever every vertex can be addressed with it
     const uint32_t getVertexCount() const;
+    const PositionDecode& getPositionDecode() const;
+    const BoundingVolume& getBounds() const;       // in mesh space
+    const MeshOptimizer::Statistics& getOriginalCacheStatistics() const;   // of the indices in file order
+    const MeshOptimizer::Statistics& getCacheStatistics() const;
     void clearExtraResources();
     void destroy();
     ~Mesh();
 private:
     const uint32_t getTempIndexBufferSize() const;
+    const void* getTempIndexBufferPtr() const;
+    void generateShortIndexBuffer();
     const uint32_t getTempVertexBufferSize() const;
     void generateTempIndexBuffer(const aiMesh* mesh);   // indices are assumed to be 32-bit values
-    void generateTempVertexBuffer(const aiMesh* mesh);
-    ObjectManagementStrategy* allocator;
+    void generateTempVertexBuffer(const aiMesh* mesh, const bool packedVertices);
+    void optimize(const aiMesh* mesh, std::vector<uint32_t>& vertexOrder);
+    void generateLevelsOfDetail(const aiMesh* mesh);
+    void buildMeshlets(const aiMesh* mesh, const std::vector<uint32_t>& vertexOrder);
+    void computeBounds(const aiMesh* mesh);
+    void buildMeshletArrays();
+    ObjectManagementStrategy* allocator = nullptr;
     const Material* material;
-    VertexBuffer* tempVertexBuffer;
+    VertexBuffer* tempVertexBuffer = nullptr;
     Array<uint32_t> tempIndexBuffer;
+    Array<uint16_t> tempShortIndexBuffer;
+    struct
+    {
+        const unsigned char* vertices = nullptr;     // in the data given to loadCache(), null for loaded meshes
+        const unsigned char* indices = nullptr;
+        uint32_t vertexBufferSize = 0;
+        uint32_t indexBufferSize = 0;
+        uint32_t vertexStride = 0;
+    } cached;
+    VkIndexType indexType;
     BufferInfo vertexBuffer;
     BufferInfo indexBuffer;
+    uint32_t baseVertex;
+    uint32_t firstIndex;
     uint32_t vertexCount;
+    struct LevelOfDetail
+    {
+        uint32_t firstIndex;        // relative to the mesh's first index
+        uint32_t indexCount;
+        float error;
+    } levels[MAX_LEVEL_COUNT];
+    uint32_t levelCount;
+    struct alignas(16) CacheRecord      // followed by the vertices, the indices and the meshlets, the whole record padded to its alignment
+    {
+        uint32_t type;
+        uint32_t vertexCount;
+        uint32_t vertexStride;
+        uint32_t vertexBufferSize;
+        uint32_t indexType;
+        uint32_t indexBufferSize;
+        uint32_t levelCount;
+        uint32_t meshletCount;
+        LevelOfDetail levels[MAX_LEVEL_COUNT];
+        PositionDecode positionDecode;
+        BoundingVolume bounds;
+        MeshOptimizer::Statistics originalCacheStatistics;
+        MeshOptimizer::Statistics cacheStatistics;
+    };
+    std::vector<MeshOptimizer::Meshlet> meshlets;
+    std::vector<float> meshletCenters[3];
+    std::vector<float> meshletExtents[3];
+    const float* meshletCenterArrays[3];
+    const float* meshletExtentArrays[3];
+    PositionDecode positionDecode;
+    BoundingVolume bounds;
+    MeshOptimizer::Statistics originalCacheStatistics;
+    MeshOptimizer::Statistics cacheStatistics;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+#include<assimp/scene.h>
+#include<Utils.hpp>
+#include<vector>
+
+class MeshOptimizer     // every pass is deterministic, the same mesh always ends up in the same order
+{
+public:
+    struct Statistics       // of a simulated FIFO post-transform cache with CACHE_SIZE entries
+    {
+        uint32_t triangleCount;
+        uint32_t vertexCount;       // distinct vertices referenced by the indices
+        uint32_t transformedVertexCount;
+    };
+    struct Meshlet          // a run of consecutive triangles, culled as a whole
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        aiVector3D center;      // of the box and the sphere
+        aiVector3D extents;     // half sizes of the box
+        float radius;
+        aiVector3D coneAxis;    // average facing of the triangles
+        float coneCutoff;       // sine of the cone's half angle, above 1 if the triangles can't all face away at once
+    };
+    static const uint32_t MAX_MESHLET_VERTICES = 64;
+    static const uint32_t MAX_MESHLET_TRIANGLES = 124;
+    static const uint32_t CACHE_SIZE = 16;
+    static const Statistics analyzeVertexCache(const uint32_t* indices, const uint32_t indexCount, const uint32_t vertexCount);
+    static const float getACMR(const Statistics& statistics);     // transformed vertices per triangle, 0.5 at best
+    static const float getATVR(const Statistics& statistics);     // transformed vertices per vertex, 1 at best
+    static void optimizeVertexCache(uint32_t* indices, const uint32_t indexCount, const uint32_t vertexCount, std::vector<uint32_t>& hardClusterStarts);    // Tipsify, cluster starts are the triangles where it had to jump to a new area
+    static void optimizeOverdraw(uint32_t* indices, const uint32_t indexCount, const aiVector3D* positions, const uint32_t vertexCount, const std::vector<uint32_t>& hardClusterStarts);   // clusters facing away from the mesh center go first
+    static void optimizeVertexFetch(uint32_t* indices, const uint32_t indexCount, const uint32_t vertexCount, std::vector<uint32_t>& vertexOrder);  // vertexOrder[new index] = old index, indices are remapped
+    static void buildMeshlets(const uint32_t* indices, const uint32_t indexCount, const aiVector3D* positions, const uint32_t vertexCount, std::vector<Meshlet>& meshlets);   // triangles keep their order, so run it after optimizeVertexCache
+    static const float simplify(const uint32_t* indices, const uint32_t indexCount, const aiVector3D* positions, const uint32_t vertexCount, const uint32_t targetIndexCount, std::vector<uint32_t>& result);  // quadric edge collapse onto existing vertices, returns the largest collapse error as a distance
+private:
+    struct Quadric         // symmetric 4x4 matrix of summed plane equations: xx xy xz xw yy yz yw zz zw ww
+    {
+        double terms[10];
+    };
+    static void addPlane(Quadric& quadric, const double* plane, const double weight);
+    static void addQuadric(Quadric& quadric, const Quadric& other);
+    static const double evaluateQuadric(const Quadric& quadric, const aiVector3D& position);   // weighted sum of squared distances to the planes
+    static void computeMeshletBounds(const uint32_t* indices, const aiVector3D* positions, Meshlet& meshlet);
+    static const bool collapseFlips(const uint32_t* indices, const uint32_t* triangles, const uint32_t triangleCount, const aiVector3D* positions, const uint32_t from, const uint32_t to);
+    static const uint32_t getNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& liveTriangleCounts, const std::vector<uint32_t>& cacheTimes, const uint32_t time, std::vector<uint32_t>& deadEnds, uint32_t& cursor, bool& jumped);
+    static const float OVERDRAW_THRESHOLD;      // a cluster may end once its miss ratio is within this factor of its hard cluster's
+    static void splitSoftClusters(const uint32_t* indices, const uint32_t triangleCount, const uint32_t vertexCount, const std::vector<uint32_t>& hardClusterStarts, std::vector<uint32_t>& clusterStarts);
+};
+
+#endif
\ No newline at end of file
@@ -2,6 +2,13 @@
 #define MESH_UTILS_HPP
 #include<assimp/scene.h>
 #include<Utils.hpp>
+#include<vector>
+
+struct PositionDecode       // position = offset + stored position * scale, pushed as a vertex stage push constant
+{
+    float offset[4];
+    float scale[4];
+};
 
 class VertexBuffer
 {
@@ -11,13 +18,22 @@ public:
     virtual void* getBufferPtr() = 0;
     virtual const uint32_t getBufferSize() const = 0;
     virtual const uint32_t getVertexCount() const = 0;
-    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes) = 0;
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false) = 0;  // instanced -> model matrix per instance in binding 1
     virtual void clear() = 0;
+    virtual const PositionDecode getPositionDecode() const;     // identity unless positions are quantized
+    void reorderVertices(const std::vector<uint32_t>& order);   // order[new index] = old index
+    const uint32_t getVertexStride() const;
     static const uint32_t getFirstTextureCoordIndex(const aiMesh* mesh);
     static const bool hasPositions(const aiMesh* mesh);
     static const bool hasNormals(const aiMesh* mesh);
     static const bool hasTangentsAndBitangents(const aiMesh* mesh);
 protected:
+    static void addInstanceInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes);  // mat4 takes 4 locations right after the vertex attributes
+    static const PositionDecode computePositionDecode(const aiMesh* mesh);     // maps the mesh bounds onto [0, 1]
+    static void quantizePosition(const aiVector3D& position, const PositionDecode& decode, uint16_t* result);     // 3 unorm values
+    static void encodeOctahedral(const aiVector3D& direction, int16_t* result);     // 2 snorm values
+    static const uint16_t encodeHalf(const float value);
+    static const bool hasNegativeBitangent(const aiVector3D& normal, const aiVector3D& tangent, const aiVector3D& bitangent);
 };
 
 class VertexBufferStandard : public VertexBuffer
@@ -28,7 +44,7 @@ public:
     virtual void* getBufferPtr();
     virtual const uint32_t getBufferSize() const;
     virtual const uint32_t getVertexCount() const;
-    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes);
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false);
     virtual void clear();
 protected:
     struct Vertex
@@ -49,7 +65,7 @@ public:
     virtual void* getBufferPtr();
     virtual const uint32_t getBufferSize() const;
     virtual const uint32_t getVertexCount() const;
-    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes);
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false);
     virtual void clear();
 protected:
     struct Vertex
@@ -69,7 +85,7 @@ public:
     virtual void* getBufferPtr();
     virtual const uint32_t getBufferSize() const;
     virtual const uint32_t getVertexCount() const;
-    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes);
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false);
     virtual void clear();
 protected:
     struct Vertex
@@ -81,4 +97,74 @@ protected:
     Array<Vertex> vertices;
 };
 
+// packed layouts: 16-bit positions quantized to the mesh bounds, octahedral normals and tangents, half float uvs
+
+class VertexBufferStandardPacked : public VertexBuffer
+{
+public:
+    virtual const bool checkCompatibility(const aiMesh* mesh) const;
+    virtual void loadFromAiMesh(const aiMesh* mesh);
+    virtual void* getBufferPtr();
+    virtual const uint32_t getBufferSize() const;
+    virtual const uint32_t getVertexCount() const;
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false);
+    virtual void clear();
+    virtual const PositionDecode getPositionDecode() const;
+protected:
+    struct Vertex
+    {
+        uint16_t posAndBitangentSign[4];    // w: 0 -> bitangent = -cross(normal, tangent)
+        int16_t normal[2];
+        int16_t tan[2];
+        uint16_t uv[2];
+    };
+    PositionDecode decode;
+    Array<Vertex> vertices;
+};
+
+class VertexBufferNotTexturedPacked : public VertexBuffer
+{
+public:
+    virtual const bool checkCompatibility(const aiMesh* mesh) const;
+    virtual void loadFromAiMesh(const aiMesh* mesh);
+    virtual void* getBufferPtr();
+    virtual const uint32_t getBufferSize() const;
+    virtual const uint32_t getVertexCount() const;
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false);
+    virtual void clear();
+    virtual const PositionDecode getPositionDecode() const;
+protected:
+    struct Vertex
+    {
+        uint16_t posAndBitangentSign[4];
+        int16_t normal[2];
+        int16_t tan[2];
+    };
+    PositionDecode decode;
+    Array<Vertex> vertices;
+};
+
+class VertexBufferWithNormalMapPacked : public VertexBuffer     // no normals to derive the bitangent from, so it's stored as well
+{
+public:
+    virtual const bool checkCompatibility(const aiMesh* mesh) const;
+    virtual void loadFromAiMesh(const aiMesh* mesh);
+    virtual void* getBufferPtr();
+    virtual const uint32_t getBufferSize() const;
+    virtual const uint32_t getVertexCount() const;
+    virtual void getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced = false);
+    virtual void clear();
+    virtual const PositionDecode getPositionDecode() const;
+protected:
+    struct Vertex
+    {
+        uint16_t pos[4];
+        int16_t tan[2];
+        int16_t btan[2];
+        uint16_t uv[2];
+    };
+    PositionDecode decode;
+    Array<Vertex> vertices;
+};
+
 #endif
\ No newline at end of file
@@ -9,25 +9,44 @@
 #include<ImageLoader.hpp>
 #include<ImageHolder.hpp>
 #include<MemoryPool.hpp>
+#include<StagingRing.hpp>
 #include<SynchronizationPool.hpp>
 #include<Utils.hpp>
+#include<map>
 
 class ObjectManagementStrategy
 {
 public:
+    struct ImageStatistics      // of the sampled images
+    {
+        uint32_t imageCount;
+        VkDeviceSize memoryBytes;       // device memory the images are bound to
+        VkDeviceSize uploadedBytes;     // staged for copies, every uploaded level included
+    };
     virtual void create(const System* system, 
         SynchronizationPool* syncPool, 
         CommandPool* commandPool) = 0;  // must be dynamic
     virtual void pickDepthStencilFormat(VkFormat& format, VkImageTiling& tiling) const = 0;
     virtual void pickImageFormat(VkFormat& format, VkImageTiling& tiling) const = 0;
-    virtual void allocateSampledImage(const VkExtent3D& extent, SampledImageInfo& sampledImage, DescriptorInfo& sampledImageDescriptor) = 0;
+    virtual const bool pickCompressedImageFormat(const bool normalMap, VkFormat& format) const = 0;    // false if no block compressed format can be sampled
+    virtual void allocateSampledImage(const VkExtent3D& extent, SampledImageInfo& sampledImage, DescriptorInfo& sampledImageDescriptor, const VkFormat format = VkFormat::VK_FORMAT_UNDEFINED, const uint32_t mipmapLevelCount = 0) = 0;    // images of a given format take mipmapLevelCount uploaded levels, others are picked a format and get their mipmaps generated
     virtual void allocateDepthMap(const VkExtent2D& extent, ImageInfo& depthMap) = 0;
     virtual void allocateVertexBuffer(const uint32_t size, BufferInfo& buffer) = 0;
     virtual void allocateIndexBuffer(const uint32_t size, BufferInfo& buffer) = 0;
+    virtual void allocateMeshBuffers(const DrawableType type, const uint32_t vertexStride, const uint32_t vertexBufferSize, const uint32_t indexBufferSize, BufferInfo& vertexBuffer, BufferInfo& indexBuffer) = 0;   // ranges of buffers shared by all meshes of the type, vertex ranges start at a multiple of the stride
+    virtual void allocateIndirectBuffer(const uint32_t size, BufferInfo& buffer) = 0;     // for VkDrawIndexedIndirectCommand records
+    virtual void allocateStorageBuffers(const Array<uint32_t>& sizes, BufferInfo* buffers, DescriptorInfo& storageDescriptor) = 0;     // COMPUTE_STORAGE_BINDING_COUNT buffers in one compute set, binding = array index; also usable as indirect buffers
     virtual void allocateUniformBuffer(const uint32_t size, const VkShaderStageFlags stages, BufferInfo& buffer, DescriptorInfo& uniformDescriptor) = 0;
+    virtual void allocateObjectUniformBuffer(const uint32_t size, BufferInfo& buffer, DescriptorInfo& uniformDescriptor) = 0;   // all objects share one dynamic descriptor set, selected by uniformDescriptor.dynamicOffset
     virtual void updateBuffer(const void* src, const BufferInfo& dst) = 0;
     virtual void updateImage(const ImageLoader::Image& src, const ImageInfo& dst) = 0;
+    virtual void freeSampledImage(const SampledImageInfo& sampledImage, const DescriptorInfo& sampledImageDescriptor) = 0;   // with its descriptor set, freeing an image twice does nothing
+    virtual void freeBuffer(const BufferInfo& buffer) = 0;     // vertex, index, mesh and indirect ranges, later allocations of the same kind reuse them
+    virtual void freeUniformBuffer(const BufferInfo& buffer, const DescriptorInfo& uniformDescriptor) = 0;
+    virtual const std::vector<MemoryPool::Statistics> getMemoryStatistics() const = 0;
+    virtual const ImageStatistics getImageStatistics() const = 0;
     virtual const VkPipelineLayout& getPipelineLayout(const DrawableType type) = 0;
+    virtual const VkPipelineLayout& getComputePipelineLayout() = 0;     // one storage set and COMPUTE_PUSH_CONSTANT_SIZE bytes of push constants
     virtual void load() = 0;
     virtual void update() = 0;
     virtual void destroy() = 0;
@@ -42,14 +61,25 @@ public:
         CommandPool* commandPool);  // must be dynamic
     void pickDepthStencilFormat(VkFormat& format, VkImageTiling& tiling) const;
     void pickImageFormat(VkFormat& format, VkImageTiling& tiling) const;
-    void allocateSampledImage(const VkExtent3D& extent, SampledImageInfo& sampledImage, DescriptorInfo& sampledImageDescriptor);
+    const bool pickCompressedImageFormat(const bool normalMap, VkFormat& format) const;
+    void allocateSampledImage(const VkExtent3D& extent, SampledImageInfo& sampledImage, DescriptorInfo& sampledImageDescriptor, const VkFormat format = VkFormat::VK_FORMAT_UNDEFINED, const uint32_t mipmapLevelCount = 0);
     void allocateDepthMap(const VkExtent2D& extent, ImageInfo& depthMap);
     void allocateVertexBuffer(const uint32_t size, BufferInfo& buffer);
     void allocateIndexBuffer(const uint32_t size, BufferInfo& buffer);
+    void allocateMeshBuffers(const DrawableType type, const uint32_t vertexStride, const uint32_t vertexBufferSize, const uint32_t indexBufferSize, BufferInfo& vertexBuffer, BufferInfo& indexBuffer);
+    void allocateIndirectBuffer(const uint32_t size, BufferInfo& buffer);
+    void allocateStorageBuffers(const Array<uint32_t>& sizes, BufferInfo* buffers, DescriptorInfo& storageDescriptor);
     void allocateUniformBuffer(const uint32_t size, const VkShaderStageFlags stages, BufferInfo& buffer, DescriptorInfo& uniformDescriptor);
+    void allocateObjectUniformBuffer(const uint32_t size, BufferInfo& buffer, DescriptorInfo& uniformDescriptor);
     void updateBuffer(const void* src, const BufferInfo& dst);
     void updateImage(const ImageLoader::Image& src, const ImageInfo& dst);
+    void freeSampledImage(const SampledImageInfo& sampledImage, const DescriptorInfo& sampledImageDescriptor);
+    void freeBuffer(const BufferInfo& buffer);
+    void freeUniformBuffer(const BufferInfo& buffer, const DescriptorInfo& uniformDescriptor);
+    const std::vector<MemoryPool::Statistics> getMemoryStatistics() const;
+    const ImageStatistics getImageStatistics() const;
     const VkPipelineLayout& getPipelineLayout(const DrawableType type);
+    const VkPipelineLayout& getComputePipelineLayout();
     void load();
     void update();
     void destroy();
@@ -60,14 +90,28 @@ private:
         DLSampledImageFrag,
         DLUniformFrag,
         DLUniformVertTeseGeom,
+        DLDynamicUniformVertTeseGeom,
+        DLStorageCompute,
         DLCount
     };
-    enum MemoryObjects{MOTransfer, MOImage, MOBuffer, MOCount};
-    enum Buffers{BVertex, BIndex, BTransfer, BUniform, BCount};
+    enum Buffers
+    {
+        BVertex,
+        BIndex,
+        BTransfer,
+        BUniform,
+        BObjectUniform,
+        BIndirect,
+        BStorage,
+        BMeshVertex,                                        // one per DrawableType
+        BMeshIndex = BMeshVertex + DrawableType::DTCount,   // one per DrawableType
+        BCount = BMeshIndex + DrawableType::DTCount
+    };
 
     struct BufferDescriptorUpdateCommand
     {
         const BufferInfo* buffer;
+        VkDescriptorType type;
         uint32_t set;
         uint32_t binding;
         uint32_t arrayElement;
@@ -102,18 +146,59 @@ private:
         const ImageInfo* dst;
     };
 
-    struct ViewCreateCommand
+    // freed resources may still be used by submitted or recorded work, they are released once the transfer batch
+    // they wait for has completed
+
+    struct ImageRelease
     {
-        uint32_t index;
+        uint32_t batch;
         uint32_t imageIndex;
-        VkImageViewType type;
-        VkFormat format;
-        VkImageSubresourceRange subresource;
+        uint32_t viewIndex;
+        uint32_t samplerIndex;
+        MemoryAllocation memory;
+    };
+
+    struct DescriptorSetRelease
+    {
+        uint32_t batch;
+        uint32_t set;
+    };
+
+    struct BufferRangeRelease
+    {
+        uint32_t batch;
+        uint32_t buffer;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct BufferRelease        // a buffer replaced by a larger one
+    {
+        uint32_t batch;
+        VkBuffer buffer;
+        MemoryAllocation memory;
     };
 
     void createDescriptorLayouts();
     void preloadDescriptorSets();
     void allocateTransferBuffer();
+    void bindImageMemory(const uint32_t imageIndex, const VkImageTiling tiling);
+    void initDeviceBuffer(const uint32_t buffer, const uint32_t size, const VkBufferUsageFlags usage);   // empty buffers are not created
+    void growBuffer(const uint32_t buffer, const uint32_t minimumSize);     // the new buffer keeps the index, the contents and the descriptors of the old one
+    const uint32_t allocateDescriptorSet(const DescriptorLayouts layout);     // reuses freed sets first
+    void freeDescriptorSet(const uint32_t set);     // its index is reused once the set is released
+    const VkDeviceSize allocateBufferRange(const uint32_t buffer, const VkDeviceSize size, const VkDeviceSize alignment);  // reuses freed ranges first, grows the buffer once it is loaded
+    const bool freeBufferRange(const BufferInfo& buffer);      // false if it was already freed
+    void releaseBufferRange(const uint32_t buffer, VkDeviceSize offset, VkDeviceSize size);
+    const uint32_t getReleaseBatch() const;
+    const bool hasPendingReleases() const;
+    void releaseCompletedResources(const uint32_t completedBatch);
+    void commitPendingCommands();       // initial layouts and descriptor writes of the resources allocated since the last call
+    const VkCommandBuffer& getCurrentUpdateCommandBuffer() const;
+    const VkCommandBuffer& getCurrentTransferCommandBuffer() const;  // update command buffer if there is no dedicated transfer queue
+    void beginTransferBatch();
+    const VkDeviceSize reserveTransferRange(const VkDeviceSize size);  // may submit the current batch and begin a new one
+    void submitTransferBatch();
 
     const System* system;
     VkPhysicalDeviceProperties deviceProperties;
@@ -125,21 +210,39 @@ private:
     DescriptorLayoutHolder descriptorLayoutHolder;
     DescriptorPool descriptorPool;
     uint32_t updateSemaphore;
-    uint32_t updateFence;
-    uint32_t updateCommandBuffer;
+    uint32_t firstUpdateFence;
+    uint32_t firstUpdateCommandBuffer;
+    uint32_t currentUpdateSlot = 0;
     bool firstCommandBufferRun = true;
-    std::vector<VkMemoryRequirements> memoryRequirements[MemoryObjects::MOCount];
-    uint32_t vertexBufferSize = 0;
-    uint32_t indexBufferSize = 0;
-    uint32_t uniformBufferSize = 0;
+    CommandPool transferCommandPool;        // created only for a dedicated transfer queue
+    uint32_t firstTransferSemaphore;
+    uint32_t firstGraphicsDoneSemaphore;    // one per slot, the transfer batch waits for all graphics work submitted before it
+    MemoryAllocation bufferMemory[Buffers::BCount];
+    std::vector<MemoryAllocation> imageMemory;
+    ImageStatistics imageStatistics = {};
+    uint32_t bufferSizes[Buffers::BCount] = {};
+    VkBufferUsageFlags bufferUsages[Buffers::BCount] = {};
+    std::map<VkDeviceSize, VkDeviceSize> freeBufferRanges[Buffers::BCount];     // offset -> size
+    uint32_t objectUniformStride = 0;
+    uint32_t objectUniformCount = 0;
+    uint32_t objectUniformSet = ~0U;
+    BufferInfo objectUniformRange;          // what a single dynamic descriptor sees, starting at its dynamic offset
     uint32_t currentDescriptorCount = 0;
-    std::vector<ViewCreateCommand> viewCreateCommands;
+    std::vector<uint32_t> freeDescriptorSets;
+    bool loaded = false;
     std::vector<BufferDescriptorUpdateCommand> bufferDescriptorUpdateCommands;
+    std::vector<BufferDescriptorUpdateCommand> writtenBufferDescriptors;    // rewritten when their buffer grows
     std::vector<ImageDescriptorUpdateCommand> imageDescriptorUpdateCommands;
     std::vector<BufferUpdateCommand> bufferUpdateCommands;
     std::vector<ImageUpdateCommand> imageUpdateCommands;
     std::vector<InitialImageLayoutUpdateCommand> layoutUpdateCommands;
-    void* mappedTransferMemory = nullptr;
+    uint32_t submittedBatchCount = 0;
+    uint32_t slotBatches[STAGING_FRAME_COUNT] = {};     // the last batch submitted in each slot
+    std::vector<ImageRelease> imageReleases;
+    std::vector<DescriptorSetRelease> descriptorSetReleases;
+    std::vector<BufferRangeRelease> bufferRangeReleases;
+    std::vector<BufferRelease> bufferReleases;
+    StagingRing stagingRing;
 };
 
 #endif
\ No newline at end of file
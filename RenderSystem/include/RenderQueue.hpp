@@ -0,0 +1,24 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+#include<cstdint>
+#include<vector>
+
+class RenderQueue       // 64-bit sort keys with 32-bit payloads, sorted with an LSD radix sort
+{
+public:
+    RenderQueue();
+    void push(const uint64_t key, const uint32_t value);
+    void sort();        // stable, storage is kept between frames so sorting doesn't allocate once warmed up
+    const uint32_t getSize() const;
+    const uint64_t getKey(const uint32_t index) const;
+    const uint32_t getValue(const uint32_t index) const;
+    void clear();
+    ~RenderQueue();
+private:
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<uint64_t> tempKeys;
+    std::vector<uint32_t> tempValues;
+};
+
+#endif
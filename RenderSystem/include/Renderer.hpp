@@ -7,18 +7,41 @@
 #include<ObjectManagementStrategy.hpp>
 #include<Scene.hpp>
 #include<GraphicsPipelineUtils.hpp>
+#include<ComputePipelineUtils.hpp>
 #include<Shader.hpp>
+#include<RenderQueue.hpp>
 
 class Renderer
 {
 public:
+    struct DrawStatistics       // binds are counted per descriptor set / buffer, skipped ones were already bound
+    {
+        uint32_t drawCount;             // direct draws and indirect commands, culled ones included with GPU culling
+        uint32_t instanceCount;         // not known on the CPU for GPU culled draws
+        uint32_t indirectCallCount;
+        uint32_t testedCount;           // draws checked against the view frustum
+        uint32_t culledCount;           // by the CPU only
+        uint32_t reducedCount;          // draws using a simplified level of their mesh
+        uint32_t meshletCount;          // tested for draws of meshes split into meshlets
+        uint32_t meshletCulledCount;    // outside the frustum or facing away
+        uint32_t pipelineBinds;
+        uint32_t pipelineBindsSkipped;
+        uint32_t descriptorSetBinds;
+        uint32_t descriptorSetBindsSkipped;
+        uint32_t vertexBufferBinds;
+        uint32_t vertexBufferBindsSkipped;
+        uint32_t indexBufferBinds;
+        uint32_t indexBufferBindsSkipped;
+    };
     Renderer();
-    void create(const Window& window, const std::vector<std::string>& sceneFilenames, const std::string& imagePath);
+    void create(const Window& window, const std::vector<std::string>& sceneFilenames, const std::string& imagePath, const MeshLoadOptions& meshOptions = MeshLoadOptions(), const bool indirectDraws = false, const bool gpuCulling = false);  // indirect draws need drawIndirectFirstInstance, direct draws are used without it; GPU culling implies indirect draws
     Scene& getScene(const uint32_t index);
     const Scene& getScene(const uint32_t index) const;
     void beginRendering();
-    void renderSceneNode(const Scene::Node& node);
+    void renderSceneNode(Scene& scene, const Scene::Node& node);      // only queues the node's render list, draws are recorded in endRendering()
     void endRendering();
+    const DrawStatistics& getDrawStatistics() const;   // of the last recorded frame
+    void reloadTextures(const uint32_t sceneIndex);     // between frames, replaces the scene's textures with their files' current contents
     void destroy();
     ~Renderer();
 private:
@@ -32,12 +55,78 @@ private:
         glm::mat4 view;
         glm::mat4 projection;
     } viewProj;
+    static const uint32_t MAX_SET_COUNT = 5;     // view & projection, model, material colors, texture, normal map
+    struct QueuedDraw
+    {
+        const Scene::RenderList* list;
+        uint32_t entry;
+        uint32_t level;         // of detail of the mesh
+    };
+    struct IndexRange
+    {
+        uint32_t firstIndex;        // relative to the mesh's first index
+        uint32_t indexCount;
+    };
+    struct CullObject           // laid out as in Cull.comp
+    {
+        glm::vec4 center;
+        glm::vec4 extents;          // world space box
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t bucket;
+    };
+    struct CullBucket
+    {
+        uint32_t drawCount;         // of visible commands, counted by the shader when compacting
+        uint32_t firstCommand;
+    };
+    struct CullConstants
+    {
+        glm::vec4 planes[6];
+        uint32_t objectCount;
+        uint32_t compact;
+    };
+    enum CullBuffers        // bindings of the cull set
+    {
+        CBObjects,
+        CBCommands,
+        CBBuckets,
+        CBCount
+    };
+    struct BoundState
+    {
+        uint32_t pipeline;
+        DrawableType layoutType;
+        VkDescriptorSet sets[MAX_SET_COUNT];
+        uint32_t modelOffset;       // dynamic offset of the model set
+        const PositionDecode* positionDecode;   // the one in the push constants
+        VkBuffer vertexBuffer;
+        VkBuffer indexBuffer;
+        VkIndexType indexType;
+        bool instanceBufferBound;
+    };
     BufferInfo viewProjBuffer;
     DescriptorInfo viewProjDescriptor;
     
     const uint32_t getSwapchainImageCount() const;
     void createRenderPass();
     void createPipelines();
+    void flushRenderLists();
+    const Mesh& getQueuedMesh(const QueuedDraw& draw) const;
+    const uint32_t selectLevel(const Mesh& mesh, const glm::mat4& model) const;     // coarsest level whose error projects to at most MAX_LEVEL_PIXEL_ERROR pixels
+    const bool usesMeshlets(const Mesh& mesh, const uint32_t level) const;
+    void cullMeshlets(const Mesh& mesh, const glm::mat4& model);      // fills meshletRanges with the index ranges of visible meshlets
+    void recordDirectDraws(const VkCommandBuffer& commands);
+    void recordIndirectDraws(const VkCommandBuffer& commands);
+    void recordCulledDraws(const VkCommandBuffer& commands);
+    void recordCullDispatch(const VkCommandBuffer& commands);
+    void beginRenderPass(const VkCommandBuffer& commands);
+    const uint64_t getSortKey(const uint32_t sceneSlot, const Scene::RenderList& list, const uint32_t entry) const;
+    void bindDrawState(const VkCommandBuffer& commands, const DrawableType type, const Mesh& mesh, const Scene::Node& node, const bool instanced);
+    void recordDraw(const VkCommandBuffer& commands, const DrawableType type, const Mesh& mesh, const uint32_t level, const Scene::Node& node, const bool instanced, const uint32_t instanceCount, const uint32_t firstInstance);
+    void recordIndirectDraw(const VkCommandBuffer& commands, const DrawableType type, const Mesh& mesh, const Scene::Node& node, const BufferInfo& buffer, const uint32_t firstCommand, const uint32_t commandCount);
+    void createComputePipelines();
 
     System system;
     Swapchain swapchain;
@@ -45,7 +134,10 @@ private:
     Array<Shader> textured; 
     Array<Shader> notTextured;
     Array<Shader> normalMapped;
+    Array<Shader> instancedVertexShaders;    // indexed by DrawableType
     PipelinePool pipelinePool;
+    Array<Shader> computeShaders;
+    ComputePipelinePool computePipelinePool;
     CommandPool commandPool;
     SynchronizationPool syncPool;
     ObjectManagementStrategy* allocator;
@@ -54,6 +146,35 @@ private:
     Array<RenderSyncPrimitives> semaphores;
     Array<RenderSyncPrimitives> fences;
     Array<Scene> scenes;
+    Array<BufferInfo> instanceBuffers;      // one per swapchain image
+    BufferInfo instanceUploadRange;
+    std::vector<glm::mat4> instanceData;
+    Array<BufferInfo> indirectBuffers;      // one per swapchain image, MAX_INSTANCE_COUNT commands each
+    BufferInfo indirectUploadRange;
+    std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
+    Array<BufferInfo> cullBuffers;          // CBCount per swapchain image
+    Array<DescriptorInfo> cullDescriptors;  // one per swapchain image
+    BufferInfo cullObjectUploadRange;
+    BufferInfo cullBucketUploadRange;
+    std::vector<CullObject> cullObjects;
+    std::vector<CullBucket> cullBuckets;
+    std::vector<uint32_t> cullBucketDraws;      // position of the bucket's first draw in drawQueue
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount = nullptr;   // compacted draws are only possible with VK_KHR_draw_indirect_count
+    std::vector<const Scene::RenderList*> queuedRenderLists;
+    std::vector<QueuedDraw> queuedDraws;
+    std::vector<std::vector<uint8_t>> nodeVisibility;     // per scene, by node bounds index
+    std::vector<uint8_t> sceneCulled;                     // per scene, whether nodeVisibility is filled for this frame
+    std::vector<uint32_t> cullTraversalStack;             // scratch of the scene hierarchy culling
+    std::vector<uint8_t> meshletVisibility;
+    std::vector<IndexRange> meshletRanges;
+    glm::vec4 frustumPlanes[6];         // of the frame being recorded
+    glm::vec3 cameraPosition;
+    RenderQueue drawQueue;
+    BoundState boundState;
+    DrawStatistics drawStatistics = {};
+    bool packedVertices = false;
+    bool indirectDraws = false;
+    bool gpuCulling = false;
     uint32_t currentSubmission = 0;
     uint32_t usedSubmissions = 0;
     uint32_t currentImage;
@@ -3,9 +3,14 @@
 #include<assimp/Importer.hpp>
 #include<assimp/postprocess.h>
 #include<Mesh.hpp>
+#include<MappedFile.hpp>
 #include<Material.hpp>
+#include<ThreadPool.hpp>
+#include<BoundingVolumeHierarchy.hpp>
+#include<glm/gtc/quaternion.hpp>
 #include<map>
 #include<string>
+#include<vector>
 #include<assimp/scene.h>
 
 class Scene
@@ -15,6 +20,8 @@ public:
     {
     public:
         Node();
+        Node(const Node& other);
+        Node& operator=(const Node& other);
         void create(ObjectManagementStrategy* allocator, const uint32_t maxMeshCount);
         void setMesh(const uint32_t index, Mesh* mesh);
         void addChild(const std::string& name);
@@ -23,44 +30,126 @@ public:
         const Node& operator[](const std::string& key) const;
         const Array<Mesh*>& getMeshes() const;
         const DescriptorInfo& getModelMatrixDescriptor() const;
+        const glm::mat4& getModelMatrix() const;      // world matrix as of the last Scene::updateTransforms
+        const glm::mat4& getLocalMatrix() const;
+        const BoundingVolume& getWorldBounds() const;  // of the node's own meshes, as of the last Scene::updateTransforms
+        const glm::vec3& getPosition() const;
+        const glm::quat& getRotation() const;
+        const glm::vec3& getScale() const;
+        const Node* getParent() const;
         const std::map<std::string, Node>& getChildrenNodes() const;
         void setModelMatrix(const aiMatrix4x4& mat);
         void rotate(const float radians, const glm::vec3 axis);
         void rotate(const glm::vec3 eulerAngles);
         void scale(const glm::vec3 s);
         void move(const glm::vec3 m);
+        void setPosition(const glm::vec3 p);
+        void setRotation(const glm::quat r);
+        void setScale(const glm::vec3 s);
         void destroy();
         ~Node();
     private:
-        glm::mat4 modelMatrix;
+        friend class Scene;
+        void markTransformDirty();
+        void markHierarchyChanged();    // in the owning scene, detached nodes have none
+        void setScene(Scene* scene);    // for the node and its whole subtree
+        void updateWorldTransform(const glm::mat4& parentWorld, const bool parentChanged, uint32_t& updatedCount);
+        ObjectManagementStrategy* allocator;
+        Scene* scene;                   // whose revisions the node bumps
+        Node* parent;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scaleFactors;
+        glm::mat4 localMatrix;
+        glm::mat4 worldMatrix;
+        BoundingVolume worldBounds;
+        uint32_t boundsIndex;           // primitive of the scene's hierarchy, ~0U for nodes without meshes
+        bool transformDirty;            // local TRS changed since the last update
+        bool hasDirtyDescendant;        // some node below has transformDirty set
         BufferInfo modelMatrixBuffer;
         DescriptorInfo modelMatrixDescriptor;
         Array<Mesh*> meshes;
         std::map<std::string, Node> children;
     };
+    class RenderList        // node tree flattened into draws sorted by pipeline type, material and mesh
+    {
+    public:
+        RenderList();
+        const uint32_t getSize() const;
+        const Scene* getScene() const;
+        const glm::mat4* getModelMatrices() const;
+        const uint32_t* getMeshIds() const;
+        const uint32_t* getMaterialIds() const;
+        const DrawableType* getTypes() const;
+        const Node* const* getNodes() const;
+        const uint32_t* getNodeBoundsIndices() const;  // index of the draw's node in Scene::cullNodes results
+    private:
+        friend class Scene;
+        const Scene* scene = nullptr;
+        const Node* root = nullptr;
+        uint64_t hierarchyRevision = ~0ull;
+        uint64_t transformRevision = ~0ull;
+        std::vector<glm::mat4> modelMatrices;
+        std::vector<uint32_t> meshIds;
+        std::vector<uint32_t> materialIds;
+        std::vector<DrawableType> types;
+        std::vector<const Node*> nodes;
+        std::vector<uint32_t> nodeBoundsIndices;
+    };
     Scene();
     void setAllocator(ObjectManagementStrategy* allocator);
-    void loadFromFile(const std::string& imagePath, const std::string& file);
+    void loadFromFile(const std::string& imagePath, const std::string& file, const MeshLoadOptions& meshOptions = MeshLoadOptions());
     Material& getMaterial(const uint32_t index);
     Mesh& getMesh(const uint32_t index);
+    const Material& getMaterial(const uint32_t index) const;
+    const Mesh& getMesh(const uint32_t index) const;
+    const uint32_t getMeshCount() const;
+    const RenderList& getRenderList(const Node& subtreeRoot);    // rebuilt only if the hierarchy changed, matrices are refreshed if any node moved
+    const uint32_t updateTransforms();      // recomputes and uploads world matrices of moved nodes only, returns how many changed
+    void updateBoundingVolumeHierarchy();   // rebuilt if the hierarchy changed, refitted if any node moved
+    void cullNodes(const glm::vec4* planes, std::vector<uint8_t>& visible, std::vector<uint32_t>& traversalStack) const;   // by node bounds index, as of the last hierarchy update; the stack is the caller's scratch
+    const Node* raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance);     // nearest node whose world box the ray hits, nullptr if none
     Node& operator[](const std::string& key);
     const Node& operator[](const std::string& key) const;
     const Node& getRootNode() const;
     Node& getRootNode();
+    const uint64_t getHierarchyRevision() const;  // changes whenever a node of this scene gains children or meshes
+    const uint64_t getTransformRevision() const;  // changes whenever a world matrix of this scene is recomputed
+    void reloadTextures();      // frees every texture and allocates it again from its file, uploaded on the allocator's next update()
     void clearExtraResources();
     void destroy();
     ~Scene();
 private:
     ObjectManagementStrategy* allocator;
     void loadNode(const aiNode* ainode, Node& node);
-    void loadMeshes();
-    void loadMaterials(const std::string& imagePath);
+    void loadMeshes(ThreadPool& workers, const MeshLoadOptions& meshOptions);
+    const bool loadSceneCache(const std::string& imagePath, const std::string& file, const VkFormat textureFormat, const VkFormat normalMapFormat, const MeshLoadOptions& meshOptions);   // replaces the import, false if the cache is missing, stale or damaged
+    const bool loadCachedNode(size_t& offset, Node* node);     // only checks the records if node is null
+    void saveSceneCache(const std::string& file, const MeshLoadOptions& meshOptions) const;     // after the meshes are built, while the imported scene is alive
+    void logVertexCacheStatistics() const;
+    void logTextureCacheStatistics() const;
+    void pickTextureFormats(const MeshLoadOptions& options, VkFormat& textureFormat, VkFormat& normalMapFormat) const;
+    void loadMaterials(const std::string& imagePath, const VkFormat textureFormat, const VkFormat normalMapFormat, const MeshLoadOptions& options);
+    void loadImages(ThreadPool& workers);
+    void createResources();
+    void buildRenderList(const Node& subtreeRoot, RenderList& list) const;
+    void refreshRenderListTransforms(RenderList& list) const;
     Assimp::Importer importer;
-    const aiScene* importedScene;
+    const aiScene* importedScene;       // null when the scene came from its cache
     Array<Material> materials;
     Array<Mesh> meshes;
+    MappedFile sceneCache;      // cached meshes upload from it, so it stays mapped until the extra resources are cleared
+    size_t sceneCacheNodeOffset;
+    uint64_t hierarchyRevision = 0;     // before the root, its nodes bump them until they are destroyed
+    uint64_t transformRevision = 0;
     // lights
     Node root;
+    std::map<const Node*, RenderList> renderLists;
+    BoundingVolumeHierarchy boundingVolumeHierarchy;
+    std::vector<Node*> boundedNodes;        // by bounds index
+    std::vector<BoundingVolume> boundedNodeVolumes;
+    uint64_t boundsHierarchyRevision = ~0ull;
+    uint64_t boundsTransformRevision = ~0ull;
 };
 
 #endif
\ No newline at end of file
@@ -4,13 +4,14 @@
 #include<glslang/Public/ShaderLang.h>
 #include<SPIRV/GlslangToSpv.h>
 #include<External/Glslang/DirStackFileIncluder.h>
+#include<MappedFile.hpp>
 #include<System.hpp>
 
 class Shader
 {
 public:
     Shader();
-    void create(const System* system, const char* filename);
+    void create(const System* system, const char* filename);      // takes <filename>.spv if it is newer than the source and its includes, then the SPIR-V cache, compiles with glslang only on a miss
     const ShaderStageInfo& getShader() const;
     void destroy();
     ~Shader();
@@ -18,6 +19,10 @@ private:
     static const int clientInputSematicsVersion = 100;
     static const glslang::EshTargetClientVersion vulkanClientVersion = glslang::EShTargetVulkan_1_0;
     static const glslang::EShTargetLanguageVersion targetLangVersion = glslang::EShTargetSpv_1_0;
+    static const EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
+    static const uint64_t getOptionsHash(const EShLanguage shaderType);
+    static const bool loadPrecompiled(const char* filename, MappedFile& code);    // false if the blob is missing, older than the source or one of its includes, or not SPIR-V
+    void createModule(const uint32_t* code, const size_t size);
     const System* system;
     ShaderStageInfo shader;
 };
@@ -0,0 +1,21 @@
+#ifndef SIMD_MATH_HPP
+#define SIMD_MATH_HPP
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include<glm/mat4x4.hpp>
+#include<cstdint>
+
+struct BoundingVolume       // axis aligned box and a sphere around the same center
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 extents = glm::vec3(-1.0f);   // half sizes, negative when empty
+    float radius = -1.0f;
+};
+
+void multiplyMatrices(const glm::mat4& left, const glm::mat4& right, glm::mat4& result);    // result = left * right, result may alias either operand
+const BoundingVolume transformBoundingVolume(const BoundingVolume& volume, const glm::mat4& matrix);     // the box is refitted around the transformed one
+const BoundingVolume mergeBoundingVolumes(const BoundingVolume& first, const BoundingVolume& second);
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planes);     // 6 normalized planes facing inwards, depth in [0, 1]
+void cullBoundingBoxes(const glm::vec4* planes, const float* const* centers, const float* const* extents, const uint32_t count, uint8_t* visible);   // centers and extents are per axis arrays, visible[i] is 1 if box i intersects the frustum
+
+#endif
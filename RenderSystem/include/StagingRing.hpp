@@ -0,0 +1,50 @@
+#ifndef STAGING_RING_HPP
+#define STAGING_RING_HPP
+#include<System.hpp>
+#include<MemoryPool.hpp>
+#include<SynchronizationPool.hpp>
+#include<deque>
+
+class StagingRing
+{
+public:
+    StagingRing();
+    void create(const System* system, 
+        const SynchronizationPool* syncPool, 
+        MemoryPool* memoryPool, 
+        const MemoryAllocation& memory,     // must be host visible and at least "size" bytes long
+        const VkDeviceSize size,            // must be a multiple of alignment
+        const VkDeviceSize alignment);
+    const bool allocate(const VkDeviceSize size, VkDeviceSize& offset);   // returns false if there is no free space until some fence signals
+    void* getPtr(const VkDeviceSize offset) const;
+    const VkDeviceSize getSize() const;
+    void flushPending();
+    void submit(const uint32_t fence);  // tags every allocation made since the previous submit with the fence that consumes them
+    void reclaim();                     // never waits, only frees regions whose fences have already signaled
+    void destroy();
+    ~StagingRing();
+private:
+    struct Region
+    {
+        VkDeviceSize end;
+        uint32_t fence;
+    };
+
+    const bool isIdle() const;
+
+    const SynchronizationPool* syncPool;
+    MemoryPool* memoryPool;
+    MemoryAllocation memory;
+    void* mappedMemory = nullptr;
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 1;
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    std::deque<Region> regions;
+    bool hasPending = false;
+    bool pendingWrapped = false;
+    VkDeviceSize pendingBegin = 0;
+    VkDeviceSize pendingWrapEnd = 0;
+};
+
+#endif
@@ -16,6 +16,7 @@ public:
     const VkSemaphore& getSemaphore(const uint32_t index) const;
     void waitForFences(const uint32_t first, const uint32_t count = 1, const VkBool32 waitAll = VK_TRUE, const uint64_t timeout = (~0ull)) const;
     void resetFences(const uint32_t first, const uint32_t count = 1) const;
+    const bool isFenceSignaled(const uint32_t index) const;
     void destroy();
     ~SynchronizationPool();
 private:
@@ -2,6 +2,8 @@
 #define SYSTEM_HPP
 #include<vulkan/vulkan.h>
 #include<Window.hpp>
+#include<string>
+#include<vector>
 
 struct QueueInfo
 {
@@ -13,13 +15,17 @@ class System
 {
 public:
     System();
-    void create(const Window& window, const bool enableDebug, const VkPhysicalDeviceFeatures& enabledFeatures);
+    void create(const Window& window, const bool enableDebug, const VkPhysicalDeviceFeatures& enabledFeatures, const VkPhysicalDeviceFeatures& optionalFeatures = {}, const std::vector<const char*>& optionalExtensions = {});   // optional features and device extensions are only enabled if supported
+    const VkPhysicalDeviceFeatures& getEnabledFeatures() const;
+    const bool isExtensionEnabled(const char* name) const;
     const VkPhysicalDevice& getPhysicalDevice() const;
     const VkSurfaceKHR& getSurface() const;
     const VkSurfaceCapabilitiesKHR getSurfaceCapabilities() const;
     const VkDevice& getDevice() const;
     const QueueInfo& getPresentQueue() const;
     const QueueInfo& getGraphicsQueue() const;
+    const QueueInfo& getTransferQueue() const;     // same as graphics queue if there is no dedicated transfer family
+    const bool hasDedicatedTransferQueue() const;
     void destroy();
     ~System();
 private:
@@ -27,15 +33,18 @@ private:
     VkPhysicalDevice physicalDevice;
     VkDevice device;
     VkSurfaceKHR surface;
+    VkPhysicalDeviceFeatures enabledFeatures;
+    std::vector<std::string> enabledExtensions;
     QueueInfo graphicsQueue;
     QueueInfo presentQueue;
+    QueueInfo transferQueue;
     VkDebugUtilsMessengerEXT debugMessenger;
 
     void createInstance(const char** customExtensions, const uint32_t& extensionCount, const bool enableDebug);
     void createDebugMessenger();
     void pickPhysicalDevice();
     void pickQueueFamilies();
-    void createDevice(const VkPhysicalDeviceFeatures& enabledFeatures);
+    void createDevice(const VkPhysicalDeviceFeatures& requiredFeatures, const VkPhysicalDeviceFeatures& optionalFeatures, const std::vector<const char*>& optionalExtensions);
     void obtainQueues();
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data, void* userData);
@@ -0,0 +1,30 @@
+#ifndef TEXTURE_COMPRESSOR_HPP
+#define TEXTURE_COMPRESSOR_HPP
+#include<Utils.hpp>
+
+class TextureCompressor     // encodes RGBA8 images into 4x4 blocks on the CPU, the same image always gives the same blocks
+{
+public:
+    static const uint32_t getBlockSize(const VkFormat format);     // bytes per block, 0 if the format can't be encoded
+    static const uint32_t getMipmapLevelCount(const VkExtent2D& extent);   // full chain down to 1x1
+    static const VkExtent2D getMipmapExtent(const VkExtent2D& extent, const uint32_t level);   // halved per level and rounded down, never below 1
+    static const size_t getCompressedSize(const VkFormat format, const VkExtent2D& extent);  // partial blocks at the right and bottom edges are stored whole
+    static void compress(const VkFormat format, const unsigned char* pixels, const VkExtent2D& extent, unsigned char* blocks);  // BC1 drops alpha, BC5 keeps red and green only
+    static void downsample(const unsigned char* pixels, const VkExtent2D& extent, const bool normalMap, unsigned char* result);  // 2x2 box filter into the next level, normal map texels are renormalized
+private:
+    struct BC7Block         // mode 6: one subset, 7 bit RGBA endpoints with a p-bit each, 4 bit indices
+    {
+        uint32_t endpoints[2][4];
+        uint32_t pBits[2];
+        uint32_t indices[16];
+    };
+    static void loadBlock(const unsigned char* pixels, const VkExtent2D& extent, const uint32_t x, const uint32_t y, unsigned char* block);    // 16 RGBA texels, clamped at the edges
+    static void computePrincipalAxis(const unsigned char* block, const uint32_t channelCount, float* mean, float* axis);     // axis is 0 for flat blocks
+    static void compressBC1(const unsigned char* block, unsigned char* result);
+    static void compressBC4(const unsigned char* block, const uint32_t channel, unsigned char* result);
+    static void compressBC7(const unsigned char* block, unsigned char* result);
+    static void quantizeBC7Endpoint(const float* endpoint, uint32_t* quantized, uint32_t& pBit);
+    static const uint32_t fitBC7Indices(const unsigned char* block, BC7Block& encoded);     // returns the squared error
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<exception>
+#include<deque>
+#include<vector>
+
+class ThreadPool
+{
+public:
+    ThreadPool();
+    void create(const uint32_t threadCount = 0);      // 0 threads -> one per hardware thread
+    const uint32_t getThreadCount() const;
+    void enqueue(std::function<void()>&& job);
+    void wait();                                    // blocks until the queue is drained, rethrows the first exception thrown by a job
+    void destroy();
+    ~ThreadPool();
+private:
+    void work();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsFinished;
+    uint32_t runningJobCount = 0;
+    bool stopping = false;
+    std::exception_ptr firstException;
+};
+
+#endif
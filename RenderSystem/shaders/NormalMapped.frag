@@ -13,6 +13,7 @@ layout(set = 2, binding = 0) uniform Colors
 
 layout(set = 3, binding = 0) uniform sampler2D txt;
 
+// block compressed normal maps only keep x and y, z = sqrt(1 - dot(xy, xy)) once they are unpacked to [-1, 1]
 layout(set = 4, binding = 0) uniform sampler2D nMap;
 
 layout(location = 0) out vec4 outColor;
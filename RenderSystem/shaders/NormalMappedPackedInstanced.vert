@@ -0,0 +1,29 @@
+#version 460 core
+#extension GL_ARB_separate_shader_objects : enable
+//#extension GL_EXT_tessellation_shader : enable
+
+layout(location = 0) in vec4 pos;           // unorm in mesh bounds
+layout(location = 1) in vec2 tangent;       // octahedral
+layout(location = 2) in vec2 bitangent;     // octahedral
+layout(location = 3) in vec2 texCoord;
+layout(location = 4) in mat4 model;     // per instance
+
+layout(set = 0, binding = 0) uniform VP
+{
+    mat4 view;
+    mat4 proj;
+} vp;
+
+layout(push_constant) uniform PositionDecode
+{
+    vec4 offset;
+    vec4 scale;
+} decode;
+
+layout(location = 0) out vec2 uv;
+
+void main(void)
+{
+    uv = vec2(texCoord.x, 1 - texCoord.y);
+    gl_Position = vp.proj * vp.view * model * vec4(decode.offset.xyz + pos.xyz * decode.scale.xyz, 0);
+}
\ No newline at end of file
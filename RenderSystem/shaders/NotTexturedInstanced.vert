@@ -0,0 +1,19 @@
+#version 460 core
+#extension GL_ARB_separate_shader_objects : enable
+//#extension GL_EXT_tessellation_shader : enable
+
+layout(location = 0) in vec4 posAndNormX;
+layout(location = 1) in vec4 tanAndNormY;
+layout(location = 2) in vec4 btanAndNormZ;
+layout(location = 3) in mat4 model;     // per instance
+
+layout(set = 0, binding = 0) uniform VP
+{
+    mat4 view;
+    mat4 proj;
+} vp;
+
+void main(void)
+{
+    gl_Position = vp.proj * vp.view * model * vec4(posAndNormX.xyz, 0);
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 460 core
+#extension GL_ARB_separate_shader_objects : enable
+//#extension GL_EXT_tessellation_shader : enable
+
+layout(location = 0) in vec4 posAndBitangentSign;   // unorm in mesh bounds, w = 0 -> negative bitangent
+layout(location = 1) in vec2 normal;                // octahedral
+layout(location = 2) in vec2 tangent;               // octahedral
+
+layout(set = 0, binding = 0) uniform VP
+{
+    mat4 view;
+    mat4 proj;
+} vp;
+
+layout(set = 1, binding = 0) uniform M
+{
+    mat4 model;
+} m;
+
+layout(push_constant) uniform PositionDecode
+{
+    vec4 offset;
+    vec4 scale;
+} decode;
+
+void main(void)
+{
+    vec3 pos = decode.offset.xyz + posAndBitangentSign.xyz * decode.scale.xyz;
+    gl_Position = vp.proj * vp.view * m.model * vec4(pos, 0);
+}
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include<BoundingVolumeHierarchy.hpp>
+#include<algorithm>
+#include<cfloat>
+#include<cmath>
+
+static const float getSurfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+    const glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(){}
+
+void BoundingVolumeHierarchy::build(const std::vector<BoundingVolume>& volumes)
+{
+    clear();
+    if(volumes.empty()) return;
+    primitives.resize(volumes.size());
+    for(auto ind = 0; ind < primitives.size(); ++ind) primitives[ind] = ind;
+
+    // a binary tree over n primitives never has more than 2n - 1 nodes, so references into it stay valid while splitting
+
+    nodes.reserve(2 * volumes.size());
+    nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), 0, static_cast<uint32_t>(volumes.size()), 0});
+    computeNodeBounds(nodes[0], volumes);
+    std::vector<uint32_t> pendingNodes = {0};
+    while(!pendingNodes.empty())
+    {
+        const uint32_t nodeIndex = pendingNodes.back();
+        pendingNodes.pop_back();
+        if(!split(nodeIndex, volumes)) continue;
+        pendingNodes.push_back(nodes[nodeIndex].leftChild);
+        pendingNodes.push_back(nodes[nodeIndex].leftChild + 1);
+    }
+    storeLeafOrderBounds(volumes);
+}
+
+const bool BoundingVolumeHierarchy::split(const uint32_t nodeIndex, const std::vector<BoundingVolume>& volumes)
+{
+    // centroids are binned along each axis, the cheapest bin boundary by SAH wins;
+    // identical centroids can't be binned, those ranges are simply halved
+
+    TreeNode& node = nodes[nodeIndex];
+    if(node.primitiveCount <= MAX_LEAF_SIZE) return false;
+    const auto first = primitives.begin() + node.firstPrimitive, last = first + node.primitiveCount;
+    glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+    for(auto primitive = first; primitive != last; ++primitive)
+    {
+        centroidMin = glm::min(centroidMin, volumes[*primitive].center);
+        centroidMax = glm::max(centroidMax, volumes[*primitive].center);
+    }
+    auto getBin = [&](const uint32_t primitive, const uint32_t axis)
+    {
+        const float position = (volumes[primitive].center[axis] - centroidMin[axis]) / (centroidMax[axis] - centroidMin[axis]);
+        return std::min(static_cast<uint32_t>(position * BIN_COUNT), BIN_COUNT - 1);
+    };
+
+    float bestCost = FLT_MAX;
+    uint32_t bestAxis = 0, bestBin = 0;
+    for(auto axis = 0; axis < 3; ++axis)
+    {
+        if(centroidMax[axis] <= centroidMin[axis]) continue;
+        uint32_t binCounts[BIN_COUNT] = {};
+        glm::vec3 binMin[BIN_COUNT], binMax[BIN_COUNT];
+        std::fill(binMin, binMin + BIN_COUNT, glm::vec3(FLT_MAX));
+        std::fill(binMax, binMax + BIN_COUNT, glm::vec3(-FLT_MAX));
+        for(auto primitive = first; primitive != last; ++primitive)
+        {
+            const uint32_t bin = getBin(*primitive, axis);
+            const BoundingVolume& volume = volumes[*primitive];
+            ++binCounts[bin];
+            binMin[bin] = glm::min(binMin[bin], volume.center - glm::max(volume.extents, glm::vec3(0.0f)));
+            binMax[bin] = glm::max(binMax[bin], volume.center + glm::max(volume.extents, glm::vec3(0.0f)));
+        }
+
+        // right side areas are accumulated first, the left sweep then evaluates every boundary
+
+        float rightAreas[BIN_COUNT];
+        uint32_t rightCounts[BIN_COUNT];
+        glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+        uint32_t sweepCount = 0;
+        for(auto bin = BIN_COUNT - 1; bin > 0; --bin)
+        {
+            sweepMin = glm::min(sweepMin, binMin[bin]);
+            sweepMax = glm::max(sweepMax, binMax[bin]);
+            sweepCount += binCounts[bin];
+            rightAreas[bin] = getSurfaceArea(sweepMin, sweepMax);
+            rightCounts[bin] = sweepCount;
+        }
+        sweepMin = glm::vec3(FLT_MAX);
+        sweepMax = glm::vec3(-FLT_MAX);
+        sweepCount = 0;
+        for(auto bin = 0; bin < BIN_COUNT - 1; ++bin)
+        {
+            sweepMin = glm::min(sweepMin, binMin[bin]);
+            sweepMax = glm::max(sweepMax, binMax[bin]);
+            sweepCount += binCounts[bin];
+            if(!sweepCount || !rightCounts[bin + 1]) continue;
+            const float cost = sweepCount * getSurfaceArea(sweepMin, sweepMax) + rightCounts[bin + 1] * rightAreas[bin + 1];
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    auto middle = first + node.primitiveCount / 2;
+    if(bestCost < FLT_MAX)
+    {
+        // splitting has to beat intersecting every primitive of the node, small nodes may stay leaves
+
+        const float leafCost = node.primitiveCount * getSurfaceArea(node.min, node.max);
+        if(bestCost >= leafCost && node.primitiveCount <= BATCH_SIZE) return false;
+        middle = std::partition(first, last, [&](const uint32_t primitive){ return getBin(primitive, bestAxis) <= bestBin; });
+    }
+    const uint32_t leftCount = middle - first;
+    const uint32_t leftChild = nodes.size();
+    node.leftChild = leftChild;
+    nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), node.firstPrimitive, leftCount, 0});
+    nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), node.firstPrimitive + leftCount, node.primitiveCount - leftCount, 0});
+    computeNodeBounds(nodes[leftChild], volumes);
+    computeNodeBounds(nodes[leftChild + 1], volumes);
+    return true;
+}
+
+void BoundingVolumeHierarchy::computeNodeBounds(TreeNode& node, const std::vector<BoundingVolume>& volumes) const
+{
+    node.min = glm::vec3(FLT_MAX);
+    node.max = glm::vec3(-FLT_MAX);
+    for(auto ind = node.firstPrimitive; ind < node.firstPrimitive + node.primitiveCount; ++ind)
+    {
+        const BoundingVolume& volume = volumes[primitives[ind]];
+        if(volume.radius < 0.0f) continue;
+        node.min = glm::min(node.min, volume.center - volume.extents);
+        node.max = glm::max(node.max, volume.center + volume.extents);
+    }
+}
+
+void BoundingVolumeHierarchy::storeLeafOrderBounds(const std::vector<BoundingVolume>& volumes)
+{
+    for(auto axis = 0; axis < 3; ++axis)
+    {
+        centers[axis].resize(primitives.size());
+        extents[axis].resize(primitives.size());
+        for(auto ind = 0; ind < primitives.size(); ++ind)
+        {
+            centers[axis][ind] = volumes[primitives[ind]].center[axis];
+            extents[axis][ind] = volumes[primitives[ind]].extents[axis];
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::refit(const std::vector<BoundingVolume>& volumes)
+{
+    // children are always stored after their parent, so a reverse walk visits them first
+
+    for(auto ind = static_cast<int32_t>(nodes.size()) - 1; ind >= 0; --ind)
+    {
+        TreeNode& node = nodes[ind];
+        if(!node.leftChild)
+        {
+            computeNodeBounds(node, volumes);
+            continue;
+        }
+        node.min = glm::min(nodes[node.leftChild].min, nodes[node.leftChild + 1].min);
+        node.max = glm::max(nodes[node.leftChild].max, nodes[node.leftChild + 1].max);
+    }
+    storeLeafOrderBounds(volumes);
+}
+
+void BoundingVolumeHierarchy::cull(const glm::vec4* planes, uint8_t* visible, std::vector<uint32_t>& pendingNodes) const
+{
+    // subtrees entirely inside are accepted without looking at their primitives, small intersecting ones go through the SIMD box test
+
+    std::fill(visible, visible + primitives.size(), 0);
+    if(nodes.empty()) return;
+    pendingNodes.clear();
+    pendingNodes.push_back(0);
+    uint8_t batchVisibility[BATCH_SIZE];
+    while(!pendingNodes.empty())
+    {
+        const TreeNode& node = nodes[pendingNodes.back()];
+        pendingNodes.pop_back();
+        const glm::vec3 center = (node.min + node.max) * 0.5f, extent = (node.max - node.min) * 0.5f;
+        bool outside = false, inside = true;
+        for(auto plane = 0; plane < 6 && !outside; ++plane)
+        {
+            const glm::vec4& p = planes[plane];
+            const float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+            const float reach = std::fabs(p.x) * extent.x + std::fabs(p.y) * extent.y + std::fabs(p.z) * extent.z;
+            outside = distance + reach < 0.0f;
+            inside = inside && distance - reach >= 0.0f;
+        }
+        if(outside) continue;
+        if(inside)
+        {
+            for(auto ind = node.firstPrimitive; ind < node.firstPrimitive + node.primitiveCount; ++ind) visible[primitives[ind]] = 1;
+            continue;
+        }
+        if(node.primitiveCount <= BATCH_SIZE)
+        {
+            const float* batchCenters[3] = {centers[0].data() + node.firstPrimitive, centers[1].data() + node.firstPrimitive, centers[2].data() + node.firstPrimitive};
+            const float* batchExtents[3] = {extents[0].data() + node.firstPrimitive, extents[1].data() + node.firstPrimitive, extents[2].data() + node.firstPrimitive};
+            cullBoundingBoxes(planes, batchCenters, batchExtents, node.primitiveCount, batchVisibility);
+            for(auto ind = 0; ind < node.primitiveCount; ++ind) visible[primitives[node.firstPrimitive + ind]] = batchVisibility[ind];
+            continue;
+        }
+        pendingNodes.push_back(node.leftChild);
+        pendingNodes.push_back(node.leftChild + 1);
+    }
+}
+
+const bool BoundingVolumeHierarchy::intersectBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection, const float maxDistance, float& entry)
+{
+    const glm::vec3 first = (min - origin) * inverseDirection, second = (max - origin) * inverseDirection;
+    const glm::vec3 entries = glm::min(first, second), exits = glm::max(first, second);
+    entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    const float exit = std::min(std::min(exits.x, exits.y), exits.z);
+    return entry <= exit && entry < maxDistance;
+}
+
+const uint32_t BoundingVolumeHierarchy::raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance, std::vector<uint32_t>& pendingNodes) const
+{
+    // the nearer child is visited first, so farther subtrees are mostly rejected by the distance found so far
+
+    uint32_t closest = ~0U;
+    distance = FLT_MAX;
+    if(nodes.empty()) return closest;
+    // axis parallel rays would turn into 0 * infinity on box faces, a tiny component keeps the slabs well defined
+
+    glm::vec3 inverseDirection;
+    for(auto axis = 0; axis < 3; ++axis) inverseDirection[axis] = 1.0f / (std::fabs(direction[axis]) > FLT_MIN ? direction[axis] : FLT_MIN);
+    pendingNodes.clear();
+    pendingNodes.push_back(0);
+    while(!pendingNodes.empty())
+    {
+        const TreeNode& node = nodes[pendingNodes.back()];
+        pendingNodes.pop_back();
+        float entry;
+        if(!intersectBox(node.min, node.max, origin, inverseDirection, distance, entry)) continue;
+        if(node.leftChild)
+        {
+            float leftEntry, rightEntry;
+            const bool leftHit = intersectBox(nodes[node.leftChild].min, nodes[node.leftChild].max, origin, inverseDirection, distance, leftEntry);
+            const bool rightHit = intersectBox(nodes[node.leftChild + 1].min, nodes[node.leftChild + 1].max, origin, inverseDirection, distance, rightEntry);
+            if(leftHit && rightHit)
+            {
+                pendingNodes.push_back(leftEntry < rightEntry ? node.leftChild + 1 : node.leftChild);
+                pendingNodes.push_back(leftEntry < rightEntry ? node.leftChild : node.leftChild + 1);
+            }
+            else if(leftHit) pendingNodes.push_back(node.leftChild);
+            else if(rightHit) pendingNodes.push_back(node.leftChild + 1);
+            continue;
+        }
+        for(auto ind = node.firstPrimitive; ind < node.firstPrimitive + node.primitiveCount; ++ind)
+        {
+            const glm::vec3 center(centers[0][ind], centers[1][ind], centers[2][ind]), extent(extents[0][ind], extents[1][ind], extents[2][ind]);
+            if(extent.x < 0.0f) continue;
+            if(intersectBox(center - extent, center + extent, origin, inverseDirection, distance, entry))
+            {
+                distance = entry;
+                closest = primitives[ind];
+            }
+        }
+    }
+    return closest;
+}
+
+const uint32_t BoundingVolumeHierarchy::getPrimitiveCount() const
+{
+    return primitives.size();
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+    nodes.clear();
+    primitives.clear();
+    for(auto axis = 0; axis < 3; ++axis)
+    {
+        centers[axis].clear();
+        extents[axis].clear();
+    }
+}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy()
+{
+    clear();
+}
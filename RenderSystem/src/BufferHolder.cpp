@@ -1,5 +1,26 @@
 #include<BufferHolder.hpp>
 
+void BufferHolder::recordOwnershipTransferCommands(const VkCommandBuffer& cmd, const VkBuffer& buffer, const VkDeviceSize offset, const VkDeviceSize size, const uint32_t srcQueueFamily, const uint32_t dstQueueFamily, const VkAccessFlags access, const VkPipelineStageFlags stages, const bool release)
+{
+    VkBufferMemoryBarrier bufferBarrier = 
+    {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        nullptr,
+        release ? access : 0,
+        release ? 0 : access,
+        srcQueueFamily,
+        dstQueueFamily,
+        buffer,
+        offset,
+        size
+    };
+
+    vkCmdPipelineBarrier(cmd, 
+        release ? stages : VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
+        release ? VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : stages, 
+        0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
+
 BufferHolder::BufferHolder()
 {
 
@@ -58,7 +79,7 @@ const VkMemoryRequirements BufferHolder::getMemoryRequirements(const uint32_t in
     return requirements;
 }
 
-void BufferHolder::bindMemory(const VkDeviceMemory& memory, const uint32_t offset, const uint32_t bufferIndex)
+void BufferHolder::bindMemory(const VkDeviceMemory& memory, const VkDeviceSize offset, const uint32_t bufferIndex)
 {
     checkResult(vkBindBufferMemory(system->getDevice(), buffers[bufferIndex], memory, offset), "Failed to bind buffer memory");
 }
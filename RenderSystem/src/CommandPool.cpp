@@ -1,13 +1,13 @@
 #include<CommandPool.hpp>
 
-CommandPool::CommandPool(){}
+CommandPool::CommandPool(): pool(0){}
 
 const VkCommandPool& CommandPool::getPool() const
 {
     return pool;
 }
 
-void CommandPool::create(const System* system, const bool dynamicPool)
+void CommandPool::create(const System* system, const bool dynamicPool, const uint32_t queueFamilyIndex)
 {
     this->system = system;
     VkCommandPoolCreateInfo poolInfo = 
@@ -15,7 +15,7 @@ void CommandPool::create(const System* system, const bool dynamicPool)
         VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         nullptr,
         dynamicPool ? (VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) : VkCommandPoolCreateFlags(),
-        system->getGraphicsQueue().familyIndex
+        queueFamilyIndex == ~0U ? system->getGraphicsQueue().familyIndex : queueFamilyIndex
     };
     checkResult(vkCreateCommandPool(system->getDevice(), &poolInfo, nullptr, &pool), "Failed to create command pool.\n");
 }
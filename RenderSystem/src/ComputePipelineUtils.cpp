@@ -0,0 +1,56 @@
+#include<ComputePipelineUtils.hpp>
+
+ComputePipelinePool::ComputePipelinePool(){}
+
+void ComputePipelinePool::create(const System* system, const uint32_t pipelineCount)
+{
+    this->system = system;
+    pipelines.create(pipelineCount);
+}
+
+void ComputePipelinePool::createPipeline(const uint32_t index, const ShaderStageInfo& shader, const VkPipelineLayout& layout, const VkPipelineCache& cache)
+{
+    if(shader.stage != VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT) reportError("Compute pipelines need a compute shader.\n");
+    VkComputePipelineCreateInfo pipelineInfo = 
+    {
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        nullptr,
+        0,
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            nullptr,
+            0,
+            shader.stage,
+            shader.module,
+            "main",
+            nullptr
+        },
+        layout,
+        VK_NULL_HANDLE,
+        -1
+    };
+    checkResult(vkCreateComputePipelines(system->getDevice(), cache, 1, &pipelineInfo, nullptr, &pipelines[index]), "Failed to create compute pipeline.\n");
+}
+
+const VkPipeline& ComputePipelinePool::operator[](const uint32_t index) const
+{
+    return pipelines[index];
+}
+
+void ComputePipelinePool::destroy()
+{
+    for(auto ind = 0; ind < pipelines.getSize(); ++ind)
+    {
+        if(pipelines[ind])
+        {
+            vkDestroyPipeline(system->getDevice(), pipelines[ind], nullptr);
+            pipelines[ind] = 0;
+        }
+    }
+    pipelines.clear();
+}
+
+ComputePipelinePool::~ComputePipelinePool()
+{
+    destroy();
+}
\ No newline at end of file
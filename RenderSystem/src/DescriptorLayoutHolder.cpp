@@ -25,7 +25,7 @@ void DescriptorLayoutHolder::createSetLayout(const uint32_t index, const Array<V
     checkResult(vkCreateDescriptorSetLayout(system->getDevice(), &setLayoutInfo, nullptr, &setLayouts[index]), "Failed to create layout.\n");
 }
 
-void DescriptorLayoutHolder::createPipelineLayout(const uint32_t index, const Array<uint32_t>& setLayoutIndices)
+void DescriptorLayoutHolder::createPipelineLayout(const uint32_t index, const Array<uint32_t>& setLayoutIndices, const Array<VkPushConstantRange>& pushConstantRanges)
 {
     Array<VkDescriptorSetLayout> layouts;
     layouts.create(setLayoutIndices.getSize());
@@ -40,8 +40,8 @@ void DescriptorLayoutHolder::createPipelineLayout(const uint32_t index, const Ar
         0,
         layouts.getSize(),
         layouts.getPtr(),
-        0,
-        nullptr
+        pushConstantRanges.getSize(),
+        pushConstantRanges.getSize() ? pushConstantRanges.getPtr() : nullptr
     };
     checkResult(vkCreatePipelineLayout(system->getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayouts[index]), "Failed to create layout.\n");
 }
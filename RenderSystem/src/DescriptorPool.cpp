@@ -2,7 +2,7 @@
 
 DescriptorPool::DescriptorPool(){}
 
-void DescriptorPool::create(const System* system, const uint32_t setCount, const Array<VkDescriptorPoolSize>& poolSizes)
+void DescriptorPool::create(const System* system, const uint32_t setCount, const Array<VkDescriptorPoolSize>& poolSizes, const VkDescriptorPoolCreateFlags flags)
 {
     this->system = system;
     sets.create(setCount);
@@ -10,7 +10,7 @@ void DescriptorPool::create(const System* system, const uint32_t setCount, const
     {
         VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         nullptr,
-        0,
+        flags,
         setCount,
         poolSizes.getSize(),
         poolSizes.getPtr()
@@ -31,6 +31,12 @@ void DescriptorPool::allocateSets(const uint32_t first, const Array<VkDescriptor
     checkResult(vkAllocateDescriptorSets(system->getDevice(), &allocInfo, &sets[first]), "Failed to allocate descriptor sets.\n");
 }
 
+void DescriptorPool::freeSets(const uint32_t first, const uint32_t count)
+{
+    checkResult(vkFreeDescriptorSets(system->getDevice(), pool, count, &sets[first]), "Failed to free descriptor sets.\n");
+    for(auto ind = first; ind < first + count; ++ind) sets[ind] = 0;
+}
+
 void DescriptorPool::updateDescriptorSets(const VkDescriptorImageInfo* img, const VkDescriptorBufferInfo* buf, const VkDescriptorType type, const uint32_t set, const uint32_t binding, const uint32_t arrayElement, const uint32_t descriptorCount)
 {
     VkWriteDescriptorSet write = 
@@ -1,4 +1,5 @@
 #include<ImageHolder.hpp>
+#include<algorithm>
 #include<cmath>
 
 void ImageHolder::recordLayoutChangeCommands(const VkCommandBuffer& cmd, const VkImageLayout oldLayout, const VkImageLayout newLayout, const VkImage& img, const VkImageSubresourceRange& subresource)
@@ -98,6 +99,28 @@ void ImageHolder::recordLayoutChangeCommands(const VkCommandBuffer& cmd, const V
     vkCmdPipelineBarrier(cmd, srcStageFlags, dstStageFlags, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
 }
 
+void ImageHolder::recordOwnershipTransferCommands(const VkCommandBuffer& cmd, const VkImage& img, const VkImageLayout layout, const VkImageSubresourceRange& subresource, const uint32_t srcQueueFamily, const uint32_t dstQueueFamily, const VkAccessFlags access, const VkPipelineStageFlags stages, const bool release)
+{
+    VkImageMemoryBarrier imageBarrier = 
+    {
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        nullptr,
+        release ? access : 0,
+        release ? 0 : access,
+        layout,
+        layout,
+        srcQueueFamily,
+        dstQueueFamily,
+        img,
+        subresource
+    };
+
+    vkCmdPipelineBarrier(cmd, 
+        release ? stages : VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
+        release ? VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : stages, 
+        0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
 void ImageHolder::recordMipmapGenCommands(const VkCommandBuffer& cmd, const VkImageLayout oldLayout, const VkImageLayout newLayout, const VkImage& img, const VkExtent2D& imageExtent, const uint32_t mipmapLevelCount, const VkImageLayout mipmapImageLayout)
 {
     if(mipmapLevelCount == 1) return;
@@ -147,11 +170,11 @@ void ImageHolder::recordMipmapGenCommands(const VkCommandBuffer& cmd, const VkIm
             srcLayers,
             {{0, 0, 0}, {static_cast<int32_t>(srcExtent.width), static_cast<int32_t>(srcExtent.height), 1}},
             dstLayers,
-            {{0, 0, 0}, {static_cast<int32_t>(srcExtent.width / 2), static_cast<int32_t>(srcExtent.height) / 2, 1}},
+            {{0, 0, 0}, {static_cast<int32_t>(std::max(srcExtent.width / 2, 1U)), static_cast<int32_t>(std::max(srcExtent.height / 2, 1U)), 1}},
         };
         vkCmdBlitImage(cmd, img, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, img, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitInfo, VkFilter::VK_FILTER_LINEAR);
-        srcExtent.width /= 2;
-        srcExtent.height /= 2;
+        srcExtent.width = std::max(srcExtent.width / 2, 1U);
+        srcExtent.height = std::max(srcExtent.height / 2, 1U);
         recordLayoutChangeCommands(cmd, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, img, dstSubresource);
     }
     srcSubresource.baseMipLevel = 0;
@@ -161,12 +184,14 @@ void ImageHolder::recordMipmapGenCommands(const VkCommandBuffer& cmd, const VkIm
 
 const uint32_t ImageHolder::getMipmapLevelCount(const VkExtent2D& imageExtent)
 {
-    return std::log2(std::min(imageExtent.width, imageExtent.height));
+    // the chain goes on until both sides are 1, the shorter one stays at 1 meanwhile
+
+    return static_cast<uint32_t>(std::log2(std::max(std::max(imageExtent.width, imageExtent.height), 1U))) + 1;
 }
 
 const uint32_t ImageHolder::getMipmapLevelCount(const VkExtent3D& imageExtent)
 {
-    return std::log2(std::min(imageExtent.width, imageExtent.height));
+    return getMipmapLevelCount(VkExtent2D{imageExtent.width, imageExtent.height});
 }
 
 bool ImageHolder::checkFormatSupport(const VkFormat format, const VkFormatFeatureFlags features, const VkImageTiling tiling) const
@@ -242,7 +267,7 @@ void ImageHolder::initImage(const uint32_t index,
     const VkFormat format, 
     const VkExtent3D& extent, 
     const bool enableMipmapping,
-    uint32_t& mipmapLevels,                 // if mipmapping is enabled, rewrites with mipmap level count
+    uint32_t& mipmapLevels,                 // if mipmapping is enabled, rewrites with mipmap level count, nonzero counts are only clamped to the format limit
     const VkSampleCountFlagBits samples,
     const VkImageTiling tiling, 
     const VkImageUsageFlags usage)
@@ -253,7 +278,7 @@ void ImageHolder::initImage(const uint32_t index,
     if(extent.width * extent.height * extent.depth > formatProperties.maxResourceSize) reportError("Too large image.\n");
     if(enableMipmapping)
     {
-        mipmapLevels = std::min(formatProperties.maxMipLevels, getMipmapLevelCount(extent));
+        mipmapLevels = std::min(formatProperties.maxMipLevels, mipmapLevels ? mipmapLevels : getMipmapLevelCount(extent));
     }
     VkImageCreateInfo imageInfo = 
     {
@@ -359,7 +384,7 @@ const VkMemoryRequirements ImageHolder::getMemoryRequirements(const uint32_t ind
     return requirements;
 }
 
-void ImageHolder::bindMemory(const VkDeviceMemory& memory, const uint32_t offset, const uint32_t imageIndex) const
+void ImageHolder::bindMemory(const VkDeviceMemory& memory, const VkDeviceSize offset, const uint32_t imageIndex) const
 {
     checkResult(vkBindImageMemory(system->getDevice(), images[imageIndex], memory, offset), "Failed to bind image memory.\n");
 }
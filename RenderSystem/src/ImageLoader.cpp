@@ -1,7 +1,41 @@
 #include<ImageLoader.hpp>
+#include<Constants.hpp>
+#include<TextureCompressor.hpp>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<limits>
+#include<thread>
 #define STB_IMAGE_IMPLEMENTATION
 #include<External/Stb/stb_image.h>
 
+// mipmap cache files: the header, the offset of every level, then the levels back to back
+
+struct MipmapCacheHeader
+{
+    char identifier[8];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t normalMap;
+    uint64_t sourceSize;
+    int64_t sourceTime;         // modification time of the source in the file clock's ticks
+    uint64_t dataSize;
+};
+
+static const char MIPMAP_CACHE_IDENTIFIER[8] = {'M', 'I', 'P', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t MIPMAP_CACHE_VERSION = 1;     // has to change with the output of the filters or the encoders
+
+// bytes of one level of a mipmap chain, 0 for formats the chains are never built in
+
+static const size_t getLevelSize(const VkFormat format, const VkExtent2D& extent)
+{
+    if(format == VkFormat::VK_FORMAT_R8G8B8A8_UNORM) return static_cast<size_t>(extent.width) * extent.height * 4;
+    return TextureCompressor::getCompressedSize(format, extent);
+}
+
 ImageLoader::ImageLoader()
 {
 }
@@ -30,10 +64,133 @@ ImageLoader::Image::Image(){}
 
 void ImageLoader::Image::load(const char* filename, int forcedChannels)
 {
-    data = stbi_load(filename, &width, &height, &channels, forcedChannels);
+    // stb decodes from the mapping instead of reading the file through stdio buffers
+
+    MappedFile file;
+    data = nullptr;
+    if(file.open(filename) && file.getSize() <= std::numeric_limits<int>::max()) data = stbi_load_from_memory(file.getData(), file.getSize(), &width, &height, &channels, forcedChannels);
     if(forcedChannels != 0) channels = forcedChannels;
 }
 
+void ImageLoader::Image::generateMipmaps(const VkFormat format, const bool normalMap)
+{
+    // every level is filtered from the decoded previous one, so block artifacts don't accumulate down the chain;
+    // uncompressed levels are filtered straight into the chain
+
+    if(!data || channels != 4) reportError("Only decoded RGBA images can get mipmaps.\n");
+    const bool blockCompressed = format != VkFormat::VK_FORMAT_R8G8B8A8_UNORM;
+    const VkExtent2D extent = getExtent();
+    const uint32_t levelCount = TextureCompressor::getMipmapLevelCount(extent);
+    size_t size = 0;
+    levelOffsets.resize(levelCount);
+    for(auto level = 0; level < levelCount; ++level)
+    {
+        levelOffsets[level] = size;
+        size += getLevelSize(format, TextureCompressor::getMipmapExtent(extent, level));
+    }
+    levelData.resize(size);
+    std::vector<unsigned char> levelPixels[2];
+    const unsigned char* pixels = data;
+    for(auto level = 0; level < levelCount; ++level)
+    {
+        const VkExtent2D levelExtent = TextureCompressor::getMipmapExtent(extent, level);
+        unsigned char* levelTarget = levelData.data() + levelOffsets[level];
+        if(level)
+        {
+            unsigned char* target = levelTarget;
+            if(blockCompressed)
+            {
+                levelPixels[level % 2].resize(static_cast<size_t>(levelExtent.width) * levelExtent.height * 4);
+                target = levelPixels[level % 2].data();
+            }
+            TextureCompressor::downsample(pixels, TextureCompressor::getMipmapExtent(extent, level - 1), normalMap, target);
+            pixels = target;
+        }
+        if(blockCompressed) TextureCompressor::compress(format, pixels, levelExtent, levelTarget);
+        else if(!level) memcpy(levelTarget, pixels, static_cast<size_t>(levelExtent.width) * levelExtent.height * 4);
+    }
+    stbi_image_free(data);
+    data = nullptr;
+    this->format = format;
+    this->normalMap = normalMap;
+}
+
+const bool ImageLoader::Image::loadMipmaps(const char* filename, const char* sourceFilename, const VkFormat format, const bool normalMap)
+{
+    // the header and the offsets are copied out, the levels are uploaded straight from the mapping
+
+    MipmapCacheHeader header;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if(!MappedFile::getStamp(sourceFilename, sourceSize, sourceTime)) return false;
+    MappedFile file;
+    if(!file.open(filename) || file.getSize() < sizeof(header)) return false;
+    memcpy(&header, file.getData(), sizeof(header));
+    if(memcmp(header.identifier, MIPMAP_CACHE_IDENTIFIER, sizeof(header.identifier)) != 0 || header.version != MIPMAP_CACHE_VERSION) return false;
+    if(header.format != format || header.normalMap != normalMap || header.sourceSize != sourceSize || header.sourceTime != sourceTime) return false;
+    if(!header.width || !header.height || header.width > MAX_IMAGE_DIMENSION || header.height > MAX_IMAGE_DIMENSION) return false;
+    const VkExtent2D extent = {header.width, header.height};
+    if(header.levelCount != TextureCompressor::getMipmapLevelCount(extent)) return false;
+    const size_t dataOffset = sizeof(header) + header.levelCount * sizeof(uint64_t);
+    if(dataOffset > file.getSize() || header.dataSize > file.getSize() - dataOffset) return false;
+
+    // the levels are laid out exactly as generateMipmaps() does it, back to back from the first byte, so any other offset means a damaged file
+
+    std::vector<uint64_t> offsets(header.levelCount);
+    memcpy(offsets.data(), file.getData() + sizeof(header), offsets.size() * sizeof(uint64_t));
+    uint64_t expectedOffset = 0;
+    for(auto level = 0; level < header.levelCount; ++level)
+    {
+        const size_t levelSize = getLevelSize(format, TextureCompressor::getMipmapExtent(extent, level));
+        if(!levelSize || offsets[level] != expectedOffset) return false;
+        expectedOffset += levelSize;
+    }
+    if(expectedOffset != header.dataSize) return false;
+    unload();
+    width = header.width;
+    height = header.height;
+    channels = 4;
+    this->format = format;
+    this->normalMap = normalMap;
+    levelOffsets.assign(offsets.begin(), offsets.end());
+    cachedLevelData = file.getData() + dataOffset;
+    cachedLevelSize = header.dataSize;
+    cacheFile = std::move(file);
+    return true;
+}
+
+void ImageLoader::Image::saveMipmaps(const char* filename, const char* sourceFilename) const
+{
+    // written under a name only this thread uses and renamed, so readers never see a partly written file;
+    // a cache that can't be written is only reported, the next run rebuilds the mipmaps again
+
+    if(format == VkFormat::VK_FORMAT_UNDEFINED) reportError("Only mipmap chains can be cached.\n");
+    MipmapCacheHeader header = {};
+    memcpy(header.identifier, MIPMAP_CACHE_IDENTIFIER, sizeof(header.identifier));
+    header.version = MIPMAP_CACHE_VERSION;
+    header.format = format;
+    header.width = width;
+    header.height = height;
+    header.levelCount = levelOffsets.size();
+    header.normalMap = normalMap;
+    header.dataSize = getSize();
+    if(!MappedFile::getStamp(sourceFilename, header.sourceSize, header.sourceTime)) return;
+    const std::vector<uint64_t> offsets(levelOffsets.begin(), levelOffsets.end());
+    const std::string temporaryFilename = std::string(filename) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(getData()), getSize());
+    file.close();
+    std::error_code error;
+    if(file) std::filesystem::rename(temporaryFilename, filename, error);
+    if(!file || error)
+    {
+        std::filesystem::remove(temporaryFilename, error);
+        printLog((std::string("Failed to write texture cache ") + filename + "\n").c_str());
+    }
+}
+
 ImageLoader::Image& ImageLoader::Image::operator=(Image&& img)
 {
     width = img.width;
@@ -41,12 +198,22 @@ ImageLoader::Image& ImageLoader::Image::operator=(Image&& img)
     channels = img.channels;
     data = img.data;
     img.data = nullptr;
+    format = img.format;
+    normalMap = img.normalMap;
+    levelData = std::move(img.levelData);
+    levelOffsets = std::move(img.levelOffsets);
+    cacheFile = std::move(img.cacheFile);
+    cachedLevelData = img.cachedLevelData;
+    cachedLevelSize = img.cachedLevelSize;
+    img.cachedLevelData = nullptr;
+    img.cachedLevelSize = 0;
     return *this;
 }
 
 const unsigned char* ImageLoader::Image::getData() const
 {
-    return data;
+    if(format == VkFormat::VK_FORMAT_UNDEFINED) return data;
+    return cachedLevelData ? cachedLevelData : levelData.data();
 }
 
 const VkExtent2D ImageLoader::Image::getExtent() const
@@ -59,6 +226,27 @@ const uint32_t ImageLoader::Image::getChannelCount() const
     return channels;
 }
 
+const VkFormat ImageLoader::Image::getFormat() const
+{
+    return format;
+}
+
+const uint32_t ImageLoader::Image::getLevelCount() const
+{
+    return format == VkFormat::VK_FORMAT_UNDEFINED ? 1 : levelOffsets.size();
+}
+
+const size_t ImageLoader::Image::getLevelOffset(const uint32_t level) const
+{
+    return format == VkFormat::VK_FORMAT_UNDEFINED ? 0 : levelOffsets[level];
+}
+
+const size_t ImageLoader::Image::getSize() const
+{
+    if(format == VkFormat::VK_FORMAT_UNDEFINED) return static_cast<size_t>(width) * height * channels;
+    return cachedLevelData ? cachedLevelSize : levelData.size();
+}
+
 void ImageLoader::Image::unload()
 {
     if(data)
@@ -66,6 +254,11 @@ void ImageLoader::Image::unload()
         stbi_image_free(data);
         data = nullptr;
     }
+    levelData.clear();
+    levelData.shrink_to_fit();
+    cacheFile.close();
+    cachedLevelData = nullptr;
+    cachedLevelSize = 0;
 }
 
 ImageLoader::Image::~Image()
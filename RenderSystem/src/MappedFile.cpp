@@ -0,0 +1,87 @@
+#include<MappedFile.hpp>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#include<filesystem>
+
+MappedFile::MappedFile(){}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+    close();
+    data = other.data;
+    size = other.size;
+    other.data = nullptr;
+    other.size = 0;
+    return *this;
+}
+
+const bool MappedFile::open(const char* filename)
+{
+    // the descriptor isn't needed once the mapping exists; files are read front to back, so the kernel may read ahead
+
+    close();
+    const int descriptor = ::open(filename, O_RDONLY);
+    if(descriptor < 0) return false;
+    struct stat status;
+    if(fstat(descriptor, &status) != 0 || status.st_size <= 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+    void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+    if(mapping == MAP_FAILED) return false;
+    madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+    data = static_cast<unsigned char*>(mapping);
+    size = status.st_size;
+    return true;
+}
+
+const unsigned char* MappedFile::getData() const
+{
+    return data;
+}
+
+const size_t MappedFile::getSize() const
+{
+    return size;
+}
+
+const bool MappedFile::isOpen() const
+{
+    return data != nullptr;
+}
+
+void MappedFile::close()
+{
+    if(data)
+    {
+        munmap(data, size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+const bool MappedFile::getStamp(const char* filename, uint64_t& size, int64_t& modificationTime)
+{
+    std::error_code error;
+    size = std::filesystem::file_size(filename, error);
+    if(error) return false;
+    modificationTime = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+    return !error;
+}
+
+const uint64_t MappedFile::hashData(const void* data, const size_t size, const uint64_t hash)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t result = hash;
+    for(size_t ind = 0; ind < size; ++ind) result = (result ^ bytes[ind]) * 1099511628211ull;
+    return result;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
\ No newline at end of file
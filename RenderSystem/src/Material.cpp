@@ -1,10 +1,10 @@
 #include<Material.hpp>
+#include<cstring>
 
 Material::Material(){}
 
-void Material::create(ObjectManagementStrategy* allocator, const aiMaterial* mat, const std::string& pathToTextures)
+void Material::load(const aiMaterial* mat, const std::string& pathToTextures, const VkFormat textureFormat, const VkFormat normalMapFormat, const bool cacheMipmaps)
 {
-    this->allocator = allocator;
     aiColor3D amb, diff, spec;
     aiString texturePath, normalMapPath;
     if(mat->Get(AI_MATKEY_COLOR_AMBIENT, amb) != aiReturn_SUCCESS) reportError("Invalid material.\n");
@@ -22,34 +22,129 @@ void Material::create(ObjectManagementStrategy* allocator, const aiMaterial* mat
     colors.specularColor[1] = spec.g;
     colors.specularColor[2] = spec.b;
     colors.specularColor[3] = 1;
+    tempImages.texture.reset();
+    tempImages.normalMap.reset();
     if(mat->GetTexture(aiTextureType::aiTextureType_AMBIENT, 0, &texturePath) == aiReturn_SUCCESS || mat->GetTexture(aiTextureType::aiTextureType_DIFFUSE, 0, &texturePath) == aiReturn_SUCCESS || mat->GetTexture(aiTextureType::aiTextureType_SPECULAR, 0, &texturePath) == aiReturn_SUCCESS)
     {
         tempImages.texture.emplace();
-        tempImages.texture.value().load((pathToTextures + texturePath.C_Str()).c_str(), 4);
+        tempImages.textureName = texturePath.C_Str();
     }
     if(mat->GetTexture(aiTextureType::aiTextureType_NORMALS, 0, &normalMapPath) == aiReturn_SUCCESS)
     {
         tempImages.normalMap.emplace();
-        tempImages.normalMap.value().load((pathToTextures + normalMapPath.C_Str()).c_str(), 4);
+        tempImages.normalMapName = normalMapPath.C_Str();
     }
+    setTextures(pathToTextures, textureFormat, normalMapFormat, cacheMipmaps);
+}
+
+const bool Material::loadCache(const unsigned char* data, const size_t size, size_t& offset, const std::string& pathToTextures, const VkFormat textureFormat, const VkFormat normalMapFormat, const bool cacheMipmaps)
+{
+    CacheRecord record;
+    if(offset > size || size - offset < sizeof(record)) return false;
+    memcpy(&record, data + offset, sizeof(record));
+    if(size - offset - sizeof(record) < static_cast<uint64_t>(record.textureNameLength) + record.normalMapNameLength) return false;
+    const char* names = reinterpret_cast<const char*>(data + offset + sizeof(record));
+    colors = record.colors;
+    tempImages.texture.reset();
+    tempImages.normalMap.reset();
+    if(record.hasTexture) tempImages.texture.emplace();
+    if(record.hasNormalMap) tempImages.normalMap.emplace();
+    tempImages.textureName.assign(names, record.textureNameLength);
+    tempImages.normalMapName.assign(names + record.textureNameLength, record.normalMapNameLength);
+    setTextures(pathToTextures, textureFormat, normalMapFormat, cacheMipmaps);
+    offset += sizeof(record) + record.textureNameLength + record.normalMapNameLength;
+    return true;
+}
+
+void Material::saveCache(std::ostream& stream) const
+{
+    CacheRecord record;
+    record.colors = colors;
+    record.hasTexture = hasTexture();
+    record.hasNormalMap = hasNormalMap();
+    record.textureNameLength = tempImages.textureName.size();
+    record.normalMapNameLength = tempImages.normalMapName.size();
+    stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    stream.write(tempImages.textureName.data(), tempImages.textureName.size());
+    stream.write(tempImages.normalMapName.data(), tempImages.normalMapName.size());
+}
+
+const size_t Material::getMinimumCacheSize()
+{
+    return sizeof(CacheRecord);
+}
+
+void Material::setTextures(const std::string& pathToTextures, const VkFormat textureFormat, const VkFormat normalMapFormat, const bool cacheMipmaps)
+{
+    tempImages.pathToTextures = pathToTextures;
+    tempImages.textureFormat = textureFormat;
+    tempImages.normalMapFormat = normalMapFormat;
+    tempImages.cacheMipmaps = cacheMipmaps;
+    if(hasTexture())
+    {
+        if(hasNormalMap()) type = DrawableType::DTTexturedWithNormalMap;
+        else type = DrawableType::DTTextured;
+    }
+    else type = DrawableType::DTNotTextured;
+}
+
+void Material::loadImages()
+{
+    if(hasTexture()) loadImage(tempImages.texture.value(), tempImages.pathToTextures + tempImages.textureName, tempImages.textureFormat, false);
+    if(hasNormalMap()) loadImage(tempImages.normalMap.value(), tempImages.pathToTextures + tempImages.normalMapName, tempImages.normalMapFormat, true);
+}
+
+void Material::loadImage(ImageLoader::Image& image, const std::string& path, const VkFormat format, const bool normalMap)
+{
+    // mipmap chains are cached next to their source, one file per format
+
+    const std::string cachePath = path + "." + std::to_string(format) + ".mips";
+    const bool cached = tempImages.cacheMipmaps && format != VkFormat::VK_FORMAT_UNDEFINED;
+    if(cached && image.loadMipmaps(cachePath.c_str(), path.c_str(), format, normalMap))
+    {
+        ++cachedImageCount;
+        return;
+    }
+    image.load(path.c_str(), 4);
+    if(format == VkFormat::VK_FORMAT_UNDEFINED) return;
+    image.generateMipmaps(format, normalMap);
+    if(cached) image.saveMipmaps(cachePath.c_str(), path.c_str());
+}
+
+void Material::create(ObjectManagementStrategy* allocator)
+{
+    this->allocator = allocator;
     descriptorInfos.create(1 + hasTexture() + hasNormalMap());
     allocator->allocateUniformBuffer(sizeof(colors), VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT, colorsBuffer, descriptorInfos[Descriptors::Colors]);
     allocator->updateBuffer(&colors, colorsBuffer);
+    createImages();
+}
+
+void Material::reloadImages()
+{
+    // the new images may differ in size or level count, so they are allocated again instead of overwritten
+
+    if(!allocator || !hasTexture()) return;
+    allocator->freeSampledImage(texture, descriptorInfos[Descriptors::Texture]);
+    if(hasNormalMap()) allocator->freeSampledImage(normalMap, descriptorInfos[Descriptors::NormalMap]);
+    loadImages();
+    createImages();
+}
+
+void Material::createImages()
+{
     if(hasTexture())
     {
         VkExtent3D extent = {tempImages.texture->getExtent().width, tempImages.texture->getExtent().height, 1};
-        allocator->allocateSampledImage(extent, texture, descriptorInfos[Descriptors::Texture]);
+        allocator->allocateSampledImage(extent, texture, descriptorInfos[Descriptors::Texture], tempImages.texture->getFormat(), tempImages.texture->getLevelCount());
         allocator->updateImage(*(tempImages.texture), texture.image);
         if(hasNormalMap())
         {
             VkExtent3D extent = {tempImages.normalMap->getExtent().width, tempImages.normalMap->getExtent().height, 1};
-            allocator->allocateSampledImage(extent, normalMap, descriptorInfos[Descriptors::NormalMap]);
+            allocator->allocateSampledImage(extent, normalMap, descriptorInfos[Descriptors::NormalMap], tempImages.normalMap->getFormat(), tempImages.normalMap->getLevelCount());
             allocator->updateImage(*(tempImages.normalMap), normalMap.image);
-            type = DrawableType::DTTexturedWithNormalMap;
         }
-        else type = DrawableType::DTTextured;
     }
-    else type = DrawableType::DTNotTextured;
 }
 
 const DrawableType Material::getType() const
@@ -91,6 +186,13 @@ void Material::clearExtraResources()
 
 void Material::destroy()
 {
+    if(allocator)
+    {
+        allocator->freeUniformBuffer(colorsBuffer, descriptorInfos[Descriptors::Colors]);
+        if(hasTexture()) allocator->freeSampledImage(texture, descriptorInfos[Descriptors::Texture]);
+        if(hasTexture() && hasNormalMap()) allocator->freeSampledImage(normalMap, descriptorInfos[Descriptors::NormalMap]);     // normal maps are only created along with a texture
+        allocator = nullptr;
+    }
     descriptorInfos.clear();
     tempImages.normalMap.reset();
     tempImages.texture.reset();
@@ -104,4 +206,9 @@ Material::~Material()
 const Array<DescriptorInfo>& Material::getDescriptorInfos() const
 {
     return descriptorInfos;
+}
+
+const uint32_t Material::getCachedImageCount() const
+{
+    return cachedImageCount;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include<MemoryPool.hpp>
+#include<algorithm>
 #include<numeric>
 
 void MemoryPool::align(uint32_t& size, const uint32_t alignment)
@@ -21,131 +22,242 @@ const uint32_t MemoryPool::align(const uint32_t alignment1, const uint32_t align
 
 MemoryPool::MemoryPool(){}
 
-void MemoryPool::create(const System* system, const uint32_t memoryObjectCount)
+void MemoryPool::create(const System* system, const VkDeviceSize blockSize)
 {
     this->system = system;
-    memory.create(memoryObjectCount);
+    this->blockSize = blockSize;
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(system->getPhysicalDevice(), &deviceProperties);
+    vkGetPhysicalDeviceMemoryProperties(system->getPhysicalDevice(), &memoryProperties);
+    nonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
+
+    // linear and optimal resources never share a block, so bufferImageGranularity never has to be checked between neighbours
+
+    heaps.resize(memoryProperties.memoryTypeCount * 2);
 }
 
-Array<uint32_t> MemoryPool::allocate(const uint32_t memoryObjectIndex, const VkMemoryPropertyFlags property, const Array<VkMemoryRequirements>& group)
+const uint32_t MemoryPool::findMemoryType(const uint32_t memoryTypeBits, const VkMemoryPropertyFlags property) const
 {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(system->getPhysicalDevice(), &memoryProperties);
-    Array<uint32_t> offsets;
-    offsets.create(group.getSize());
-    offsets[0] = 0;
-    uint32_t alignment = group[0].alignment, memoryType = group[0].memoryTypeBits, size = group[0].size, memoryTypeIndex = (~0);
-    for(auto ind = 1; ind < group.getSize(); ++ind)
+    for(uint32_t ind = 0; ind < memoryProperties.memoryTypeCount; ++ind)
     {
-        memoryType &= group[ind].memoryTypeBits;
-        offsets[ind] = size;
-        size += group[ind].size;
-        if(alignment != group[ind].alignment)
+        if(((1U << ind) & memoryTypeBits) != 0)
         {
-            reportError("Group members have different alignments.\n");
-        }
-    }
-    if(memoryType == 0) reportError("No way to choose common memory type.\n");
-    for(uint32_t ind = 0; ind < 32; ++ind)
-    {
-        if(((1U << ind) & memoryType) != 0)
-        {
-            if((memoryProperties.memoryTypes[ind].propertyFlags & property) != 0)
+            if((memoryProperties.memoryTypes[ind].propertyFlags & property) == property)
             {
-                memoryTypeIndex = ind;
-                break;
+                return ind;
             }
         }
     }
-    if(memoryTypeIndex == (~0)) reportError("No way to allocate memory with these memory properties.\n");
-    VkMemoryAllocateInfo memoryInfo;
-    memoryInfo = 
+    reportError("No way to allocate memory with these memory properties.\n");
+    return ~0U;
+}
+
+const uint32_t MemoryPool::addBlock(const uint32_t heapIndex, const VkDeviceSize size)
+{
+    auto& heap = heaps[heapIndex];
+    uint32_t blockIndex = 0;
+    while(blockIndex < heap.size() && heap[blockIndex].memory) ++blockIndex;
+    if(blockIndex == heap.size()) heap.emplace_back();
+    Block& block = heap[blockIndex];
+
+    // block sizes are kept multiple of nonCoherentAtomSize, so rounded flush ranges never leave the block
+
+    block.size = size % nonCoherentAtomSize != 0 ? (size / nonCoherentAtomSize + 1) * nonCoherentAtomSize : size;
+    block.usedSize = 0;
+    block.allocationCount = 0;
+    block.dedicated = size > blockSize;
+    block.mapped = nullptr;
+    block.freeRanges.clear();
+    block.freeRanges[0] = block.size;
+    VkMemoryAllocateInfo memoryInfo = 
     {
         VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         nullptr,
-        size,
-        memoryTypeIndex
+        block.size,
+        heapIndex / 2
     };
-    checkResult(vkAllocateMemory(system->getDevice(), &memoryInfo, nullptr, &memory[memoryObjectIndex]), "Failed to allocate memory.\n");
-    return offsets;
+    checkResult(vkAllocateMemory(system->getDevice(), &memoryInfo, nullptr, &block.memory), "Failed to allocate memory.\n");
+    return blockIndex;
 }
 
-void MemoryPool::allocate(const uint32_t memoryObjectIndex, const VkMemoryPropertyFlags property, const VkMemoryRequirements& mem)
+const bool MemoryPool::allocateFromBlock(Block& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset)
 {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(system->getPhysicalDevice(), &memoryProperties);
-    uint32_t memoryTypeIndex = (~0);
-    for(uint32_t ind = 0; ind < 32; ++ind)
+    // best fit: the smallest free range that can hold the aligned allocation
+
+    auto best = block.freeRanges.end();
+    for(auto range = block.freeRanges.begin(); range != block.freeRanges.end(); ++range)
     {
-        if(((1U << ind) & mem.memoryTypeBits) != 0)
-        {
-            if((memoryProperties.memoryTypes[ind].propertyFlags & property) != 0)
-            {
-                memoryTypeIndex = ind;
-                break;
-            }
-        }
+        const VkDeviceSize alignedOffset = range->first % requirements.alignment != 0 ? (range->first / requirements.alignment + 1) * requirements.alignment : range->first;
+        if(alignedOffset + requirements.size > range->first + range->second) continue;
+        if(best == block.freeRanges.end() || range->second < best->second) best = range;
     }
-    if(memoryTypeIndex == (~0)) reportError("No way to allocate memory with this memory properties.\n");
-    VkMemoryAllocateInfo memoryInfo;
-    memoryInfo = 
+    if(best == block.freeRanges.end()) return false;
+
+    const VkDeviceSize rangeOffset = best->first, rangeEnd = best->first + best->second;
+    offset = rangeOffset % requirements.alignment != 0 ? (rangeOffset / requirements.alignment + 1) * requirements.alignment : rangeOffset;
+    block.freeRanges.erase(best);
+    if(offset > rangeOffset) block.freeRanges[rangeOffset] = offset - rangeOffset;
+    if(offset + requirements.size < rangeEnd) block.freeRanges[offset + requirements.size] = rangeEnd - offset - requirements.size;
+    block.usedSize += requirements.size;
+    ++block.allocationCount;
+    return true;
+}
+
+const MemoryAllocation MemoryPool::allocate(const VkMemoryPropertyFlags property, const VkMemoryRequirements& requirements, const bool linear)
+{
+    const uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, property);
+    const uint32_t heapIndex = memoryType * 2 + (linear ? 1 : 0);
+    auto& heap = heaps[heapIndex];
+    MemoryAllocation allocation = 
     {
-        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        nullptr,
-        mem.size,
-        memoryTypeIndex
+        heapIndex,
+        0,
+        0,
+        requirements.size
     };
-    checkResult(vkAllocateMemory(system->getDevice(), &memoryInfo, nullptr, &memory[memoryObjectIndex]), "Failed to allocate memory.\n");
+    for(auto ind = 0; ind < heap.size(); ++ind)
+    {
+        if(heap[ind].memory && allocateFromBlock(heap[ind], requirements, allocation.offset))
+        {
+            allocation.blockIndex = ind;
+            return allocation;
+        }
+    }
+
+    // resources larger than a block get a dedicated one
+
+    allocation.blockIndex = addBlock(heapIndex, std::max(blockSize, requirements.size));
+    if(!allocateFromBlock(heap[allocation.blockIndex], requirements, allocation.offset)) reportError("Failed to sub-allocate memory.\n");
+    return allocation;
 }
 
-void* MemoryPool::map(const uint32_t memoryObjectIndex, const VkDeviceSize offset, const VkDeviceSize size)
+void MemoryPool::free(const MemoryAllocation& allocation)
 {
-    void* data;
-    checkResult(vkMapMemory(system->getDevice(), memory[memoryObjectIndex], offset, size, 0, &data), "Failed to map memory.\n");
-    return data;
+    Block& block = heaps[allocation.heapIndex][allocation.blockIndex];
+    if(!block.memory) return;
+    VkDeviceSize offset = allocation.offset, size = allocation.size;
+    auto next = block.freeRanges.lower_bound(offset);
+
+    // a range overlapping a free one was already freed
+
+    if(next != block.freeRanges.end() && next->first < offset + size) return;
+    if(next != block.freeRanges.begin() && std::prev(next)->first + std::prev(next)->second > offset) return;
+
+    // merging with the neighbouring free ranges
+
+    if(next != block.freeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = block.freeRanges.erase(next);
+    }
+    if(next != block.freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if(prev->first + prev->second == offset)
+        {
+            offset = prev->first;
+            size += prev->second;
+            block.freeRanges.erase(prev);
+        }
+    }
+    block.freeRanges[offset] = size;
+    block.usedSize -= allocation.size;
+    --block.allocationCount;
+
+    // empty blocks are returned to the driver, except for the first regular one of each heap;
+    // dedicated blocks are released wherever they are, no other resource would fit them
+
+    if(block.allocationCount == 0 && (block.dedicated || allocation.blockIndex != 0)) freeBlock(block);
 }
 
-void MemoryPool::flush(const uint32_t memoryObjectIndex, const VkDeviceSize offset, const VkDeviceSize size)
+void MemoryPool::freeBlock(Block& block)
 {
-    VkMappedMemoryRange range = 
+    if(block.mapped != nullptr)
     {
-        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        nullptr,
-        memory[memoryObjectIndex],
-        offset,
-        size
-    };
-    checkResult(vkFlushMappedMemoryRanges(system->getDevice(), 1, &range), "Failed to flush memory.\n");
+        vkUnmapMemory(system->getDevice(), block.memory);
+        block.mapped = nullptr;
+    }
+    vkFreeMemory(system->getDevice(), block.memory, nullptr);
+    block.memory = 0;
+    block.freeRanges.clear();
+    block.usedSize = 0;
+    block.allocationCount = 0;
 }
 
-void MemoryPool::unmap(const uint32_t memoryObjectIndex)
+const VkDeviceMemory& MemoryPool::getMemory(const MemoryAllocation& allocation) const
 {
-    vkUnmapMemory(system->getDevice(), memory[memoryObjectIndex]);
+    return heaps[allocation.heapIndex][allocation.blockIndex].memory;
 }
 
-const VkDeviceMemory& MemoryPool::operator[](const uint32_t index) const
+void* MemoryPool::map(const MemoryAllocation& allocation)
 {
-    return memory[index];
+    Block& block = heaps[allocation.heapIndex][allocation.blockIndex];
+    if(block.mapped == nullptr)
+    {
+        checkResult(vkMapMemory(system->getDevice(), block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped), "Failed to map memory.\n");
+    }
+    return (char*)block.mapped + allocation.offset;
 }
 
-VkDeviceMemory& MemoryPool::operator[](const uint32_t index)
+void MemoryPool::flush(const MemoryAllocation& allocation, const VkDeviceSize offset, const VkDeviceSize size)
 {
-    return memory[index];
+    const Block& block = heaps[allocation.heapIndex][allocation.blockIndex];
+    const VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+    VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : allocation.offset + offset + size;
+    end = end % nonCoherentAtomSize != 0 ? (end / nonCoherentAtomSize + 1) * nonCoherentAtomSize : end;
+    VkMappedMemoryRange range = 
+    {
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        nullptr,
+        block.memory,
+        begin,
+        std::min(end, block.size) - begin
+    };
+    checkResult(vkFlushMappedMemoryRanges(system->getDevice(), 1, &range), "Failed to flush memory.\n");
+}
+
+const std::vector<MemoryPool::Statistics> MemoryPool::getStatistics() const
+{
+    std::vector<Statistics> heapStatistics;
+    for(uint32_t heapIndex = 0; heapIndex < heaps.size(); ++heapIndex)
+    {
+        Statistics statistics = {};
+        statistics.memoryType = heapIndex / 2;
+        statistics.linear = heapIndex % 2 != 0;
+        VkDeviceSize freeBytes = 0;
+        for(const auto& block : heaps[heapIndex])
+        {
+            if(!block.memory) continue;
+            ++statistics.blockCount;
+            statistics.allocationCount += block.allocationCount;
+            statistics.allocatedBytes += block.size;
+            statistics.usedBytes += block.usedSize;
+            for(const auto& range : block.freeRanges)
+            {
+                freeBytes += range.second;
+                statistics.largestFreeRange = std::max(statistics.largestFreeRange, range.second);
+            }
+        }
+        if(statistics.blockCount == 0) continue;
+        statistics.fragmentation = freeBytes == 0 ? 0.0f : 1.0f - (float)statistics.largestFreeRange / freeBytes;
+        heapStatistics.push_back(statistics);
+    }
+    return heapStatistics;
 }
 
 void MemoryPool::destroy()
 {
-    for(auto ind = 0; ind < memory.getSize(); ++ind)
+    for(auto& heap : heaps)
     {
-        if(memory[ind])
+        for(auto& block : heap)
         {
-            vkFreeMemory(system->getDevice(), memory[ind], nullptr);
-            memory[ind] = 0;
+            if(block.memory) freeBlock(block);
         }
     }
+    heaps.clear();
 }
 
 MemoryPool::~MemoryPool()
 {
     destroy();
-}
\ No newline at end of file
+}
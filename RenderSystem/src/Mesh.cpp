@@ -1,20 +1,249 @@
 #include<Mesh.hpp>
+#include<algorithm>
+#include<cstring>
 
 Mesh::Mesh()
 {
 }
 
-void Mesh::create(ObjectManagementStrategy* allocator, const aiMesh* mesh, const Material* mat)
+void Mesh::load(const aiMesh* mesh, const Material* mat, const MeshLoadOptions& options)
 {
-    this->allocator = allocator;
     material = mat;
+    cached.vertices = nullptr;
     generateTempIndexBuffer(mesh);
-    generateTempVertexBuffer(mesh);
+    generateTempVertexBuffer(mesh, options.packedVertices);
     vertexCount = tempVertexBuffer->getVertexCount();
-    allocator->allocateVertexBuffer(getTempVertexBufferSize(), vertexBuffer);
-    allocator->allocateIndexBuffer(getTempIndexBufferSize(), indexBuffer);
-    allocator->updateBuffer(tempVertexBuffer->getBufferPtr(), vertexBuffer);
-    allocator->updateBuffer(tempIndexBuffer.getPtr(), indexBuffer);
+    positionDecode = tempVertexBuffer->getPositionDecode();
+    computeBounds(mesh);
+    originalCacheStatistics = MeshOptimizer::analyzeVertexCache(tempIndexBuffer.getPtr(), tempIndexBuffer.getSize(), vertexCount);
+    cacheStatistics = originalCacheStatistics;
+    levelCount = 1;
+    levels[0] = {0, tempIndexBuffer.getSize(), 0.0f};
+    if(options.generateLevelsOfDetail) generateLevelsOfDetail(mesh);
+    std::vector<uint32_t> vertexOrder;      // new index -> aiMesh vertex, empty while vertices keep their order
+    if(options.optimizeVertexCache) optimize(mesh, vertexOrder);
+    if(options.buildMeshlets) buildMeshlets(mesh, vertexOrder);
+    generateShortIndexBuffer();
+}
+
+const bool Mesh::loadCache(const unsigned char* data, const size_t size, size_t& offset, const Material* mat)
+{
+    // every count is checked against the data before anything points into it, so a damaged record is only a miss;
+    // the vertices are not touched here, their pages are read in when the allocator uploads them
+
+    CacheRecord record;
+    if(offset > size || size - offset < sizeof(record)) return false;
+    memcpy(&record, data + offset, sizeof(record));
+    const size_t meshletSize = static_cast<size_t>(record.meshletCount) * sizeof(MeshOptimizer::Meshlet);
+    const size_t recordSize = sizeof(record) + static_cast<size_t>(record.vertexBufferSize) + record.indexBufferSize + meshletSize;
+    const size_t paddedRecordSize = (recordSize + alignof(CacheRecord) - 1) / alignof(CacheRecord) * alignof(CacheRecord);
+    if(size - offset < paddedRecordSize) return false;
+    if(record.type != mat->getType() || !record.levelCount || record.levelCount > MAX_LEVEL_COUNT) return false;
+    if(static_cast<uint64_t>(record.vertexCount) * record.vertexStride != record.vertexBufferSize) return false;
+    if(record.indexType != VkIndexType::VK_INDEX_TYPE_UINT16 && record.indexType != VkIndexType::VK_INDEX_TYPE_UINT32) return false;
+    const uint32_t indexSize = record.indexType == VkIndexType::VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    if(record.indexBufferSize % indexSize) return false;
+    for(uint32_t level = 0; level < record.levelCount; ++level)
+    {
+        if(static_cast<uint64_t>(record.levels[level].firstIndex) + record.levels[level].indexCount > record.indexBufferSize / indexSize) return false;
+    }
+
+    const unsigned char* recordData = data + offset + sizeof(record);
+
+    // an index past the vertices would have the device read outside the mesh, so every one is checked;
+    // they are read one by one, the vertex buffer before them leaves them unaligned
+
+    const unsigned char* indices = recordData + record.vertexBufferSize;
+    const uint32_t indexCount = record.indexBufferSize / indexSize;
+    for(uint32_t ind = 0; ind < indexCount; ++ind)
+    {
+        uint32_t index;
+        if(indexSize == sizeof(uint16_t))
+        {
+            uint16_t shortIndex;
+            memcpy(&shortIndex, indices + ind * sizeof(uint16_t), sizeof(shortIndex));
+            index = shortIndex;
+        }
+        else memcpy(&index, indices + ind * sizeof(uint32_t), sizeof(index));
+        if(index >= record.vertexCount) return false;
+    }
+    std::vector<MeshOptimizer::Meshlet> cachedMeshlets(record.meshletCount);
+    memcpy(cachedMeshlets.data(), recordData + record.vertexBufferSize + record.indexBufferSize, meshletSize);
+    for(const auto& meshlet : cachedMeshlets)
+    {
+        if(static_cast<uint64_t>(meshlet.firstIndex) + meshlet.indexCount > record.levels[0].indexCount) return false;
+    }
+    material = mat;
+    vertexCount = record.vertexCount;
+    indexType = static_cast<VkIndexType>(record.indexType);
+    levelCount = record.levelCount;
+    std::copy(record.levels, record.levels + MAX_LEVEL_COUNT, levels);
+    positionDecode = record.positionDecode;
+    bounds = record.bounds;
+    originalCacheStatistics = record.originalCacheStatistics;
+    cacheStatistics = record.cacheStatistics;
+    meshlets = std::move(cachedMeshlets);
+    buildMeshletArrays();
+    cached.vertices = recordData;
+    cached.indices = recordData + record.vertexBufferSize;
+    cached.vertexBufferSize = record.vertexBufferSize;
+    cached.indexBufferSize = record.indexBufferSize;
+    cached.vertexStride = record.vertexStride;
+    offset += paddedRecordSize;
+    return true;
+}
+
+void Mesh::saveCache(std::ostream& stream) const
+{
+    // meshlets are written as they are, their per axis boxes are rebuilt from them on loading
+
+    static const char PADDING[alignof(CacheRecord)] = {};
+    CacheRecord record = {};
+    record.type = material->getType();
+    record.vertexCount = vertexCount;
+    record.vertexStride = tempVertexBuffer->getVertexStride();
+    record.vertexBufferSize = getTempVertexBufferSize();
+    record.indexType = indexType;
+    record.indexBufferSize = getTempIndexBufferSize();
+    record.levelCount = levelCount;
+    record.meshletCount = meshlets.size();
+    std::copy(levels, levels + MAX_LEVEL_COUNT, record.levels);
+    record.positionDecode = positionDecode;
+    record.bounds = bounds;
+    record.originalCacheStatistics = originalCacheStatistics;
+    record.cacheStatistics = cacheStatistics;
+    const size_t meshletSize = meshlets.size() * sizeof(MeshOptimizer::Meshlet);
+    stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    stream.write(reinterpret_cast<const char*>(tempVertexBuffer->getBufferPtr()), record.vertexBufferSize);
+    stream.write(reinterpret_cast<const char*>(getTempIndexBufferPtr()), record.indexBufferSize);
+    stream.write(reinterpret_cast<const char*>(meshlets.data()), meshletSize);
+    const size_t recordSize = sizeof(record) + static_cast<size_t>(record.vertexBufferSize) + record.indexBufferSize + meshletSize;
+    stream.write(PADDING, (alignof(CacheRecord) - recordSize % alignof(CacheRecord)) % alignof(CacheRecord));
+}
+
+const size_t Mesh::getMinimumCacheSize()
+{
+    return sizeof(CacheRecord);
+}
+
+void Mesh::optimize(const aiMesh* mesh, std::vector<uint32_t>& vertexOrder)
+{
+    // triangles are ordered for the post-transform cache first, the overdraw pass only moves whole cache-friendly clusters;
+    // vertices are renumbered last so they are fetched in the order the triangles use them, the full level deciding the order
+
+    std::vector<uint32_t> clusterStarts;
+    for(auto level = 0; level < levelCount; ++level)
+    {
+        uint32_t* indices = tempIndexBuffer.getPtr() + levels[level].firstIndex;
+        MeshOptimizer::optimizeVertexCache(indices, levels[level].indexCount, vertexCount, clusterStarts);
+        MeshOptimizer::optimizeOverdraw(indices, levels[level].indexCount, mesh->mVertices, vertexCount, clusterStarts);
+    }
+    MeshOptimizer::optimizeVertexFetch(tempIndexBuffer.getPtr(), tempIndexBuffer.getSize(), vertexCount, vertexOrder);
+    tempVertexBuffer->reorderVertices(vertexOrder);
+    cacheStatistics = MeshOptimizer::analyzeVertexCache(tempIndexBuffer.getPtr(), levels[0].indexCount, vertexCount);
+}
+
+void Mesh::generateLevelsOfDetail(const aiMesh* mesh)
+{
+    // every level simplifies the previous one, so errors only grow; a level that barely removes triangles ends the chain
+
+    static const float LEVEL_RATIOS[MAX_LEVEL_COUNT] = {1.0f, 0.5f, 0.25f, 0.125f};
+    static const float MIN_REDUCTION = 0.9f;
+    std::vector<uint32_t> allIndices(tempIndexBuffer.getPtr(), tempIndexBuffer.getPtr() + tempIndexBuffer.getSize()), levelIndices;
+    for(auto level = 1; level < MAX_LEVEL_COUNT; ++level)
+    {
+        const LevelOfDetail& previous = levels[level - 1];
+        const uint32_t targetIndexCount = static_cast<uint32_t>(levels[0].indexCount * LEVEL_RATIOS[level]) / 3 * 3;
+        const float error = MeshOptimizer::simplify(allIndices.data() + previous.firstIndex, previous.indexCount, mesh->mVertices, vertexCount, targetIndexCount, levelIndices);
+        if(levelIndices.empty() || levelIndices.size() > previous.indexCount * MIN_REDUCTION) break;
+        levels[level] = {static_cast<uint32_t>(allIndices.size()), static_cast<uint32_t>(levelIndices.size()), std::max(error, previous.error)};
+        allIndices.insert(allIndices.end(), levelIndices.begin(), levelIndices.end());
+        ++levelCount;
+    }
+    tempIndexBuffer.create(allIndices.size(), allIndices.data());
+}
+
+void Mesh::buildMeshlets(const aiMesh* mesh, const std::vector<uint32_t>& vertexOrder)
+{
+    std::vector<aiVector3D> positions(vertexCount);
+    for(auto vertex = 0; vertex < vertexCount; ++vertex) positions[vertex] = mesh->mVertices[vertexOrder.empty() ? vertex : vertexOrder[vertex]];
+    MeshOptimizer::buildMeshlets(tempIndexBuffer.getPtr(), levels[0].indexCount, positions.data(), vertexCount, meshlets);
+    buildMeshletArrays();
+}
+
+void Mesh::buildMeshletArrays()
+{
+    // meshlet boxes are also kept per axis for the SIMD frustum test
+
+    for(auto axis = 0; axis < 3; ++axis)
+    {
+        meshletCenters[axis].resize(meshlets.size());
+        meshletExtents[axis].resize(meshlets.size());
+        for(auto ind = 0; ind < meshlets.size(); ++ind)
+        {
+            meshletCenters[axis][ind] = meshlets[ind].center[axis];
+            meshletExtents[axis][ind] = meshlets[ind].extents[axis];
+        }
+        meshletCenterArrays[axis] = meshletCenters[axis].data();
+        meshletExtentArrays[axis] = meshletExtents[axis].data();
+    }
+}
+
+const std::vector<MeshOptimizer::Meshlet>& Mesh::getMeshlets() const
+{
+    return meshlets;
+}
+
+const float* const* Mesh::getMeshletCenters() const
+{
+    return meshletCenterArrays;
+}
+
+const float* const* Mesh::getMeshletExtents() const
+{
+    return meshletExtentArrays;
+}
+
+void Mesh::computeBounds(const aiMesh* mesh)
+{
+    // the sphere is centered on the box, which is close enough to the optimal one for culling and level selection
+
+    if(!mesh->mNumVertices) return;
+    glm::vec3 min(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z), max = min;
+    for(auto ind = 1; ind < mesh->mNumVertices; ++ind)
+    {
+        const glm::vec3 pos(mesh->mVertices[ind].x, mesh->mVertices[ind].y, mesh->mVertices[ind].z);
+        min = glm::min(min, pos);
+        max = glm::max(max, pos);
+    }
+    bounds.center = (min + max) * 0.5f;
+    bounds.extents = (max - min) * 0.5f;
+    bounds.radius = 0.0f;
+    for(auto ind = 0; ind < mesh->mNumVertices; ++ind)
+    {
+        const glm::vec3 pos(mesh->mVertices[ind].x, mesh->mVertices[ind].y, mesh->mVertices[ind].z);
+        bounds.radius = std::max(bounds.radius, glm::length(pos - bounds.center));
+    }
+}
+
+const BoundingVolume& Mesh::getBounds() const
+{
+    return bounds;
+}
+
+void Mesh::create(ObjectManagementStrategy* allocator)
+{
+    // cached meshes are uploaded straight from the cache data, they have no temporary buffers
+
+    this->allocator = allocator;
+    const uint32_t stride = cached.vertices ? cached.vertexStride : tempVertexBuffer->getVertexStride();
+    const uint32_t vertexBufferSize = cached.vertices ? cached.vertexBufferSize : getTempVertexBufferSize();
+    const uint32_t indexBufferSize = cached.vertices ? cached.indexBufferSize : getTempIndexBufferSize();
+    allocator->allocateMeshBuffers(material->getType(), stride, vertexBufferSize, indexBufferSize, vertexBuffer, indexBuffer);
+    baseVertex = stride ? vertexBuffer.offset / stride : 0;
+    firstIndex = indexBuffer.offset / (indexType == VkIndexType::VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+    allocator->updateBuffer(cached.vertices ? cached.vertices : tempVertexBuffer->getBufferPtr(), vertexBuffer);
+    allocator->updateBuffer(cached.vertices ? cached.indices : getTempIndexBufferPtr(), indexBuffer);
 }
 
 const BufferInfo& Mesh::getVertexBuffer() const
@@ -27,9 +256,34 @@ const BufferInfo& Mesh::getIndexBuffer() const
     return indexBuffer;
 }
 
-const uint32_t Mesh::getIndexCount() const
+const uint32_t Mesh::getBaseVertex() const
+{
+    return baseVertex;
+}
+
+const uint32_t Mesh::getFirstIndex(const uint32_t level) const
+{
+    return firstIndex + levels[level].firstIndex;
+}
+
+const uint32_t Mesh::getIndexCount(const uint32_t level) const
 {
-    return indexBuffer.size / sizeof(uint32_t);
+    return levels[level].indexCount;
+}
+
+const uint32_t Mesh::getLevelCount() const
+{
+    return levelCount;
+}
+
+const float Mesh::getLevelError(const uint32_t level) const
+{
+    return levels[level].error;
+}
+
+const VkIndexType Mesh::getIndexType() const
+{
+    return indexType;
 }
 
 const uint32_t Mesh::getVertexCount() const
@@ -37,11 +291,49 @@ const uint32_t Mesh::getVertexCount() const
     return vertexCount;
 }
 
+const PositionDecode& Mesh::getPositionDecode() const
+{
+    return positionDecode;
+}
+
+const MeshOptimizer::Statistics& Mesh::getOriginalCacheStatistics() const
+{
+    return originalCacheStatistics;
+}
+
+const MeshOptimizer::Statistics& Mesh::getCacheStatistics() const
+{
+    return cacheStatistics;
+}
+
 const uint32_t Mesh::getTempIndexBufferSize() const
 {
+    if(indexType == VkIndexType::VK_INDEX_TYPE_UINT16) return sizeof(uint16_t) * tempShortIndexBuffer.getSize();
     return sizeof(uint32_t) * tempIndexBuffer.getSize();
 }
 
+const void* Mesh::getTempIndexBufferPtr() const
+{
+    if(indexType == VkIndexType::VK_INDEX_TYPE_UINT16) return tempShortIndexBuffer.getPtr();
+    return tempIndexBuffer.getPtr();
+}
+
+void Mesh::generateShortIndexBuffer()
+{
+    // primitive restart is never enabled, so all 65536 values are usable indices
+
+    static const uint32_t MAX_SHORT_INDEXED_VERTEX_COUNT = 65536;
+    if(vertexCount > MAX_SHORT_INDEXED_VERTEX_COUNT)
+    {
+        indexType = VkIndexType::VK_INDEX_TYPE_UINT32;
+        return;
+    }
+    indexType = VkIndexType::VK_INDEX_TYPE_UINT16;
+    tempShortIndexBuffer.create(tempIndexBuffer.getSize());
+    for(auto ind = 0; ind < tempIndexBuffer.getSize(); ++ind) tempShortIndexBuffer[ind] = static_cast<uint16_t>(tempIndexBuffer[ind]);
+    tempIndexBuffer.clear();
+}
+
 const uint32_t Mesh::getTempVertexBufferSize() const
 {
     return tempVertexBuffer->getBufferSize();
@@ -68,18 +360,21 @@ void Mesh::generateTempIndexBuffer(const aiMesh* mesh)
     }
 }
 
-void Mesh::generateTempVertexBuffer(const aiMesh* mesh)
+void Mesh::generateTempVertexBuffer(const aiMesh* mesh, const bool packedVertices)
 {
     switch(material->getType())
     {
         case DrawableType::DTNotTextured:
-            tempVertexBuffer = new VertexBufferNotTextured();
+            if(packedVertices) tempVertexBuffer = new VertexBufferNotTexturedPacked();
+            else tempVertexBuffer = new VertexBufferNotTextured();
             break;
         case DrawableType::DTTextured:
-            tempVertexBuffer = new VertexBufferStandard();
+            if(packedVertices) tempVertexBuffer = new VertexBufferStandardPacked();
+            else tempVertexBuffer = new VertexBufferStandard();
             break;
         case DrawableType::DTTexturedWithNormalMap:
-            tempVertexBuffer = new VertexBufferWithNormalMap();
+            if(packedVertices) tempVertexBuffer = new VertexBufferWithNormalMapPacked();
+            else tempVertexBuffer = new VertexBufferWithNormalMap();
             break;
     }
     if(!tempVertexBuffer->checkCompatibility(mesh)) reportError("Invalid mesh.\n");
@@ -89,16 +384,32 @@ void Mesh::generateTempVertexBuffer(const aiMesh* mesh)
 void Mesh::clearExtraResources()
 {
     tempIndexBuffer.clear();
-    tempVertexBuffer->clear();
+    tempShortIndexBuffer.clear();
+    if(tempVertexBuffer) tempVertexBuffer->clear();
+    cached.vertices = nullptr;
+    cached.indices = nullptr;
 }
 
 void Mesh::destroy()
 {
+    if(allocator)
+    {
+        allocator->freeBuffer(vertexBuffer);
+        allocator->freeBuffer(indexBuffer);
+        allocator = nullptr;
+    }
     vertexBuffer = BufferInfo();
     indexBuffer = BufferInfo();
-    tempVertexBuffer->clear();
-    delete tempVertexBuffer;
+    if(tempVertexBuffer)
+    {
+        tempVertexBuffer->clear();
+        delete tempVertexBuffer;
+        tempVertexBuffer = nullptr;
+    }
+    cached.vertices = nullptr;
+    cached.indices = nullptr;
     tempIndexBuffer.clear();
+    tempShortIndexBuffer.clear();
     material = nullptr;
 }
 
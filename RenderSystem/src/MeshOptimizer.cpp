@@ -0,0 +1,522 @@
+#include<MeshOptimizer.hpp>
+#include<algorithm>
+#include<cmath>
+
+const float MeshOptimizer::OVERDRAW_THRESHOLD = 1.05f;
+
+const MeshOptimizer::Statistics MeshOptimizer::analyzeVertexCache(const uint32_t* indices, const uint32_t indexCount, const uint32_t vertexCount)
+{
+    // a vertex is in the cache while fewer than CACHE_SIZE vertices were transformed after it
+
+    Statistics statistics = {indexCount / 3, 0, 0};
+    std::vector<uint32_t> cacheTimes(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t time = CACHE_SIZE + 1;
+    for(auto ind = 0; ind < indexCount; ++ind)
+    {
+        const uint32_t vertex = indices[ind];
+        if(!referenced[vertex])
+        {
+            referenced[vertex] = true;
+            ++statistics.vertexCount;
+        }
+        if(time - cacheTimes[vertex] > CACHE_SIZE)
+        {
+            cacheTimes[vertex] = time++;
+            ++statistics.transformedVertexCount;
+        }
+    }
+    return statistics;
+}
+
+const float MeshOptimizer::getACMR(const Statistics& statistics)
+{
+    return statistics.triangleCount ? static_cast<float>(statistics.transformedVertexCount) / statistics.triangleCount : 0.0f;
+}
+
+const float MeshOptimizer::getATVR(const Statistics& statistics)
+{
+    return statistics.vertexCount ? static_cast<float>(statistics.transformedVertexCount) / statistics.vertexCount : 0.0f;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, const uint32_t indexCount, const uint32_t vertexCount, std::vector<uint32_t>& hardClusterStarts)
+{
+    // Tipsify: triangles are emitted in fans around a vertex, the next fan is centered on a vertex
+    // that is still going to be in the cache when all its remaining triangles are emitted
+
+    const uint32_t triangleCount = indexCount / 3;
+    std::vector<uint32_t> liveTriangleCounts(vertexCount, 0);
+    for(auto ind = 0; ind < indexCount; ++ind) ++liveTriangleCounts[indices[ind]];
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for(auto vertex = 0; vertex < vertexCount; ++vertex) adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangleCounts[vertex];
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(auto triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        for(auto corner = 0; corner < 3; ++corner) adjacency[adjacencyFill[indices[triangle * 3 + corner]]++] = triangle;
+    }
+
+    std::vector<uint32_t> cacheTimes(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds, candidates, result;
+    result.reserve(indexCount);
+    uint32_t time = CACHE_SIZE + 1, cursor = 0;
+    uint32_t fanningVertex = indexCount ? indices[0] : ~0U;
+    hardClusterStarts.clear();
+    if(indexCount) hardClusterStarts.push_back(0);
+    while(fanningVertex != ~0U)
+    {
+        candidates.clear();
+        for(auto adjacent = adjacencyOffsets[fanningVertex]; adjacent < adjacencyOffsets[fanningVertex + 1]; ++adjacent)
+        {
+            const uint32_t triangle = adjacency[adjacent];
+            if(emitted[triangle]) continue;
+            for(auto corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                result.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                --liveTriangleCounts[vertex];
+                if(time - cacheTimes[vertex] > CACHE_SIZE) cacheTimes[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+        bool jumped = false;
+        fanningVertex = getNextVertex(candidates, liveTriangleCounts, cacheTimes, time, deadEnds, cursor, jumped);
+        if(jumped && fanningVertex != ~0U) hardClusterStarts.push_back(result.size() / 3);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+const uint32_t MeshOptimizer::getNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& liveTriangleCounts, const std::vector<uint32_t>& cacheTimes, const uint32_t time, std::vector<uint32_t>& deadEnds, uint32_t& cursor, bool& jumped)
+{
+    uint32_t bestVertex = ~0U;
+    int64_t bestPriority = -1;
+    for(const auto vertex : candidates)
+    {
+        if(!liveTriangleCounts[vertex]) continue;
+        int64_t priority = 0;
+        if(time - cacheTimes[vertex] + 2 * liveTriangleCounts[vertex] <= CACHE_SIZE) priority = time - cacheTimes[vertex];
+        if(priority > bestPriority)
+        {
+            bestPriority = priority;
+            bestVertex = vertex;
+        }
+    }
+    if(bestVertex != ~0U) return bestVertex;
+
+    // dead end: go back to the most recently emitted vertex that still has triangles, then to any such vertex
+
+    while(!deadEnds.empty())
+    {
+        const uint32_t vertex = deadEnds.back();
+        deadEnds.pop_back();
+        if(liveTriangleCounts[vertex]) return vertex;
+    }
+    jumped = true;
+    for(; cursor < liveTriangleCounts.size(); ++cursor)
+    {
+        if(liveTriangleCounts[cursor]) return cursor;
+    }
+    return ~0U;
+}
+
+void MeshOptimizer::splitSoftClusters(const uint32_t* indices, const uint32_t triangleCount, const uint32_t vertexCount, const std::vector<uint32_t>& hardClusterStarts, std::vector<uint32_t>& clusterStarts)
+{
+    // a cluster ends as soon as its miss ratio is about as good as the whole hard cluster's, so cutting there costs little cache efficiency;
+    // advancing the time by more than the cache size empties the simulated cache
+
+    std::vector<uint32_t> cacheTimes(vertexCount, 0);
+    uint32_t time = CACHE_SIZE + 1;
+    clusterStarts.clear();
+    for(auto hardCluster = 0; hardCluster < hardClusterStarts.size(); ++hardCluster)
+    {
+        const uint32_t start = hardClusterStarts[hardCluster];
+        const uint32_t end = hardCluster + 1 < hardClusterStarts.size() ? hardClusterStarts[hardCluster + 1] : triangleCount;
+        uint32_t misses = 0;
+        time += CACHE_SIZE + 1;
+        for(auto triangle = start; triangle < end; ++triangle)
+        {
+            for(auto corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                if(time - cacheTimes[vertex] > CACHE_SIZE)
+                {
+                    cacheTimes[vertex] = time++;
+                    ++misses;
+                }
+            }
+        }
+        const float threshold = OVERDRAW_THRESHOLD * misses / (end - start);
+
+        clusterStarts.push_back(start);
+        uint32_t clusterStart = start;
+        misses = 0;
+        time += CACHE_SIZE + 1;
+        for(auto triangle = start; triangle < end; ++triangle)
+        {
+            for(auto corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = indices[triangle * 3 + corner];
+                if(time - cacheTimes[vertex] > CACHE_SIZE)
+                {
+                    cacheTimes[vertex] = time++;
+                    ++misses;
+                }
+            }
+            if(triangle + 1 < end && static_cast<float>(misses) / (triangle - clusterStart + 1) <= threshold)
+            {
+                clusterStart = triangle + 1;
+                clusterStarts.push_back(clusterStart);
+                misses = 0;
+                time += CACHE_SIZE + 1;
+            }
+        }
+    }
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, const uint32_t indexCount, const aiVector3D* positions, const uint32_t vertexCount, const std::vector<uint32_t>& hardClusterStarts)
+{
+    // clusters whose surface faces away from the mesh center are likely to occlude the rest, so they are drawn first
+
+    struct Cluster
+    {
+        uint32_t start;
+        uint32_t end;
+        float sortKey;
+    };
+
+    const uint32_t triangleCount = indexCount / 3;
+    std::vector<uint32_t> clusterStarts;
+    splitSoftClusters(indices, triangleCount, vertexCount, hardClusterStarts, clusterStarts);
+
+    aiVector3D meshCentroid;
+    float meshArea = 0.0f;
+    for(auto triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        const aiVector3D& a = positions[indices[triangle * 3]], & b = positions[indices[triangle * 3 + 1]], & c = positions[indices[triangle * 3 + 2]];
+        const aiVector3D ab(b.x - a.x, b.y - a.y, b.z - a.z), ac(c.x - a.x, c.y - a.y, c.z - a.z), normal = ab ^ ac;
+        const float area = std::sqrt(normal * normal);
+        meshCentroid.x += (a.x + b.x + c.x) * area;
+        meshCentroid.y += (a.y + b.y + c.y) * area;
+        meshCentroid.z += (a.z + b.z + c.z) * area;
+        meshArea += area;
+    }
+    if(meshArea > 0.0f)
+    {
+        meshCentroid.x /= 3 * meshArea;
+        meshCentroid.y /= 3 * meshArea;
+        meshCentroid.z /= 3 * meshArea;
+    }
+
+    std::vector<Cluster> clusters(clusterStarts.size());
+    for(auto ind = 0; ind < clusters.size(); ++ind)
+    {
+        clusters[ind].start = clusterStarts[ind];
+        clusters[ind].end = ind + 1 < clusterStarts.size() ? clusterStarts[ind + 1] : triangleCount;
+        aiVector3D centroid, normalSum;
+        float area = 0.0f;
+        for(auto triangle = clusters[ind].start; triangle < clusters[ind].end; ++triangle)
+        {
+            const aiVector3D& a = positions[indices[triangle * 3]], & b = positions[indices[triangle * 3 + 1]], & c = positions[indices[triangle * 3 + 2]];
+            const aiVector3D ab(b.x - a.x, b.y - a.y, b.z - a.z), ac(c.x - a.x, c.y - a.y, c.z - a.z), normal = ab ^ ac;
+            const float triangleArea = std::sqrt(normal * normal);
+            centroid.x += (a.x + b.x + c.x) * triangleArea;
+            centroid.y += (a.y + b.y + c.y) * triangleArea;
+            centroid.z += (a.z + b.z + c.z) * triangleArea;
+            normalSum.x += normal.x;
+            normalSum.y += normal.y;
+            normalSum.z += normal.z;
+            area += triangleArea;
+        }
+        const float normalLength = std::sqrt(normalSum * normalSum);
+        if(area > 0.0f && normalLength > 0.0f)
+        {
+            const aiVector3D offset(centroid.x / (3 * area) - meshCentroid.x, centroid.y / (3 * area) - meshCentroid.y, centroid.z / (3 * area) - meshCentroid.z);
+            clusters[ind].sortKey = (offset * normalSum) / normalLength;
+        }
+        else clusters[ind].sortKey = 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+    {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(indexCount);
+    for(const auto& cluster : clusters) result.insert(result.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(uint32_t* indices, const uint32_t indexCount, const uint32_t vertexCount, std::vector<uint32_t>& vertexOrder)
+{
+    // vertices are renumbered in order of first use, unreferenced ones are kept at the end
+
+    std::vector<uint32_t> remap(vertexCount, ~0U);
+    vertexOrder.clear();
+    vertexOrder.reserve(vertexCount);
+    for(auto ind = 0; ind < indexCount; ++ind)
+    {
+        uint32_t& newIndex = remap[indices[ind]];
+        if(newIndex == ~0U)
+        {
+            newIndex = vertexOrder.size();
+            vertexOrder.push_back(indices[ind]);
+        }
+        indices[ind] = newIndex;
+    }
+    for(auto vertex = 0; vertex < vertexCount; ++vertex)
+    {
+        if(remap[vertex] == ~0U) vertexOrder.push_back(vertex);
+    }
+}
+
+void MeshOptimizer::buildMeshlets(const uint32_t* indices, const uint32_t indexCount, const aiVector3D* positions, const uint32_t vertexCount, std::vector<Meshlet>& meshlets)
+{
+    // triangles are taken in order until one would exceed a limit; after the cache optimization
+    // consecutive triangles are neighbours, so the runs come out compact without moving any index
+
+    meshlets.clear();
+    std::vector<uint32_t> lastMeshlet(vertexCount, ~0U);
+    Meshlet meshlet = {0, 0};
+    uint32_t meshletVertexCount = 0;
+    for(auto triangle = 0; triangle < indexCount / 3; ++triangle)
+    {
+        const uint32_t* corners = indices + triangle * 3;
+        uint32_t newVertexCount = 0;
+        for(auto corner = 0; corner < 3; ++corner)
+        {
+            if(lastMeshlet[corners[corner]] != meshlets.size()) ++newVertexCount;
+        }
+        if(meshletVertexCount + newVertexCount > MAX_MESHLET_VERTICES || meshlet.indexCount == MAX_MESHLET_TRIANGLES * 3)
+        {
+            computeMeshletBounds(indices, positions, meshlet);
+            meshlets.push_back(meshlet);
+            meshlet = {static_cast<uint32_t>(triangle * 3), 0};
+            meshletVertexCount = 0;
+        }
+        for(auto corner = 0; corner < 3; ++corner)
+        {
+            if(lastMeshlet[corners[corner]] == meshlets.size()) continue;
+            lastMeshlet[corners[corner]] = meshlets.size();
+            ++meshletVertexCount;
+        }
+        meshlet.indexCount += 3;
+    }
+    if(meshlet.indexCount)
+    {
+        computeMeshletBounds(indices, positions, meshlet);
+        meshlets.push_back(meshlet);
+    }
+}
+
+void MeshOptimizer::computeMeshletBounds(const uint32_t* indices, const aiVector3D* positions, Meshlet& meshlet)
+{
+    // the cone holds every triangle normal; triangles all face away from a point p when
+    // dot(center - p, coneAxis) >= coneCutoff * |center - p| + radius, which is what the cutoff is used for
+
+    static const float MIN_CONE_COSINE = 0.1f;      // wider cones are nearly never back facing and lose precision
+    const uint32_t* first = indices + meshlet.firstIndex;
+    aiVector3D min = positions[first[0]], max = min;
+    for(auto ind = 1; ind < meshlet.indexCount; ++ind)
+    {
+        const aiVector3D& position = positions[first[ind]];
+        min = aiVector3D(std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z));
+        max = aiVector3D(std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z));
+    }
+    meshlet.center = aiVector3D((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f);
+    meshlet.extents = aiVector3D((max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f);
+    meshlet.radius = 0.0f;
+    for(auto ind = 0; ind < meshlet.indexCount; ++ind)
+    {
+        const aiVector3D& position = positions[first[ind]];
+        const aiVector3D offset(position.x - meshlet.center.x, position.y - meshlet.center.y, position.z - meshlet.center.z);
+        meshlet.radius = std::max(meshlet.radius, std::sqrt(offset * offset));
+    }
+
+    std::vector<aiVector3D> normals;
+    normals.reserve(meshlet.indexCount / 3);
+    aiVector3D axis;
+    for(auto triangle = 0; triangle < meshlet.indexCount / 3; ++triangle)
+    {
+        const aiVector3D& a = positions[first[triangle * 3]], & b = positions[first[triangle * 3 + 1]], & c = positions[first[triangle * 3 + 2]];
+        const aiVector3D ab(b.x - a.x, b.y - a.y, b.z - a.z), ac(c.x - a.x, c.y - a.y, c.z - a.z), normal = ab ^ ac;
+        const float length = std::sqrt(normal * normal);
+        if(length == 0.0f) continue;
+        normals.push_back(aiVector3D(normal.x / length, normal.y / length, normal.z / length));
+        axis.x += normals.back().x;
+        axis.y += normals.back().y;
+        axis.z += normals.back().z;
+    }
+    const float axisLength = std::sqrt(axis * axis);
+    meshlet.coneAxis = axisLength > 0.0f ? aiVector3D(axis.x / axisLength, axis.y / axisLength, axis.z / axisLength) : aiVector3D(0.0f, 0.0f, 1.0f);
+    float minCosine = axisLength > 0.0f ? 1.0f : -1.0f;
+    for(const auto& normal : normals) minCosine = std::min(minCosine, normal * meshlet.coneAxis);
+    meshlet.coneCutoff = minCosine < MIN_CONE_COSINE ? 2.0f : std::sqrt(1.0f - minCosine * minCosine);
+}
+
+const float MeshOptimizer::simplify(const uint32_t* indices, const uint32_t indexCount, const aiVector3D* positions, const uint32_t vertexCount, const uint32_t targetIndexCount, std::vector<uint32_t>& result)
+{
+    // Garland-Heckbert: a vertex collapses onto a neighbour, so every level keeps using the original vertex data;
+    // planes are not weighted by area, so the error bounds the distance to every plane the vertex was on;
+    // vertices on edges without a twin going the other way (open borders, but also uv and normal seams) never move;
+    // each pass sorts the candidate collapses by error and applies the cheapest ones whose neighbourhoods are still untouched
+
+    struct Collapse
+    {
+        double error;
+        uint32_t from;
+        uint32_t to;
+    };
+
+    result.assign(indices, indices + indexCount);
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for(auto triangle = 0; triangle < indexCount / 3; ++triangle)
+    {
+        const aiVector3D& a = positions[indices[triangle * 3]], & b = positions[indices[triangle * 3 + 1]], & c = positions[indices[triangle * 3 + 2]];
+        const aiVector3D ab(b.x - a.x, b.y - a.y, b.z - a.z), ac(c.x - a.x, c.y - a.y, c.z - a.z), normal = ab ^ ac;
+        const double area = std::sqrt(static_cast<double>(normal * normal));
+        if(area == 0.0) continue;
+        const double plane[4] = {normal.x / area, normal.y / area, normal.z / area, -(normal * a) / area};
+        for(auto corner = 0; corner < 3; ++corner) addPlane(quadrics[indices[triangle * 3 + corner]], plane, 1.0);
+    }
+
+    std::vector<bool> locked(vertexCount, false);
+    std::vector<uint64_t> edges(indexCount);
+    for(auto ind = 0; ind < indexCount; ++ind)
+    {
+        const uint32_t next = ind % 3 == 2 ? ind - 2 : ind + 1;
+        edges[ind] = (static_cast<uint64_t>(indices[ind]) << 32) | indices[next];
+    }
+    std::sort(edges.begin(), edges.end());
+    for(const uint64_t edge : edges)
+    {
+        const uint64_t twin = (edge << 32) | (edge >> 32);
+        if(std::binary_search(edges.begin(), edges.end(), twin)) continue;
+        locked[edge >> 32] = true;
+        locked[edge & 0xFFFFFFFF] = true;
+    }
+
+    double maxError = 0.0;
+    std::vector<uint32_t> remap(vertexCount), triangleCounts(vertexCount), adjacencyOffsets(vertexCount + 1), adjacency;
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    while(result.size() > targetIndexCount)
+    {
+        const uint32_t triangleCount = result.size() / 3;
+        std::fill(triangleCounts.begin(), triangleCounts.end(), 0);
+        for(const uint32_t vertex : result) ++triangleCounts[vertex];
+        adjacencyOffsets[0] = 0;
+        for(auto vertex = 0; vertex < vertexCount; ++vertex) adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + triangleCounts[vertex];
+        adjacency.resize(result.size());
+        std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for(auto triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            for(auto corner = 0; corner < 3; ++corner) adjacency[adjacencyFill[result[triangle * 3 + corner]]++] = triangle;
+        }
+
+        // interior edges show up once per direction, taking the one with the lower first vertex visits each of them once
+
+        collapses.clear();
+        for(auto ind = 0; ind < result.size(); ++ind)
+        {
+            const uint32_t a = result[ind], b = result[ind % 3 == 2 ? ind - 2 : ind + 1];
+            if(a >= b) continue;
+            Quadric sum = quadrics[a];
+            addQuadric(sum, quadrics[b]);
+            if(!locked[a]) collapses.push_back({evaluateQuadric(sum, positions[b]), a, b});
+            if(!locked[b]) collapses.push_back({evaluateQuadric(sum, positions[a]), b, a});
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& first, const Collapse& second)
+        {
+            if(first.error != second.error) return first.error < second.error;
+            if(first.from != second.from) return first.from < second.from;
+            return first.to < second.to;
+        });
+
+        for(auto vertex = 0; vertex < vertexCount; ++vertex) remap[vertex] = vertex;
+        std::fill(touched.begin(), touched.end(), false);
+        uint32_t remainingTriangles = triangleCount, collapseCount = 0;
+        for(const auto& collapse : collapses)
+        {
+            if(remainingTriangles * 3 <= targetIndexCount) break;
+            if(touched[collapse.from] || touched[collapse.to]) continue;
+            const uint32_t* triangles = adjacency.data() + adjacencyOffsets[collapse.from];
+            const uint32_t fromTriangleCount = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+            if(collapseFlips(result.data(), triangles, fromTriangleCount, positions, collapse.from, collapse.to)) continue;
+            remap[collapse.from] = collapse.to;
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            ++collapseCount;
+            for(auto ind = 0; ind < fromTriangleCount; ++ind)
+            {
+                const uint32_t* corners = result.data() + triangles[ind] * 3;
+                if(corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) --remainingTriangles;
+                for(auto corner = 0; corner < 3; ++corner) touched[corners[corner]] = true;
+            }
+        }
+        if(!collapseCount) break;
+
+        uint32_t kept = 0;
+        for(auto triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            const uint32_t a = remap[result[triangle * 3]], b = remap[result[triangle * 3 + 1]], c = remap[result[triangle * 3 + 2]];
+            if(a == b || b == c || a == c) continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+    return static_cast<float>(std::sqrt(maxError));
+}
+
+void MeshOptimizer::addPlane(Quadric& quadric, const double* plane, const double weight)
+{
+    uint32_t term = 0;
+    for(auto row = 0; row < 4; ++row)
+    {
+        for(auto column = row; column < 4; ++column) quadric.terms[term++] += plane[row] * plane[column] * weight;
+    }
+}
+
+void MeshOptimizer::addQuadric(Quadric& quadric, const Quadric& other)
+{
+    for(auto term = 0; term < 10; ++term) quadric.terms[term] += other.terms[term];
+}
+
+const double MeshOptimizer::evaluateQuadric(const Quadric& quadric, const aiVector3D& position)
+{
+    // off-diagonal terms appear twice in the full matrix
+
+    const double vector[4] = {position.x, position.y, position.z, 1.0};
+    double result = 0.0;
+    uint32_t term = 0;
+    for(auto row = 0; row < 4; ++row)
+    {
+        for(auto column = row; column < 4; ++column) result += quadric.terms[term++] * vector[row] * vector[column] * (row == column ? 1.0 : 2.0);
+    }
+    return std::max(result, 0.0);
+}
+
+const bool MeshOptimizer::collapseFlips(const uint32_t* indices, const uint32_t* triangles, const uint32_t triangleCount, const aiVector3D* positions, const uint32_t from, const uint32_t to)
+{
+    // triangles that survive the collapse must keep facing the same way
+
+    for(auto ind = 0; ind < triangleCount; ++ind)
+    {
+        const uint32_t* corners = indices + triangles[ind] * 3;
+        if(corners[0] == to || corners[1] == to || corners[2] == to) continue;
+        aiVector3D before[3], after[3];
+        for(auto corner = 0; corner < 3; ++corner)
+        {
+            before[corner] = positions[corners[corner]];
+            after[corner] = positions[corners[corner] == from ? to : corners[corner]];
+        }
+        const aiVector3D beforeNormal = aiVector3D(before[1].x - before[0].x, before[1].y - before[0].y, before[1].z - before[0].z) ^ aiVector3D(before[2].x - before[0].x, before[2].y - before[0].y, before[2].z - before[0].z);
+        const aiVector3D afterNormal = aiVector3D(after[1].x - after[0].x, after[1].y - after[0].y, after[1].z - after[0].z) ^ aiVector3D(after[2].x - after[0].x, after[2].y - after[0].y, after[2].z - after[0].z);
+        if(beforeNormal * afterNormal <= 0.0f) return true;
+    }
+    return false;
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include<MeshUtils.hpp>
+#include<algorithm>
+#include<cmath>
+#include<cstring>
 
 const uint32_t VertexBuffer::getFirstTextureCoordIndex(const aiMesh* mesh)
 {
@@ -28,6 +31,127 @@ const bool VertexBuffer::hasTangentsAndBitangents(const aiMesh* mesh)
     return mesh->HasTangentsAndBitangents();
 }
 
+void VertexBuffer::addInstanceInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes)
+{
+    static const uint32_t MATRIX_COLUMN_COUNT = 4;
+    const uint32_t vertexBindingCount = bindings.getSize(), vertexAttributeCount = attributes.getSize();
+    Array<VkVertexInputBindingDescription> vertexBindings(std::move(bindings));
+    Array<VkVertexInputAttributeDescription> vertexAttributes(std::move(attributes));
+    bindings.create(vertexBindingCount + 1);
+    attributes.create(vertexAttributeCount + MATRIX_COLUMN_COUNT);
+    for(auto ind = 0; ind < vertexBindingCount; ++ind) bindings[ind] = vertexBindings[ind];
+    for(auto ind = 0; ind < vertexAttributeCount; ++ind) attributes[ind] = vertexAttributes[ind];
+    bindings[vertexBindingCount] = 
+    {
+        vertexBindingCount,
+        sizeof(float) * 4 * MATRIX_COLUMN_COUNT,
+        VkVertexInputRate::VK_VERTEX_INPUT_RATE_INSTANCE
+    };
+    for(auto column = 0; column < MATRIX_COLUMN_COUNT; ++column)
+    {
+        attributes[vertexAttributeCount + column] = 
+        {
+            vertexAttributeCount + column,
+            vertexBindingCount,
+            VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT,
+            static_cast<uint32_t>(sizeof(float) * 4 * column)
+        };
+    }
+}
+
+const PositionDecode VertexBuffer::getPositionDecode() const
+{
+    return {{0.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
+}
+
+const uint32_t VertexBuffer::getVertexStride() const
+{
+    return getVertexCount() ? getBufferSize() / getVertexCount() : 0;
+}
+
+void VertexBuffer::reorderVertices(const std::vector<uint32_t>& order)
+{
+    // every layout is a plain array of fixed size vertices, so they are moved as raw bytes
+
+    const uint32_t count = getVertexCount();
+    if(!count) return;
+    const uint32_t stride = getVertexStride();
+    uint8_t* data = static_cast<uint8_t*>(getBufferPtr());
+    const std::vector<uint8_t> original(data, data + getBufferSize());
+    for(auto ind = 0; ind < count; ++ind)
+    {
+        memcpy(data + ind * stride, original.data() + order[ind] * stride, stride);
+    }
+}
+
+const PositionDecode VertexBuffer::computePositionDecode(const aiMesh* mesh)
+{
+    aiVector3D min = mesh->mVertices[0], max = mesh->mVertices[0];
+    for(auto ind = 1; ind < mesh->mNumVertices; ++ind)
+    {
+        const aiVector3D& pos = mesh->mVertices[ind];
+        min.x = std::min(min.x, pos.x);
+        min.y = std::min(min.y, pos.y);
+        min.z = std::min(min.z, pos.z);
+        max.x = std::max(max.x, pos.x);
+        max.y = std::max(max.y, pos.y);
+        max.z = std::max(max.z, pos.z);
+    }
+    return {{min.x, min.y, min.z, 0.0f}, {max.x - min.x, max.y - min.y, max.z - min.z, 1.0f}};
+}
+
+void VertexBuffer::quantizePosition(const aiVector3D& position, const PositionDecode& decode, uint16_t* result)
+{
+    static const float UNORM_MAX = 65535.0f;
+    for(auto axis = 0; axis < 3; ++axis)
+    {
+        const float normalized = decode.scale[axis] > 0.0f ? (position[axis] - decode.offset[axis]) / decode.scale[axis] : 0.0f;
+        result[axis] = static_cast<uint16_t>(std::round(std::min(std::max(normalized, 0.0f), 1.0f) * UNORM_MAX));
+    }
+}
+
+void VertexBuffer::encodeOctahedral(const aiVector3D& direction, int16_t* result)
+{
+    // the direction is projected onto the octahedron |x| + |y| + |z| = 1, the lower half is folded over the upper one
+
+    static const float SNORM_MAX = 32767.0f;
+    const float length = std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z);
+    float x = length > 0.0f ? direction.x / length : 0.0f, y = length > 0.0f ? direction.y / length : 0.0f;
+    if(direction.z < 0.0f)
+    {
+        const float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    result[0] = static_cast<int16_t>(std::round(std::min(std::max(x, -1.0f), 1.0f) * SNORM_MAX));
+    result[1] = static_cast<int16_t>(std::round(std::min(std::max(y, -1.0f), 1.0f) * SNORM_MAX));
+}
+
+const uint16_t VertexBuffer::encodeHalf(const float value)
+{
+    // rounds to nearest, values too large for a half become infinity
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if(exponent <= 0)
+    {
+        if(exponent < -10) return sign;
+        mantissa |= 0x800000;
+        return sign | ((mantissa >> (14 - exponent)) + ((mantissa >> (13 - exponent)) & 1));
+    }
+    if(exponent >= 31) return sign | 0x7c00;
+    return sign | ((((exponent << 10) | (mantissa >> 13))) + ((mantissa >> 12) & 1));
+}
+
+const bool VertexBuffer::hasNegativeBitangent(const aiVector3D& normal, const aiVector3D& tangent, const aiVector3D& bitangent)
+{
+    return ((normal ^ tangent) * bitangent) < 0.0f;
+}
+
 //standard
 
 const bool VertexBufferStandard::checkCompatibility(const aiMesh* mesh) const
@@ -79,7 +203,7 @@ const uint32_t VertexBufferStandard::getVertexCount() const
     return vertices.getSize();
 }
 
-void VertexBufferStandard::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes)
+void VertexBufferStandard::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced)
 {
     bindings.create(1);
     bindings[0] = 
@@ -117,6 +241,7 @@ void VertexBufferStandard::getGraphicsPipelineVertexInputState(Array<VkVertexInp
         VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT,
         offsetof(Vertex, btan)
     };
+    if(instanced) addInstanceInputState(bindings, attributes);
 }
 
 void VertexBufferStandard::clear()
@@ -172,7 +297,7 @@ const uint32_t VertexBufferNotTextured::getVertexCount() const
     return vertices.getSize();
 }
 
-void VertexBufferNotTextured::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes)
+void VertexBufferNotTextured::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced)
 {
     bindings.create(1);
     bindings[0] = 
@@ -203,6 +328,7 @@ void VertexBufferNotTextured::getGraphicsPipelineVertexInputState(Array<VkVertex
         VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT,
         offsetof(Vertex, btanAndNormZ)
     };
+    if(instanced) addInstanceInputState(bindings, attributes);
 }
 
 void VertexBufferNotTextured::clear()
@@ -256,7 +382,7 @@ const uint32_t VertexBufferWithNormalMap::getVertexCount() const
     return vertices.getSize();
 }
 
-void VertexBufferWithNormalMap::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes)
+void VertexBufferWithNormalMap::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced)
 {
     bindings.create(1);
     bindings[0] = 
@@ -287,9 +413,285 @@ void VertexBufferWithNormalMap::getGraphicsPipelineVertexInputState(Array<VkVert
         VkFormat::VK_FORMAT_R32G32B32A32_SFLOAT,
         offsetof(Vertex, btanAndV)
     };
+    if(instanced) addInstanceInputState(bindings, attributes);
 }
 
 void VertexBufferWithNormalMap::clear()
 {
     vertices.clear();
+}
+
+//standard packed
+
+const bool VertexBufferStandardPacked::checkCompatibility(const aiMesh* mesh) const
+{
+    if(VertexBuffer::hasPositions(mesh)
+        && VertexBuffer::hasNormals(mesh)
+        && VertexBuffer::hasTangentsAndBitangents(mesh)
+        && VertexBuffer::getFirstTextureCoordIndex(mesh) != (~0)) 
+            return true;
+    return false;
+}
+
+void VertexBufferStandardPacked::loadFromAiMesh(const aiMesh* mesh)
+{
+    static const uint16_t POSITIVE_SIGN = 65535;
+    vertices.create(mesh->mNumVertices);
+    decode = computePositionDecode(mesh);
+    auto textureCoordIndex = getFirstTextureCoordIndex(mesh);
+    for(auto ind = 0; ind < vertices.getSize(); ++ind)
+    {
+        const aiVector3D* pos = mesh->mVertices + ind, * uv = mesh->mTextureCoords[textureCoordIndex] + ind, * normal = mesh->mNormals + ind, * tan = mesh->mTangents + ind, * btan = mesh->mBitangents + ind;
+        quantizePosition(*pos, decode, vertices[ind].posAndBitangentSign);
+        vertices[ind].posAndBitangentSign[3] = hasNegativeBitangent(*normal, *tan, *btan) ? 0 : POSITIVE_SIGN;
+        encodeOctahedral(*normal, vertices[ind].normal);
+        encodeOctahedral(*tan, vertices[ind].tan);
+        vertices[ind].uv[0] = encodeHalf(uv->x);
+        vertices[ind].uv[1] = encodeHalf(uv->y);
+    }
+}
+
+void* VertexBufferStandardPacked::getBufferPtr()
+{
+    return vertices.getPtr();
+}
+
+const uint32_t VertexBufferStandardPacked::getBufferSize() const
+{
+    return sizeof(Vertex) * vertices.getSize();
+}
+
+const uint32_t VertexBufferStandardPacked::getVertexCount() const
+{
+    return vertices.getSize();
+}
+
+void VertexBufferStandardPacked::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced)
+{
+    bindings.create(1);
+    bindings[0] = 
+    {
+        0,
+        sizeof(Vertex),
+        VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX
+    };
+    attributes.create(4);
+    attributes[0] = 
+    {
+        0,
+        0,
+        VkFormat::VK_FORMAT_R16G16B16A16_UNORM,
+        offsetof(Vertex, posAndBitangentSign)
+    };
+    attributes[1] = 
+    {
+        1,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SNORM,
+        offsetof(Vertex, normal)
+    };
+    attributes[2] = 
+    {
+        2,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SNORM,
+        offsetof(Vertex, tan)
+    };
+    attributes[3] = 
+    {
+        3,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SFLOAT,
+        offsetof(Vertex, uv)
+    };
+    if(instanced) addInstanceInputState(bindings, attributes);
+}
+
+void VertexBufferStandardPacked::clear()
+{
+    vertices.clear();
+}
+
+const PositionDecode VertexBufferStandardPacked::getPositionDecode() const
+{
+    return decode;
+}
+
+//not textured packed
+
+const bool VertexBufferNotTexturedPacked::checkCompatibility(const aiMesh* mesh) const
+{
+    if(VertexBuffer::hasPositions(mesh)
+        && VertexBuffer::hasNormals(mesh)
+        && VertexBuffer::hasTangentsAndBitangents(mesh)) 
+            return true;
+    return false;
+}
+
+void VertexBufferNotTexturedPacked::loadFromAiMesh(const aiMesh* mesh)
+{
+    static const uint16_t POSITIVE_SIGN = 65535;
+    vertices.create(mesh->mNumVertices);
+    decode = computePositionDecode(mesh);
+    for(auto ind = 0; ind < vertices.getSize(); ++ind)
+    {
+        const aiVector3D* pos = mesh->mVertices + ind, * normal = mesh->mNormals + ind, * tan = mesh->mTangents + ind, * btan = mesh->mBitangents + ind;
+        quantizePosition(*pos, decode, vertices[ind].posAndBitangentSign);
+        vertices[ind].posAndBitangentSign[3] = hasNegativeBitangent(*normal, *tan, *btan) ? 0 : POSITIVE_SIGN;
+        encodeOctahedral(*normal, vertices[ind].normal);
+        encodeOctahedral(*tan, vertices[ind].tan);
+    }
+}
+
+void* VertexBufferNotTexturedPacked::getBufferPtr()
+{
+    return vertices.getPtr();
+}
+
+const uint32_t VertexBufferNotTexturedPacked::getBufferSize() const
+{
+    return sizeof(Vertex) * vertices.getSize();
+}
+
+const uint32_t VertexBufferNotTexturedPacked::getVertexCount() const
+{
+    return vertices.getSize();
+}
+
+void VertexBufferNotTexturedPacked::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced)
+{
+    bindings.create(1);
+    bindings[0] = 
+    {
+        0,
+        sizeof(Vertex),
+        VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX
+    };
+    attributes.create(3);
+    attributes[0] = 
+    {
+        0,
+        0,
+        VkFormat::VK_FORMAT_R16G16B16A16_UNORM,
+        offsetof(Vertex, posAndBitangentSign)
+    };
+    attributes[1] = 
+    {
+        1,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SNORM,
+        offsetof(Vertex, normal)
+    };
+    attributes[2] = 
+    {
+        2,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SNORM,
+        offsetof(Vertex, tan)
+    };
+    if(instanced) addInstanceInputState(bindings, attributes);
+}
+
+void VertexBufferNotTexturedPacked::clear()
+{
+    vertices.clear();
+}
+
+const PositionDecode VertexBufferNotTexturedPacked::getPositionDecode() const
+{
+    return decode;
+}
+
+//normal mapped packed
+
+const bool VertexBufferWithNormalMapPacked::checkCompatibility(const aiMesh* mesh) const
+{
+    if(VertexBuffer::hasPositions(mesh)
+        && VertexBuffer::hasTangentsAndBitangents(mesh)
+        && VertexBuffer::getFirstTextureCoordIndex(mesh) != (~0)) 
+            return true;
+    return false;
+}
+
+void VertexBufferWithNormalMapPacked::loadFromAiMesh(const aiMesh* mesh)
+{
+    vertices.create(mesh->mNumVertices);
+    decode = computePositionDecode(mesh);
+    auto textureCoordIndex = getFirstTextureCoordIndex(mesh);
+    for(auto ind = 0; ind < vertices.getSize(); ++ind)
+    {
+        const aiVector3D* pos = mesh->mVertices + ind, * uv = mesh->mTextureCoords[textureCoordIndex] + ind, * tan = mesh->mTangents + ind, * btan = mesh->mBitangents + ind;
+        quantizePosition(*pos, decode, vertices[ind].pos);
+        vertices[ind].pos[3] = 0;
+        encodeOctahedral(*tan, vertices[ind].tan);
+        encodeOctahedral(*btan, vertices[ind].btan);
+        vertices[ind].uv[0] = encodeHalf(uv->x);
+        vertices[ind].uv[1] = encodeHalf(uv->y);
+    }
+}
+
+void* VertexBufferWithNormalMapPacked::getBufferPtr()
+{
+    return vertices.getPtr();
+}
+
+const uint32_t VertexBufferWithNormalMapPacked::getBufferSize() const
+{
+    return sizeof(Vertex) * vertices.getSize();
+}
+
+const uint32_t VertexBufferWithNormalMapPacked::getVertexCount() const
+{
+    return vertices.getSize();
+}
+
+void VertexBufferWithNormalMapPacked::getGraphicsPipelineVertexInputState(Array<VkVertexInputBindingDescription>& bindings, Array<VkVertexInputAttributeDescription>& attributes, const bool instanced)
+{
+    bindings.create(1);
+    bindings[0] = 
+    {
+        0,
+        sizeof(Vertex),
+        VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX
+    };
+    attributes.create(4);
+    attributes[0] = 
+    {
+        0,
+        0,
+        VkFormat::VK_FORMAT_R16G16B16A16_UNORM,
+        offsetof(Vertex, pos)
+    };
+    attributes[1] = 
+    {
+        1,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SNORM,
+        offsetof(Vertex, tan)
+    };
+    attributes[2] = 
+    {
+        2,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SNORM,
+        offsetof(Vertex, btan)
+    };
+    attributes[3] = 
+    {
+        3,
+        0,
+        VkFormat::VK_FORMAT_R16G16_SFLOAT,
+        offsetof(Vertex, uv)
+    };
+    if(instanced) addInstanceInputState(bindings, attributes);
+}
+
+void VertexBufferWithNormalMapPacked::clear()
+{
+    vertices.clear();
+}
+
+const PositionDecode VertexBufferWithNormalMapPacked::getPositionDecode() const
+{
+    return decode;
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include<ObjectManagementStrategy.hpp>
+#include<MeshUtils.hpp>
+#include<TextureCompressor.hpp>
 #include<memory.h>
+#include<algorithm>
+#include<unordered_set>
 
 SharedMemoryObjectManagementStrategy::SharedMemoryObjectManagementStrategy(){}
 
@@ -11,14 +15,24 @@ void SharedMemoryObjectManagementStrategy::create(const System* system, Synchron
     vkGetPhysicalDeviceProperties(system->getPhysicalDevice(), &deviceProperties);
     createDescriptorLayouts();
     preloadDescriptorSets();
-    updateFence = syncPool->getFenceCount();
-    syncPool->addFences(1, true);
+    firstUpdateFence = syncPool->getFenceCount();
+    syncPool->addFences(STAGING_FRAME_COUNT, true);
     updateSemaphore = syncPool->getSemaphoreCount();
     syncPool->addSemaphores(1);
-    updateCommandBuffer = commandPool->getCurrentPoolSize();
-    commandPool->addCommandBuffers(1);
-    commandPool->allocateCommandBuffers(updateCommandBuffer, 1, VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY);
-    memoryPool.create(system, MemoryObjects::MOCount);
+    firstUpdateCommandBuffer = commandPool->getCurrentPoolSize();
+    commandPool->addCommandBuffers(STAGING_FRAME_COUNT);
+    commandPool->allocateCommandBuffers(firstUpdateCommandBuffer, STAGING_FRAME_COUNT, VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    if(system->hasDedicatedTransferQueue())
+    {
+        transferCommandPool.create(system, true, system->getTransferQueue().familyIndex);
+        transferCommandPool.addCommandBuffers(STAGING_FRAME_COUNT);
+        transferCommandPool.allocateCommandBuffers(0, STAGING_FRAME_COUNT, VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        firstTransferSemaphore = syncPool->getSemaphoreCount();
+        syncPool->addSemaphores(STAGING_FRAME_COUNT);
+        firstGraphicsDoneSemaphore = syncPool->getSemaphoreCount();
+        syncPool->addSemaphores(STAGING_FRAME_COUNT);
+    }
+    memoryPool.create(system);
     bufferHolder.create(system);
     bufferHolder.addBuffers(Buffers::BCount);
     imageHolder.create(system);
@@ -27,7 +41,7 @@ void SharedMemoryObjectManagementStrategy::create(const System* system, Synchron
 
 void SharedMemoryObjectManagementStrategy::createDescriptorLayouts()
 {
-    descriptorLayoutHolder.create(system, DescriptorLayouts::DLCount, DrawableType::DTCount);
+    descriptorLayoutHolder.create(system, DescriptorLayouts::DLCount, DrawableType::DTCount + 1);     // the last pipeline layout is the compute one
     VkDescriptorSetLayoutBinding sampledFragBinding = 
     {
         0,
@@ -49,45 +63,95 @@ void SharedMemoryObjectManagementStrategy::createDescriptorLayouts()
         1,
         VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_GEOMETRY_BIT,
         nullptr
+    }, dynamicUniformVertTeseGeomBinding = 
+    {
+        0,
+        VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        1,
+        VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_GEOMETRY_BIT,
+        nullptr
     };
-    Array<VkDescriptorSetLayoutBinding> sampledFragBindings = {sampledFragBinding}, uniformFragBindings = {uniformFragBinding}, uniformVertTeseGeomBindings = {uniformVertTeseGeomBinding};
+    Array<VkDescriptorSetLayoutBinding> sampledFragBindings = {sampledFragBinding}, uniformFragBindings = {uniformFragBinding}, uniformVertTeseGeomBindings = {uniformVertTeseGeomBinding}, dynamicUniformVertTeseGeomBindings = {dynamicUniformVertTeseGeomBinding};
+    Array<VkDescriptorSetLayoutBinding> storageComputeBindings(COMPUTE_STORAGE_BINDING_COUNT);
+    for(auto ind = 0; ind < COMPUTE_STORAGE_BINDING_COUNT; ++ind)
+    {
+        storageComputeBindings[ind] = 
+        {
+            static_cast<uint32_t>(ind),
+            VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            1,
+            VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT,
+            nullptr
+        };
+    }
     descriptorLayoutHolder.createSetLayout(DescriptorLayouts::DLSampledImageFrag, sampledFragBindings);
     descriptorLayoutHolder.createSetLayout(DescriptorLayouts::DLUniformFrag, uniformFragBindings);
     descriptorLayoutHolder.createSetLayout(DescriptorLayouts::DLUniformVertTeseGeom, uniformVertTeseGeomBindings);
+    descriptorLayoutHolder.createSetLayout(DescriptorLayouts::DLDynamicUniformVertTeseGeom, dynamicUniformVertTeseGeomBindings);
+    descriptorLayoutHolder.createSetLayout(DescriptorLayouts::DLStorageCompute, storageComputeBindings);
     Array<uint32_t> notTexturedSetLayouts = 
     {
         DescriptorLayouts::DLUniformVertTeseGeom,             // view n' projection
-        DescriptorLayouts::DLUniformVertTeseGeom,             // model
+        DescriptorLayouts::DLDynamicUniformVertTeseGeom,      // model
         DescriptorLayouts::DLUniformFrag                      // material colors
     };
     Array<uint32_t> texturedSetLayouts = 
     {
         DescriptorLayouts::DLUniformVertTeseGeom,             // view & projection
-        DescriptorLayouts::DLUniformVertTeseGeom,             // model
+        DescriptorLayouts::DLDynamicUniformVertTeseGeom,      // model
         DescriptorLayouts::DLUniformFrag,                     // mat colors
         DescriptorLayouts::DLSampledImageFrag                 // texture
     };
     Array<uint32_t> texturedWithNormalMapSetLayouts = 
     {
         DescriptorLayouts::DLUniformVertTeseGeom,             // view and projection
-        DescriptorLayouts::DLUniformVertTeseGeom,             // model
+        DescriptorLayouts::DLDynamicUniformVertTeseGeom,      // model
         DescriptorLayouts::DLUniformFrag,                     // material colors
         DescriptorLayouts::DLSampledImageFrag,                // texture
         DescriptorLayouts::DLSampledImageFrag                 // normal map
     };
-    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTNotTextured, notTexturedSetLayouts);
-    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTTextured, texturedSetLayouts);
-    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTTexturedWithNormalMap, texturedWithNormalMapSetLayouts);
+
+    // every layout has the same push constant range, used by packed vertex shaders to decode positions
+
+    Array<VkPushConstantRange> pushConstantRanges = 
+    {
+        {
+            VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT,
+            0,
+            sizeof(PositionDecode)
+        }
+    };
+    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTNotTextured, notTexturedSetLayouts, pushConstantRanges);
+    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTTextured, texturedSetLayouts, pushConstantRanges);
+    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTTexturedWithNormalMap, texturedWithNormalMapSetLayouts, pushConstantRanges);
+
+    Array<uint32_t> computeSetLayouts = {DescriptorLayouts::DLStorageCompute};
+    Array<VkPushConstantRange> computePushConstantRanges = 
+    {
+        {
+            VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            COMPUTE_PUSH_CONSTANT_SIZE
+        }
+    };
+    descriptorLayoutHolder.createPipelineLayout(DrawableType::DTCount, computeSetLayouts, computePushConstantRanges);
 }
 
 void SharedMemoryObjectManagementStrategy::preloadDescriptorSets()
 {
-    Array<VkDescriptorPoolSize> poolSizes(2);
+    // per-object uniforms all go through the single dynamic set, so node count doesn't affect the pool size;
+    // sets of freed images and uniforms go back to the pool and their indices are handed out again
+
+    Array<VkDescriptorPoolSize> poolSizes(4);
     poolSizes[0].type = VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = MAX_UNIFORM_COUNT;
     poolSizes[1].type = VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = MAX_TEXTURE_COUNT;
-    descriptorPool.create(system, MAX_TEXTURE_COUNT + MAX_UNIFORM_COUNT, poolSizes);
+    poolSizes[2].type = VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[2].descriptorCount = 1;
+    poolSizes[3].type = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[3].descriptorCount = MAX_COMPUTE_SET_COUNT * COMPUTE_STORAGE_BINDING_COUNT;
+    descriptorPool.create(system, MAX_TEXTURE_COUNT + MAX_UNIFORM_COUNT + 1 + MAX_COMPUTE_SET_COUNT, poolSizes, VkDescriptorPoolCreateFlagBits::VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
 }
 
 void SharedMemoryObjectManagementStrategy::pickDepthStencilFormat(VkFormat& format, VkImageTiling& tiling) const
@@ -151,31 +215,65 @@ void SharedMemoryObjectManagementStrategy::pickImageFormat(VkFormat& format, VkI
     tiling = savedTiling;
 }
 
+const bool SharedMemoryObjectManagementStrategy::pickCompressedImageFormat(const bool normalMap, VkFormat& format) const
+{
+    // BC7 keeps colors closest to the source, BC3 and BC1 are lower quality fallbacks;
+    // normal maps only keep x and y in BC5, each with the precision of a whole BC4 block
+
+    const std::vector<VkFormat> candidates = normalMap ? std::vector<VkFormat>{VkFormat::VK_FORMAT_BC5_UNORM_BLOCK} 
+        : std::vector<VkFormat>{VkFormat::VK_FORMAT_BC7_UNORM_BLOCK, VkFormat::VK_FORMAT_BC3_UNORM_BLOCK, VkFormat::VK_FORMAT_BC1_RGB_UNORM_BLOCK};
+    VkFormatFeatureFlags features = VkFormatFeatureFlagBits::VK_FORMAT_FEATURE_TRANSFER_DST_BIT | VkFormatFeatureFlagBits::VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VkFormatFeatureFlagBits::VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    for(const auto& fmt : candidates)
+    {
+        if(imageHolder.checkFormatSupport(fmt, features))
+        {
+            format = fmt;
+            return true;
+        }
+    }
+    return false;
+}
+
 void SharedMemoryObjectManagementStrategy::allocateTransferBuffer()
 {
     VkBufferUsageFlags usage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    uint32_t size = std::max(MAX_IMAGE_DIMENSION * MAX_IMAGE_DIMENSION * 4, MAX_VERTEX_SIZE * MAX_VERTEX_COUNT);
-    const VkDeviceSize& alignment = deviceProperties.limits.minMemoryMapAlignment;
+    uint32_t size = std::max(MAX_IMAGE_DIMENSION * MAX_IMAGE_DIMENSION * 4 * 4 / 3 + 4, MAX_VERTEX_SIZE * MAX_VERTEX_COUNT);     // an RGBA image with all its mipmaps
+
+    // every staging allocation starts at an offset suitable both for copies and for flushing non-coherent memory,
+    // copies into block compressed images also need it to be a multiple of their 16 byte blocks
+
+    uint32_t alignment = MemoryPool::align((const uint32_t)std::max(deviceProperties.limits.optimalBufferCopyOffsetAlignment, (VkDeviceSize)16), (const uint32_t)deviceProperties.limits.nonCoherentAtomSize);
+    alignment = MemoryPool::align((const uint32_t)alignment, (const uint32_t)deviceProperties.limits.minMemoryMapAlignment);
     size = (size % alignment != 0) ? (size / alignment + 1) * alignment : size;
     bufferHolder.initBuffer(Buffers::BTransfer, size, usage);
-    memoryPool.allocate(MemoryObjects::MOTransfer, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT /*temporarily | VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_COHERENT_BIT*/, bufferHolder.getMemoryRequirements(Buffers::BTransfer));
-    bufferHolder.bindMemory(memoryPool[MemoryObjects::MOTransfer], 0, Buffers::BTransfer);
-    mappedTransferMemory = memoryPool.map(MemoryObjects::MOTransfer, 0, size);
+    bufferMemory[Buffers::BTransfer] = memoryPool.allocate(VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, bufferHolder.getMemoryRequirements(Buffers::BTransfer), true);
+    bufferHolder.bindMemory(memoryPool.getMemory(bufferMemory[Buffers::BTransfer]), bufferMemory[Buffers::BTransfer].offset, Buffers::BTransfer);
+    stagingRing.create(system, syncPool, &memoryPool, bufferMemory[Buffers::BTransfer], size, alignment);
 }
 
-void SharedMemoryObjectManagementStrategy::allocateSampledImage(const VkExtent3D& extent, SampledImageInfo& sampledImage, DescriptorInfo& sampledImageDescriptor)
+void SharedMemoryObjectManagementStrategy::allocateSampledImage(const VkExtent3D& extent, SampledImageInfo& sampledImage, DescriptorInfo& sampledImageDescriptor, const VkFormat format, const uint32_t mipmapLevelCount)
 {
+    // generated mipmaps are blitted from the level above, so only those images are transfer sources
+
     const uint32_t index = imageHolder.getCurrentImageCount(), viewIndex = imageHolder.getCurrentViewCount(), samplerIndex = imageHolder.getCurrentSamplerCount();
-    uint32_t mipmapLevels;
-    VkFormat format;
-    VkImageTiling tiling;
+    const bool generateMipmaps = format == VkFormat::VK_FORMAT_UNDEFINED;
+    uint32_t mipmapLevels = generateMipmaps ? 0 : mipmapLevelCount;
+    VkFormat imageFormat = format;
+    VkImageTiling tiling = VkImageTiling::VK_IMAGE_TILING_OPTIMAL;
     VkImageType type = VkImageType::VK_IMAGE_TYPE_2D;
-    VkImageUsageFlags usage = VkImageUsageFlagBits::VK_IMAGE_USAGE_SAMPLED_BIT | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_DST_BIT | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    pickImageFormat(format, tiling);
+    VkImageUsageFlags usage = VkImageUsageFlagBits::VK_IMAGE_USAGE_SAMPLED_BIT | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if(generateMipmaps)
+    {
+        usage |= VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        pickImageFormat(imageFormat, tiling);
+    }
     imageHolder.addImages(1);
     imageHolder.addViews(1);
     imageHolder.addSamplers(1);
-    imageHolder.initImage(index, 0, type, format, extent, true, mipmapLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, tiling, usage);
+    imageHolder.initImage(index, 0, type, imageFormat, extent, true, mipmapLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, tiling, usage);
+    bindImageMemory(index, tiling);
+    ++imageStatistics.imageCount;
+    imageStatistics.memoryBytes += imageMemory[index].size;
     imageHolder.initSampler(samplerIndex, 0, mipmapLevels - 1);
     sampledImage.image.holder = &imageHolder;
     sampledImage.image.imageIndex = index;
@@ -191,16 +289,7 @@ void SharedMemoryObjectManagementStrategy::allocateSampledImage(const VkExtent3D
         0,
         1
     };
-    ViewCreateCommand viewCmd = 
-    {
-        viewIndex,
-        index,
-        VkImageViewType::VK_IMAGE_VIEW_TYPE_2D,
-        format,
-        subresource       
-    };
-    memoryRequirements[MemoryObjects::MOImage].push_back(imageHolder.getMemoryRequirements(index));
-    viewCreateCommands.push_back(viewCmd);
+    imageHolder.initView(viewIndex, index, VkImageViewType::VK_IMAGE_VIEW_TYPE_2D, imageFormat, subresource);
 
     InitialImageLayoutUpdateCommand layoutUpdateCmd = 
     {
@@ -212,12 +301,11 @@ void SharedMemoryObjectManagementStrategy::allocateSampledImage(const VkExtent3D
 
     // descriptor creation
 
-    Array<VkDescriptorSetLayout> layouts = {descriptorLayoutHolder.getSetLayout(DescriptorLayouts::DLSampledImageFrag)};
-    descriptorPool.allocateSets(currentDescriptorCount, layouts);
     sampledImageDescriptor.pool = &descriptorPool;
-    sampledImageDescriptor.setIndex = currentDescriptorCount;
+    sampledImageDescriptor.setIndex = allocateDescriptorSet(DescriptorLayouts::DLSampledImageFrag);
     sampledImageDescriptor.binding = 0;
     sampledImageDescriptor.arrayElement = 0;
+    sampledImageDescriptor.dynamicOffset = 0;
 
     // descriptor update command creation
 
@@ -225,13 +313,12 @@ void SharedMemoryObjectManagementStrategy::allocateSampledImage(const VkExtent3D
     {
         &sampledImage,
         VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-        currentDescriptorCount,
+        sampledImageDescriptor.setIndex,
         sampledImageDescriptor.binding,
         sampledImageDescriptor.arrayElement,
         1
     };
     imageDescriptorUpdateCommands.push_back(descriptorUpdateCmd);
-    ++currentDescriptorCount;
 }
 
 void SharedMemoryObjectManagementStrategy::allocateDepthMap(const VkExtent2D& extent, ImageInfo& depthMap)
@@ -245,6 +332,7 @@ void SharedMemoryObjectManagementStrategy::allocateDepthMap(const VkExtent2D& ex
     pickDepthStencilFormat(format, tiling);
     imageHolder.addImages(1);
     imageHolder.initImage(imgIndex, 0, VkImageType::VK_IMAGE_TYPE_2D, format, extent3d, false, mLevels, VkSampleCountFlagBits::VK_SAMPLE_COUNT_1_BIT, tiling, usage);
+    bindImageMemory(imgIndex, tiling);
     imageHolder.addViews(1);
     depthMap.holder = &imageHolder;
     depthMap.imageIndex = imgIndex;
@@ -259,16 +347,7 @@ void SharedMemoryObjectManagementStrategy::allocateDepthMap(const VkExtent2D& ex
         0,
         1
     };
-    ViewCreateCommand viewCmd = 
-    {
-        viewIndex,
-        imgIndex,
-        VkImageViewType::VK_IMAGE_VIEW_TYPE_2D,
-        format,
-        subresource
-    };
-    memoryRequirements[MemoryObjects::MOImage].push_back(imageHolder.getMemoryRequirements(imgIndex));
-    viewCreateCommands.push_back(viewCmd);
+    imageHolder.initView(viewIndex, imgIndex, VkImageViewType::VK_IMAGE_VIEW_TYPE_2D, format, subresource);
 
     InitialImageLayoutUpdateCommand layoutUpdateCmd = 
     {
@@ -283,63 +362,146 @@ void SharedMemoryObjectManagementStrategy::allocateVertexBuffer(const uint32_t s
 {
     buffer.index = Buffers::BVertex;
     buffer.holder = &bufferHolder;
-    buffer.offset = vertexBufferSize;
+    buffer.offset = allocateBufferRange(Buffers::BVertex, size, deviceProperties.limits.minStorageBufferOffsetAlignment);
     buffer.size = size;
-    vertexBufferSize += size;
-    const VkDeviceSize& alignment = deviceProperties.limits.minStorageBufferOffsetAlignment;
-    vertexBufferSize = vertexBufferSize % alignment != 0 ? (vertexBufferSize / alignment + 1) * alignment : vertexBufferSize;
 }
 
 void SharedMemoryObjectManagementStrategy::allocateIndexBuffer(const uint32_t size, BufferInfo& buffer)
 {
     buffer.index = Buffers::BIndex;
     buffer.holder = &bufferHolder;
-    buffer.offset = indexBufferSize;
+    buffer.offset = allocateBufferRange(Buffers::BIndex, size, deviceProperties.limits.minStorageBufferOffsetAlignment);
+    buffer.size = size;
+}
+
+void SharedMemoryObjectManagementStrategy::allocateIndirectBuffer(const uint32_t size, BufferInfo& buffer)
+{
+    buffer.index = Buffers::BIndirect;
+    buffer.holder = &bufferHolder;
+    buffer.offset = allocateBufferRange(Buffers::BIndirect, size, deviceProperties.limits.minStorageBufferOffsetAlignment);
     buffer.size = size;
-    indexBufferSize += size;
-    const VkDeviceSize& alignment = deviceProperties.limits.minStorageBufferOffsetAlignment;
-    indexBufferSize = indexBufferSize % alignment != 0 ? (indexBufferSize / alignment + 1) * alignment : indexBufferSize;
+}
+
+void SharedMemoryObjectManagementStrategy::allocateStorageBuffers(const Array<uint32_t>& sizes, BufferInfo* buffers, DescriptorInfo& storageDescriptor)
+{
+    if(sizes.getSize() != COMPUTE_STORAGE_BINDING_COUNT) reportError("Storage sets need COMPUTE_STORAGE_BINDING_COUNT buffers.\n");
+    storageDescriptor.pool = &descriptorPool;
+    storageDescriptor.setIndex = allocateDescriptorSet(DescriptorLayouts::DLStorageCompute);
+    storageDescriptor.binding = 0;
+    storageDescriptor.arrayElement = 0;
+    storageDescriptor.dynamicOffset = 0;
+
+    for(auto ind = 0; ind < sizes.getSize(); ++ind)
+    {
+        buffers[ind].index = Buffers::BStorage;
+        buffers[ind].holder = &bufferHolder;
+        buffers[ind].offset = allocateBufferRange(Buffers::BStorage, sizes[ind], deviceProperties.limits.minStorageBufferOffsetAlignment);
+        buffers[ind].size = sizes[ind];
+
+        BufferDescriptorUpdateCommand descriptorCommand = 
+        {
+            &buffers[ind],
+            VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            storageDescriptor.setIndex,
+            static_cast<uint32_t>(ind),
+            0
+        };
+        bufferDescriptorUpdateCommands.push_back(descriptorCommand);
+    }
+}
+
+void SharedMemoryObjectManagementStrategy::allocateMeshBuffers(const DrawableType type, const uint32_t vertexStride, const uint32_t vertexBufferSize, const uint32_t indexBufferSize, BufferInfo& vertexBuffer, BufferInfo& indexBuffer)
+{
+    // vertex offsets are whole vertices and index offsets suit both index types, so meshes are addressed by base vertex and first index
+
+    static const uint32_t INDEX_ALIGNMENT = sizeof(uint32_t);
+    vertexBuffer.holder = &bufferHolder;
+    vertexBuffer.index = Buffers::BMeshVertex + type;
+    vertexBuffer.offset = allocateBufferRange(vertexBuffer.index, vertexBufferSize, std::max(vertexStride, 1U));
+    vertexBuffer.size = vertexBufferSize;
+
+    indexBuffer.holder = &bufferHolder;
+    indexBuffer.index = Buffers::BMeshIndex + type;
+    indexBuffer.offset = allocateBufferRange(indexBuffer.index, indexBufferSize, INDEX_ALIGNMENT);
+    indexBuffer.size = indexBufferSize;
 }
 
 void SharedMemoryObjectManagementStrategy::allocateUniformBuffer(const uint32_t size, const VkShaderStageFlags stages, BufferInfo& buffer, DescriptorInfo& uniformDescriptor)
 {
     buffer.holder = &bufferHolder;
     buffer.index = Buffers::BUniform;
-    buffer.offset = uniformBufferSize;
+    buffer.offset = allocateBufferRange(Buffers::BUniform, size, deviceProperties.limits.minUniformBufferOffsetAlignment);
     buffer.size = size;
-    uniformBufferSize += size;
-    const VkDeviceSize& alignment = deviceProperties.limits.minUniformBufferOffsetAlignment;
-    uniformBufferSize = uniformBufferSize % alignment != 0 ? (uniformBufferSize / alignment + 1) * alignment : uniformBufferSize;
 
     // descriptor creation
 
-    Array<VkDescriptorSetLayout> layouts;
+    DescriptorLayouts layout;
     if(stages == VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT)
     {
-        layouts = {descriptorLayoutHolder.getSetLayout(DescriptorLayouts::DLUniformFrag)};
+        layout = DescriptorLayouts::DLUniformFrag;
     }
     else if(stages == VkShaderStageFlagBits::VK_SHADER_STAGE_GEOMETRY_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT)
     {
-        layouts = {descriptorLayoutHolder.getSetLayout(DescriptorLayouts::DLUniformVertTeseGeom)};
+        layout = DescriptorLayouts::DLUniformVertTeseGeom;
     }
     else reportError("Not supported uniform type.\n");
-    descriptorPool.allocateSets(currentDescriptorCount, layouts);
     uniformDescriptor.pool = &descriptorPool;
-    uniformDescriptor.setIndex = currentDescriptorCount;
+    uniformDescriptor.setIndex = allocateDescriptorSet(layout);
     uniformDescriptor.binding = 0;
     uniformDescriptor.arrayElement = 0;
+    uniformDescriptor.dynamicOffset = 0;
 
     // descriptor update command creation
 
     BufferDescriptorUpdateCommand descriptorCommand = 
     {
         &buffer,
-        currentDescriptorCount,
+        VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+        uniformDescriptor.setIndex,
         uniformDescriptor.binding,
         uniformDescriptor.arrayElement
     };
     bufferDescriptorUpdateCommands.push_back(descriptorCommand);
-    ++currentDescriptorCount;
+}
+
+void SharedMemoryObjectManagementStrategy::allocateObjectUniformBuffer(const uint32_t size, BufferInfo& buffer, DescriptorInfo& uniformDescriptor)
+{
+    // objects are laid out at a fixed stride in their own buffer, so the dynamic offset is just the offset in that buffer;
+    // the descriptor set is allocated once and its descriptor is written at load time
+
+    if(objectUniformSet == ~0U)
+    {
+        const VkDeviceSize& alignment = deviceProperties.limits.minUniformBufferOffsetAlignment;
+        objectUniformStride = size % alignment != 0 ? (size / alignment + 1) * alignment : size;
+        objectUniformRange.holder = &bufferHolder;
+        objectUniformRange.index = Buffers::BObjectUniform;
+        objectUniformRange.offset = 0;
+        objectUniformRange.size = size;
+
+        objectUniformSet = allocateDescriptorSet(DescriptorLayouts::DLDynamicUniformVertTeseGeom);
+        BufferDescriptorUpdateCommand descriptorCommand = 
+        {
+            &objectUniformRange,
+            VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            objectUniformSet,
+            0,
+            0
+        };
+        bufferDescriptorUpdateCommands.push_back(descriptorCommand);
+    }
+    else if(size != objectUniformRange.size) reportError("Object uniforms must all have the same size.\n");
+
+    buffer.holder = &bufferHolder;
+    buffer.index = Buffers::BObjectUniform;
+    buffer.offset = objectUniformCount * objectUniformStride;
+    buffer.size = size;
+    ++objectUniformCount;
+
+    uniformDescriptor.pool = &descriptorPool;
+    uniformDescriptor.setIndex = objectUniformSet;
+    uniformDescriptor.binding = 0;
+    uniformDescriptor.arrayElement = 0;
+    uniformDescriptor.dynamicOffset = buffer.offset;
 }
 
 void SharedMemoryObjectManagementStrategy::updateBuffer(const void* src, const BufferInfo& dst)
@@ -352,85 +514,302 @@ void SharedMemoryObjectManagementStrategy::updateImage(const ImageLoader::Image&
     imageUpdateCommands.push_back({&src, &dst});
 }
 
-const VkPipelineLayout& SharedMemoryObjectManagementStrategy::getPipelineLayout(const DrawableType type)
+void SharedMemoryObjectManagementStrategy::bindImageMemory(const uint32_t imageIndex, const VkImageTiling tiling)
 {
-    return descriptorLayoutHolder.getPipelineLayout(type);
+    if(imageMemory.size() <= imageIndex) imageMemory.resize(imageIndex + 1);
+    imageMemory[imageIndex] = memoryPool.allocate(VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageHolder.getMemoryRequirements(imageIndex), tiling == VkImageTiling::VK_IMAGE_TILING_LINEAR);
+    imageHolder.bindMemory(memoryPool.getMemory(imageMemory[imageIndex]), imageMemory[imageIndex].offset, imageIndex);
 }
 
-void SharedMemoryObjectManagementStrategy::load()
+void SharedMemoryObjectManagementStrategy::initDeviceBuffer(const uint32_t buffer, const uint32_t size, const VkBufferUsageFlags usage)
 {
-    // creating and binding image memory; creating image views; initializing image descriptors
+    // the contents are copied out when the buffer grows
 
-    uint32_t imageAlignment = 1;
-    std::vector<uint32_t> imageOffsets(memoryRequirements[MemoryObjects::MOImage].size());
-    auto index = 0;
-    uint32_t currSize = 0;
-    uint32_t memoryTypeBits = ~0U;
-    for(const auto& req : memoryRequirements[MemoryObjects::MOImage])
+    bufferUsages[buffer] = usage | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    if(!size) return;
+    bufferHolder.initBuffer(buffer, size, bufferUsages[buffer]);
+    bufferMemory[buffer] = memoryPool.allocate(VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bufferHolder.getMemoryRequirements(buffer), true);
+    bufferHolder.bindMemory(memoryPool.getMemory(bufferMemory[buffer]), bufferMemory[buffer].offset, buffer);
+}
+
+void SharedMemoryObjectManagementStrategy::growBuffer(const uint32_t buffer, const uint32_t minimumSize)
+{
+    // draws look the buffer up by index when they bind it, so only descriptors need to learn about the new one;
+    // work already recorded keeps using the old buffer until it is released
+
+    const uint32_t oldSize = bufferSizes[buffer];
+    const VkBuffer oldBuffer = oldSize ? bufferHolder[buffer] : VkBuffer();
+    const MemoryAllocation oldMemory = bufferMemory[buffer];
+    bufferSizes[buffer] = std::max(minimumSize, oldSize * 2);
+    initDeviceBuffer(buffer, bufferSizes[buffer], bufferUsages[buffer]);
+    if(oldBuffer)
     {
-        imageAlignment = MemoryPool::align((const uint32_t)imageAlignment, req.alignment);
-        memoryTypeBits &= req.memoryTypeBits;
+        beginTransferBatch();
+        VkBufferCopy copyArea = 
+        {
+            0,
+            0,
+            oldSize
+        };
+        vkCmdCopyBuffer(getCurrentUpdateCommandBuffer(), oldBuffer, bufferHolder[buffer], 1, &copyArea);
+        submitTransferBatch();
+        bufferReleases.push_back({getReleaseBatch(), oldBuffer, oldMemory});
     }
-    for(auto& req : memoryRequirements[MemoryObjects::MOImage])
-    {   
-        req.alignment = imageAlignment;
-        imageOffsets[index] = currSize;
-        if(req.size % req.alignment != 0)
+    releaseBufferRange(buffer, oldSize, bufferSizes[buffer] - oldSize);
+
+    // the descriptors are written again by the next update()
+
+    for(auto descriptor = writtenBufferDescriptors.begin(); descriptor != writtenBufferDescriptors.end();)
+    {
+        if(descriptor->buffer->index != buffer)
         {
-            currSize += (req.size / imageAlignment + 1) * imageAlignment;
+            ++descriptor;
+            continue;
         }
-        else currSize += req.size;
-        ++index;
+        bufferDescriptorUpdateCommands.push_back(*descriptor);
+        descriptor = writtenBufferDescriptors.erase(descriptor);
+    }
+}
+
+const uint32_t SharedMemoryObjectManagementStrategy::allocateDescriptorSet(const DescriptorLayouts layout)
+{
+    uint32_t set = currentDescriptorCount;
+    if(!freeDescriptorSets.empty())
+    {
+        set = freeDescriptorSets.back();
+        freeDescriptorSets.pop_back();
+    }
+    else ++currentDescriptorCount;
+    Array<VkDescriptorSetLayout> layouts = {descriptorLayoutHolder.getSetLayout(layout)};
+    descriptorPool.allocateSets(set, layouts);
+    return set;
+}
+
+void SharedMemoryObjectManagementStrategy::freeDescriptorSet(const uint32_t set)
+{
+    // writes still queued for the set would land in whatever set gets its index next
+
+    imageDescriptorUpdateCommands.erase(std::remove_if(imageDescriptorUpdateCommands.begin(), imageDescriptorUpdateCommands.end(), 
+        [set](const ImageDescriptorUpdateCommand& cmd){ return cmd.set == set; }), imageDescriptorUpdateCommands.end());
+    bufferDescriptorUpdateCommands.erase(std::remove_if(bufferDescriptorUpdateCommands.begin(), bufferDescriptorUpdateCommands.end(), 
+        [set](const BufferDescriptorUpdateCommand& cmd){ return cmd.set == set; }), bufferDescriptorUpdateCommands.end());
+    writtenBufferDescriptors.erase(std::remove_if(writtenBufferDescriptors.begin(), writtenBufferDescriptors.end(), 
+        [set](const BufferDescriptorUpdateCommand& cmd){ return cmd.set == set; }), writtenBufferDescriptors.end());
+    descriptorSetReleases.push_back({getReleaseBatch(), set});
+}
+
+const VkDeviceSize SharedMemoryObjectManagementStrategy::allocateBufferRange(const uint32_t buffer, const VkDeviceSize size, const VkDeviceSize alignment)
+{
+    // best fit among the freed ranges, the same way the memory pool fills its blocks
+
+    auto& ranges = freeBufferRanges[buffer];
+    auto best = ranges.end();
+    for(auto range = ranges.begin(); range != ranges.end(); ++range)
+    {
+        const VkDeviceSize alignedOffset = range->first % alignment != 0 ? (range->first / alignment + 1) * alignment : range->first;
+        if(alignedOffset + size > range->first + range->second) continue;
+        if(best == ranges.end() || range->second < best->second) best = range;
+    }
+    if(best != ranges.end())
+    {
+        const VkDeviceSize rangeOffset = best->first, rangeEnd = best->first + best->second;
+        const VkDeviceSize offset = rangeOffset % alignment != 0 ? (rangeOffset / alignment + 1) * alignment : rangeOffset;
+        ranges.erase(best);
+        if(offset > rangeOffset) ranges[rangeOffset] = offset - rangeOffset;
+        if(offset + size < rangeEnd) ranges[offset + size] = rangeEnd - offset - size;
+        return offset;
     }
-    if(memoryTypeBits == 0) reportError("Couldn't allocate all images in single memory object.\n");
-    //const Array<VkMemoryRequirements> imageGroup(memoryRequirements[MemoryObjects::MOImage]);
-    VkMemoryRequirements imageMemoryObjectRequirements;
-    imageMemoryObjectRequirements.alignment = imageAlignment;
-    imageMemoryObjectRequirements.memoryTypeBits = memoryTypeBits;
-    imageMemoryObjectRequirements.size = currSize;
-    memoryPool.allocate(MemoryObjects::MOImage, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageMemoryObjectRequirements);
-    for(auto ind = 0; ind < imageHolder.getCurrentImageCount(); ++ind)
+
+    // before load() buffers only count the space they need, afterwards they grow and the new tail is free
+
+    uint32_t& bufferSize = bufferSizes[buffer];
+    if(loaded)
     {
-        imageHolder.bindMemory(memoryPool[MemoryObjects::MOImage], imageOffsets[ind], ind);
+        const VkDeviceSize tailOffset = bufferSize % alignment != 0 ? (bufferSize / alignment + 1) * alignment : bufferSize;
+        growBuffer(buffer, tailOffset + size);
+        return allocateBufferRange(buffer, size, alignment);
     }
-    for(const auto& viewCreateCommand : viewCreateCommands)
+    const VkDeviceSize offset = bufferSize % alignment != 0 ? (bufferSize / alignment + 1) * alignment : bufferSize;
+    bufferSize = offset + size;
+    return offset;
+}
+
+const bool SharedMemoryObjectManagementStrategy::freeBufferRange(const BufferInfo& buffer)
+{
+    if(!buffer.size) return false;
+    bufferUpdateCommands.erase(std::remove_if(bufferUpdateCommands.begin(), bufferUpdateCommands.end(), 
+        [&buffer](const BufferUpdateCommand& cmd){ return cmd.dst == &buffer; }), bufferUpdateCommands.end());
+
+    // a range overlapping a free or a released one was already freed
+
+    const auto& ranges = freeBufferRanges[buffer.index];
+    auto next = ranges.lower_bound(buffer.offset);
+    if(next != ranges.end() && next->first < buffer.offset + buffer.size) return false;
+    if(next != ranges.begin() && std::prev(next)->first + std::prev(next)->second > buffer.offset) return false;
+    for(const auto& release : bufferRangeReleases)
     {
-        imageHolder.initView(viewCreateCommand.index, viewCreateCommand.imageIndex, viewCreateCommand.type, viewCreateCommand.format, viewCreateCommand.subresource);
+        if(release.buffer == buffer.index && release.offset < buffer.offset + buffer.size && buffer.offset < release.offset + release.size) return false;
     }
+    bufferRangeReleases.push_back({getReleaseBatch(), buffer.index, buffer.offset, buffer.size});
+    return true;
+}
+
+void SharedMemoryObjectManagementStrategy::releaseBufferRange(const uint32_t buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    if(!size) return;
 
-    const auto& updateCmd = (*commandPool)[updateCommandBuffer];
-    for(auto& cmd : layoutUpdateCommands)
+    // merging with the neighbouring free ranges
+
+    auto& ranges = freeBufferRanges[buffer];
+    auto next = ranges.lower_bound(offset);
+
+    if(next != ranges.end() && offset + size == next->first)
     {
-        syncPool->waitForFences(updateFence);
-        syncPool->resetFences(updateFence);
-        VkCommandBufferBeginInfo beginInfo = 
+        size += next->second;
+        next = ranges.erase(next);
+    }
+    if(next != ranges.begin())
+    {
+        auto prev = std::prev(next);
+        if(prev->first + prev->second == offset)
         {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            nullptr,
-            VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            nullptr
-        };
-        if(!firstCommandBufferRun) commandPool->reset(updateCommandBuffer, true);
-        checkResult(vkBeginCommandBuffer(updateCmd, &beginInfo), "Failed to begin command buffer");
-        ImageHolder::recordLayoutChangeCommands(updateCmd, cmd.image->layout, cmd.newLayout, cmd.image->holder->getImage(cmd.image->imageIndex), cmd.subresource);
-        vkEndCommandBuffer(updateCmd);
+            offset = prev->first;
+            size += prev->second;
+            ranges.erase(prev);
+        }
+    }
+    ranges[offset] = size;
+}
 
-        VkPipelineStageFlags stages = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;
-        VkSubmitInfo submitInfo = 
+const uint32_t SharedMemoryObjectManagementStrategy::getReleaseBatch() const
+{
+    // the next batch goes before the frame being recorded, the one after it follows that frame
+
+    return submittedBatchCount + 2;
+}
+
+const bool SharedMemoryObjectManagementStrategy::hasPendingReleases() const
+{
+    return !imageReleases.empty() || !descriptorSetReleases.empty() || !bufferRangeReleases.empty() || !bufferReleases.empty();
+}
+
+void SharedMemoryObjectManagementStrategy::releaseCompletedResources(const uint32_t completedBatch)
+{
+    // batches complete in submission order
+
+    for(auto release = imageReleases.begin(); release != imageReleases.end();)
+    {
+        if(release->batch > completedBatch)
         {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            nullptr,
-            firstCommandBufferRun ? 0U : 1U,
-            firstCommandBufferRun ? nullptr : &syncPool->getSemaphore(updateSemaphore),
-            firstCommandBufferRun ? nullptr : &stages,
-            1,
-            &updateCmd,
-            1,
-            &syncPool->getSemaphore(updateSemaphore)
-        };
-        if(firstCommandBufferRun) firstCommandBufferRun = false;
-        checkResult(vkQueueSubmit(system->getGraphicsQueue().queue, 1, &submitInfo, syncPool->getFence(updateFence)), "Failed to submit queue.\n");
-        cmd.image->layout = cmd.newLayout;
+            ++release;
+            continue;
+        }
+        imageHolder.destroySampler(release->samplerIndex);
+        imageHolder.destroyView(release->viewIndex);
+        imageHolder.destroyImage(release->imageIndex);
+        memoryPool.free(release->memory);
+        release = imageReleases.erase(release);
+    }
+    for(auto release = descriptorSetReleases.begin(); release != descriptorSetReleases.end();)
+    {
+        if(release->batch > completedBatch)
+        {
+            ++release;
+            continue;
+        }
+        descriptorPool.freeSets(release->set);
+        freeDescriptorSets.push_back(release->set);
+        release = descriptorSetReleases.erase(release);
+    }
+    for(auto release = bufferRangeReleases.begin(); release != bufferRangeReleases.end();)
+    {
+        if(release->batch > completedBatch)
+        {
+            ++release;
+            continue;
+        }
+        releaseBufferRange(release->buffer, release->offset, release->size);
+        release = bufferRangeReleases.erase(release);
+    }
+    for(auto release = bufferReleases.begin(); release != bufferReleases.end();)
+    {
+        if(release->batch > completedBatch)
+        {
+            ++release;
+            continue;
+        }
+        vkDestroyBuffer(system->getDevice(), release->buffer, nullptr);
+        memoryPool.free(release->memory);
+        release = bufferReleases.erase(release);
+    }
+}
+
+void SharedMemoryObjectManagementStrategy::freeSampledImage(const SampledImageInfo& sampledImage, const DescriptorInfo& sampledImageDescriptor)
+{
+    const uint32_t index = sampledImage.image.imageIndex;
+    if(sampledImage.image.holder != &imageHolder || index >= imageMemory.size() || imageMemory[index].size == 0) return;
+    layoutUpdateCommands.erase(std::remove_if(layoutUpdateCommands.begin(), layoutUpdateCommands.end(), 
+        [&sampledImage](const InitialImageLayoutUpdateCommand& cmd){ return cmd.image == &sampledImage.image; }), layoutUpdateCommands.end());
+    imageUpdateCommands.erase(std::remove_if(imageUpdateCommands.begin(), imageUpdateCommands.end(), 
+        [&sampledImage](const ImageUpdateCommand& cmd){ return cmd.dst == &sampledImage.image; }), imageUpdateCommands.end());
+    imageReleases.push_back({getReleaseBatch(), index, sampledImage.image.viewIndex, sampledImage.samplerIndex, imageMemory[index]});
+    --imageStatistics.imageCount;
+    imageStatistics.memoryBytes -= imageMemory[index].size;
+    imageMemory[index] = {};
+    freeDescriptorSet(sampledImageDescriptor.setIndex);
+}
+
+void SharedMemoryObjectManagementStrategy::freeBuffer(const BufferInfo& buffer)
+{
+    if(buffer.holder != &bufferHolder) return;
+    if(buffer.index != Buffers::BVertex && buffer.index != Buffers::BIndex && buffer.index != Buffers::BIndirect && (buffer.index < Buffers::BMeshVertex || buffer.index >= Buffers::BCount))
+    {
+        reportError("Only vertex, index, mesh and indirect ranges can be freed this way.\n");
+    }
+    freeBufferRange(buffer);
+}
+
+void SharedMemoryObjectManagementStrategy::freeUniformBuffer(const BufferInfo& buffer, const DescriptorInfo& uniformDescriptor)
+{
+    if(buffer.holder != &bufferHolder) return;
+    if(buffer.index != Buffers::BUniform) reportError("Not a uniform buffer.\n");
+    if(!freeBufferRange(buffer)) return;
+    freeDescriptorSet(uniformDescriptor.setIndex);
+}
+
+const std::vector<MemoryPool::Statistics> SharedMemoryObjectManagementStrategy::getMemoryStatistics() const
+{
+    return memoryPool.getStatistics();
+}
+
+const ObjectManagementStrategy::ImageStatistics SharedMemoryObjectManagementStrategy::getImageStatistics() const
+{
+    return imageStatistics;
+}
+
+const VkPipelineLayout& SharedMemoryObjectManagementStrategy::getPipelineLayout(const DrawableType type)
+{
+    return descriptorLayoutHolder.getPipelineLayout(type);
+}
+
+const VkPipelineLayout& SharedMemoryObjectManagementStrategy::getComputePipelineLayout()
+{
+    return descriptorLayoutHolder.getPipelineLayout(DrawableType::DTCount);
+}
+
+void SharedMemoryObjectManagementStrategy::commitPendingCommands()
+{
+    // initializing image layouts and descriptors
+
+    if(!layoutUpdateCommands.empty())
+    {
+        beginTransferBatch();
+        for(auto& cmd : layoutUpdateCommands)
+        {
+            ImageHolder::recordLayoutChangeCommands(getCurrentUpdateCommandBuffer(), cmd.image->layout, cmd.newLayout, cmd.image->holder->getImage(cmd.image->imageIndex), cmd.subresource);
+            cmd.image->layout = cmd.newLayout;
+        }
+        submitTransferBatch();
     }
 
     for(const auto& cmd : imageDescriptorUpdateCommands)
@@ -443,34 +822,6 @@ void SharedMemoryObjectManagementStrategy::load()
         };
         descriptorPool.updateImage(info, VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, cmd.set, cmd.binding, cmd.arrayElement, cmd.descriptorCount);
     }
-    
-    // creating buffers and binding memory
-
-    bufferHolder.initBuffer(Buffers::BVertex, vertexBufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT /* DEBUG ALERT */ | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-    bufferHolder.initBuffer(Buffers::BIndex, indexBufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT /* DEBUG ALERT */ | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-    bufferHolder.initBuffer(Buffers::BUniform, uniformBufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT /* DEBUG ALERT */ | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-    uint32_t bufferAlignment = 1;
-    Array<uint32_t> bufferOffsets(3);
-    currSize = 0;
-    Array<VkMemoryRequirements> bufferMemoryRequirements({bufferHolder.getMemoryRequirements(Buffers::BVertex), bufferHolder.getMemoryRequirements(Buffers::BIndex), bufferHolder.getMemoryRequirements(Buffers::BUniform)});
-    for(auto ind = 0; ind < bufferMemoryRequirements.getSize(); ++ind)
-    {
-        bufferAlignment = MemoryPool::align(bufferMemoryRequirements[ind].alignment, (const uint32_t)bufferAlignment);
-    }
-    for(auto ind = 0; ind < bufferMemoryRequirements.getSize(); ++ind)
-    {
-        bufferMemoryRequirements[ind].alignment = bufferAlignment;
-        bufferOffsets[ind] = currSize;
-        if(bufferMemoryRequirements[ind].size % bufferAlignment != 0)
-        {
-            currSize += (bufferMemoryRequirements[ind].size / bufferAlignment + 1)  * bufferAlignment;
-        }
-        else currSize += bufferMemoryRequirements[ind].size;
-    }
-    memoryPool.allocate(MemoryObjects::MOBuffer, VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bufferMemoryRequirements);
-    bufferHolder.bindMemory(memoryPool[MemoryObjects::MOBuffer], bufferOffsets[0], Buffers::BVertex);
-    bufferHolder.bindMemory(memoryPool[MemoryObjects::MOBuffer], bufferOffsets[1], Buffers::BIndex);
-    bufferHolder.bindMemory(memoryPool[MemoryObjects::MOBuffer], bufferOffsets[2], Buffers::BUniform);
 
     // binding descriptors to buffers
     
@@ -482,152 +833,307 @@ void SharedMemoryObjectManagementStrategy::load()
             command.buffer->offset,
             command.buffer->size
         };
-        descriptorPool.updateBuffer(bufferInfo, VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, command.set, command.binding, command.arrayElement);
+        descriptorPool.updateBuffer(bufferInfo, command.type, command.set, command.binding, command.arrayElement);
     }
+    writtenBufferDescriptors.insert(writtenBufferDescriptors.end(), bufferDescriptorUpdateCommands.begin(), bufferDescriptorUpdateCommands.end());
 
     // cleaning up
 
-    for(auto ind = 0; ind < MemoryObjects::MOCount; ++ind)
-    {
-        memoryRequirements[ind].clear();
-    }
     bufferDescriptorUpdateCommands.clear();
     layoutUpdateCommands.clear();
     imageDescriptorUpdateCommands.clear();
 }
 
-void SharedMemoryObjectManagementStrategy::update()
+void SharedMemoryObjectManagementStrategy::load()
 {
-    const auto& commands = (*commandPool)[updateCommandBuffer];
+    // creating buffers and binding memory
 
-    for(auto& cmd : bufferUpdateCommands)
+    const VkBufferUsageFlags vertexUsage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_VERTEX_BUFFER_BIT /* DEBUG ALERT */ | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    const VkBufferUsageFlags indexUsage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDEX_BUFFER_BIT /* DEBUG ALERT */ | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    initDeviceBuffer(Buffers::BVertex, bufferSizes[Buffers::BVertex], vertexUsage);
+    initDeviceBuffer(Buffers::BIndex, bufferSizes[Buffers::BIndex], indexUsage);
+    initDeviceBuffer(Buffers::BUniform, bufferSizes[Buffers::BUniform], VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT /* DEBUG ALERT */ | VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    const uint32_t objectUniformBufferSize = std::max(objectUniformCount * objectUniformStride, (uint32_t)deviceProperties.limits.minUniformBufferOffsetAlignment);
+    initDeviceBuffer(Buffers::BObjectUniform, objectUniformBufferSize, VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    initDeviceBuffer(Buffers::BIndirect, bufferSizes[Buffers::BIndirect], VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    initDeviceBuffer(Buffers::BStorage, bufferSizes[Buffers::BStorage], VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_DST_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VkBufferUsageFlagBits::VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    for(auto type = 0; type < DrawableType::DTCount; ++type)
     {
-        syncPool->waitForFences(updateFence);
-        syncPool->resetFences(updateFence);
-        memcpy(mappedTransferMemory, cmd.src, cmd.dst->size);
-        memoryPool.flush(MemoryObjects::MOTransfer, 0, VK_WHOLE_SIZE);
+        initDeviceBuffer(Buffers::BMeshVertex + type, bufferSizes[Buffers::BMeshVertex + type], vertexUsage);
+        initDeviceBuffer(Buffers::BMeshIndex + type, bufferSizes[Buffers::BMeshIndex + type], indexUsage);
+    }
+    commitPendingCommands();
+    loaded = true;
+}
+
+const VkCommandBuffer& SharedMemoryObjectManagementStrategy::getCurrentUpdateCommandBuffer() const
+{
+    return (*commandPool)[firstUpdateCommandBuffer + currentUpdateSlot];
+}
+
+const VkCommandBuffer& SharedMemoryObjectManagementStrategy::getCurrentTransferCommandBuffer() const
+{
+    if(system->hasDedicatedTransferQueue()) return transferCommandPool[currentUpdateSlot];
+    return getCurrentUpdateCommandBuffer();
+}
+
+void SharedMemoryObjectManagementStrategy::beginTransferBatch()
+{
+    // the slot was last submitted STAGING_FRAME_COUNT batches ago, so this wait rarely blocks
+
+    const uint32_t fence = firstUpdateFence + currentUpdateSlot;
+    syncPool->waitForFences(fence);
+    stagingRing.reclaim();
+    releaseCompletedResources(slotBatches[currentUpdateSlot]);
+    syncPool->resetFences(fence);
+    VkCommandBufferBeginInfo beginInfo = 
+    {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        nullptr,
+        VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        nullptr
+    };
+    commandPool->reset(firstUpdateCommandBuffer + currentUpdateSlot, true);
+    checkResult(vkBeginCommandBuffer(getCurrentUpdateCommandBuffer(), &beginInfo), "Failed to begin command buffer");
+    if(system->hasDedicatedTransferQueue())
+    {
+        transferCommandPool.reset(currentUpdateSlot, true);
+        checkResult(vkBeginCommandBuffer(getCurrentTransferCommandBuffer(), &beginInfo), "Failed to begin command buffer");
+    }
+}
+
+const VkDeviceSize SharedMemoryObjectManagementStrategy::reserveTransferRange(const VkDeviceSize size)
+{
+    VkDeviceSize offset;
+    while(!stagingRing.allocate(size, offset))
+    {
+        submitTransferBatch();
+        beginTransferBatch();
+    }
+    return offset;
+}
 
-        VkCommandBufferBeginInfo beginInfo = 
+void SharedMemoryObjectManagementStrategy::submitTransferBatch()
+{
+    const auto& commands = getCurrentUpdateCommandBuffer();
+    const uint32_t fence = firstUpdateFence + currentUpdateSlot;
+    vkEndCommandBuffer(commands);
+    stagingRing.flushPending();
+
+    // with a dedicated transfer queue the copies go first and the graphics part (acquires, mipmaps) waits for them;
+    // only the graphics submission is fenced, it can't complete before the copies it waits for
+    // (and so the slot's semaphores are unsignaled again once its fence is)
+
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStages[2];
+    uint32_t waitCount = 0;
+    if(!firstCommandBufferRun)
+    {
+        waitSemaphores[waitCount] = syncPool->getSemaphore(updateSemaphore);
+        waitStages[waitCount] = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;
+        ++waitCount;
+    }
+    if(system->hasDedicatedTransferQueue())
+    {
+        const auto& transferCommands = getCurrentTransferCommandBuffer();
+        const VkSemaphore& transferSemaphore = syncPool->getSemaphore(firstTransferSemaphore + currentUpdateSlot);
+        const VkSemaphore& graphicsDoneSemaphore = syncPool->getSemaphore(firstGraphicsDoneSemaphore + currentUpdateSlot);
+        vkEndCommandBuffer(transferCommands);
+
+        // the copies overwrite ranges and images graphics owns and may still read in earlier frames or batches;
+        // the signal of an empty graphics submission covers everything submitted to that queue before it
+
+        VkSubmitInfo graphicsDoneSubmitInfo = 
         {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            nullptr,
+            0,
+            nullptr,
             nullptr,
-            VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            nullptr
-        };
-        VkBufferCopy copyArea = 
-        {
             0,
-            cmd.dst->offset,
-            cmd.dst->size
+            nullptr,
+            1,
+            &graphicsDoneSemaphore
         };
-        if(!firstCommandBufferRun) commandPool->reset(updateCommandBuffer, true);
-        checkResult(vkBeginCommandBuffer(commands, &beginInfo), "Failed to begin command buffer");
-        vkCmdCopyBuffer(commands, bufferHolder[Buffers::BTransfer], (*cmd.dst->holder)[cmd.dst->index], 1, &copyArea);
-        vkEndCommandBuffer(commands);
-
-        VkPipelineStageFlags stages = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;        
-        VkSubmitInfo submitInfo = 
+        checkResult(vkQueueSubmit(system->getGraphicsQueue().queue, 1, &graphicsDoneSubmitInfo, 0), "Failed to submit queue.\n");
+        const VkPipelineStageFlags transferWaitStage = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo transferSubmitInfo = 
         {
             VK_STRUCTURE_TYPE_SUBMIT_INFO,
             nullptr,
-            firstCommandBufferRun ? 0U : 1U,
-            firstCommandBufferRun ? nullptr : &syncPool->getSemaphore(updateSemaphore),
-            firstCommandBufferRun ? nullptr : &stages,
             1,
-            &commands,
+            &graphicsDoneSemaphore,
+            &transferWaitStage,
+            1,
+            &transferCommands,
             1,
-            &syncPool->getSemaphore(updateSemaphore)
+            &transferSemaphore
         };
-        if(firstCommandBufferRun) firstCommandBufferRun = false;
+        checkResult(vkQueueSubmit(system->getTransferQueue().queue, 1, &transferSubmitInfo, 0), "Failed to submit queue.\n");
+        waitSemaphores[waitCount] = transferSemaphore;
+        waitStages[waitCount] = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        ++waitCount;
+    }
+
+    VkSubmitInfo submitInfo = 
+    {
+        VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        nullptr,
+        waitCount,
+        waitCount ? waitSemaphores : nullptr,
+        waitCount ? waitStages : nullptr,
+        1,
+        &commands,
+        1,
+        &syncPool->getSemaphore(updateSemaphore)
+    };
+    if(firstCommandBufferRun) firstCommandBufferRun = false;
+
+    checkResult(vkQueueSubmit(system->getGraphicsQueue().queue, 1, &submitInfo, syncPool->getFence(fence)), "Failed to submit queue.\n");
+    stagingRing.submit(fence);
+    slotBatches[currentUpdateSlot] = ++submittedBatchCount;
+    currentUpdateSlot = (currentUpdateSlot + 1) % STAGING_FRAME_COUNT;
+}
 
-        checkResult(vkQueueSubmit(system->getGraphicsQueue().queue, 1, &submitInfo, syncPool->getFence(updateFence)), "Failed to submit queue.\n");
+void SharedMemoryObjectManagementStrategy::update()
+{
+    // resources allocated after load() get their layouts and descriptors before their first upload;
+    // while freed resources wait for release, empty batches are still submitted so that theirs comes
+
+    if(loaded) commitPendingCommands();
+    if(bufferUpdateCommands.empty() && imageUpdateCommands.empty() && !hasPendingReleases()) return;
+
+    // all pending updates are packed into the transfer buffer and recorded into a single command buffer;
+    // a new batch is only submitted early when the staging ring runs out of free space
+
+    std::unordered_set<const void*> updatedDestinations;
+    beginTransferBatch();
+
+    // copies into the same destination within one batch would race, so only the latest one is kept
+
+    for(auto cmd = bufferUpdateCommands.rbegin(); cmd != bufferUpdateCommands.rend(); ++cmd)
+    {
+        if(!updatedDestinations.insert(cmd->dst).second) continue;
+        const VkDeviceSize offset = reserveTransferRange(cmd->dst->size);
+        memcpy(stagingRing.getPtr(offset), cmd->src, cmd->dst->size);
+
+        VkBufferCopy copyArea = 
+        {
+            offset,
+            cmd->dst->offset,
+            cmd->dst->size
+        };
+        const VkBuffer& currentBuffer = (*cmd->dst->holder)[cmd->dst->index];
+        vkCmdCopyBuffer(getCurrentTransferCommandBuffer(), bufferHolder[Buffers::BTransfer], currentBuffer, 1, &copyArea);
+        if(system->hasDedicatedTransferQueue())
+        {
+            const uint32_t transferFamily = system->getTransferQueue().familyIndex, graphicsFamily = system->getGraphicsQueue().familyIndex;
+            BufferHolder::recordOwnershipTransferCommands(getCurrentTransferCommandBuffer(), currentBuffer, cmd->dst->offset, cmd->dst->size, transferFamily, graphicsFamily, 
+                VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT, 
+                VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                true);
+            BufferHolder::recordOwnershipTransferCommands(getCurrentUpdateCommandBuffer(), currentBuffer, cmd->dst->offset, cmd->dst->size, transferFamily, graphicsFamily, 
+                VkAccessFlagBits::VK_ACCESS_MEMORY_READ_BIT, 
+                VkPipelineStageFlagBits::VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 
+                false);
+        }
     }
     bufferUpdateCommands.clear();
     
-    for(auto& cmd : imageUpdateCommands)
+    for(auto cmd = imageUpdateCommands.rbegin(); cmd != imageUpdateCommands.rend(); ++cmd)
     {
-        syncPool->waitForFences(updateFence);
-        syncPool->resetFences(updateFence);
-        auto extent = cmd.src->getExtent();
-        auto size = extent.width * extent.height * cmd.src->getChannelCount();
-        memcpy(mappedTransferMemory, cmd.src->getData(), size);
-        memoryPool.flush(MemoryObjects::MOTransfer, 0, size);
+        if(!updatedDestinations.insert(cmd->dst).second) continue;
+        auto extent = cmd->src->getExtent();
+        const VkDeviceSize size = cmd->src->getSize();
+        const VkDeviceSize offset = reserveTransferRange(size);
+        memcpy(stagingRing.getPtr(offset), cmd->src->getData(), size);
+        imageStatistics.uploadedBytes += size;
 
-        VkCommandBufferBeginInfo beginInfo = 
-        {
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            nullptr,
-            VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            nullptr
-        };
-        VkImageSubresourceLayers subresourceLayers = 
+        // images built on the CPU come with their whole mipmap chain, copied with one region per level;
+        // plain decoded ones only fill the first level and get the rest blitted from it
+
+        const bool uploadedMipmaps = cmd->src->getFormat() != VkFormat::VK_FORMAT_UNDEFINED;
+        const uint32_t levelCount = uploadedMipmaps ? std::min(cmd->src->getLevelCount(), cmd->dst->mipmapLevelCount) : 1;
+        std::vector<VkBufferImageCopy> areas(levelCount);
+        for(uint32_t level = 0; level < levelCount; ++level)
         {
-            VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT,
-            0,
-            0,
-            1
-        };
+            const VkExtent2D levelExtent = TextureCompressor::getMipmapExtent(extent, level);
+            VkImageSubresourceLayers subresourceLayers = 
+            {
+                VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT,
+                level,
+                0,
+                1
+            };
+            areas[level] = 
+            {
+                offset + cmd->src->getLevelOffset(level),
+                0,
+                0,
+                subresourceLayers,
+                {0, 0, 0},
+                {levelExtent.width, levelExtent.height, 1}
+            };
+        }
         VkImageSubresourceRange subresourceRange = 
         {
             VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT,
             0,
-            1,
+            levelCount,
             0,
             1
         };
-        VkBufferImageCopy area = 
-        {
-            0,
-            0,
-            0,
-            subresourceLayers,
-            {0, 0, 0},
-            {extent.width, extent.height, 1}
-        };
 
-        const VkImage& currentImage = cmd.dst->holder->getImage(cmd.dst->imageIndex);
+        const VkImage& currentImage = cmd->dst->holder->getImage(cmd->dst->imageIndex);
+
+        const auto& commands = getCurrentUpdateCommandBuffer();
+        if(system->hasDedicatedTransferQueue())
+        {
+            // the old contents of the uploaded levels are discarded, so the transfer queue takes them from undefined layout without an acquire;
+            // submitTransferBatch() makes the copies wait for the frames sampling the image
 
-        if(!firstCommandBufferRun)  commandPool->reset(updateCommandBuffer, true);
-        checkResult(vkBeginCommandBuffer(commands, &beginInfo), "Failed to begin command buffer");
-        ImageHolder::recordLayoutChangeCommands(commands, cmd.dst->layout, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, currentImage, subresourceRange);
-        vkCmdCopyBufferToImage(commands, bufferHolder[Buffers::BTransfer], currentImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &area);
+            const auto& transferCommands = getCurrentTransferCommandBuffer();
+            const uint32_t transferFamily = system->getTransferQueue().familyIndex, graphicsFamily = system->getGraphicsQueue().familyIndex;
+            ImageHolder::recordLayoutChangeCommands(transferCommands, VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, currentImage, subresourceRange);
+            vkCmdCopyBufferToImage(transferCommands, bufferHolder[Buffers::BTransfer], currentImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, areas.size(), areas.data());
+            ImageHolder::recordOwnershipTransferCommands(transferCommands, currentImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, transferFamily, graphicsFamily, 
+                VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT, 
+                VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT, 
+                true);
+            ImageHolder::recordOwnershipTransferCommands(commands, currentImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange, transferFamily, graphicsFamily, 
+                VkAccessFlagBits::VK_ACCESS_TRANSFER_READ_BIT | VkAccessFlagBits::VK_ACCESS_SHADER_READ_BIT, 
+                VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT | VkPipelineStageFlagBits::VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
+                false);
+        }
+        else
+        {
+            ImageHolder::recordLayoutChangeCommands(commands, cmd->dst->layout, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, currentImage, subresourceRange);
+            vkCmdCopyBufferToImage(commands, bufferHolder[Buffers::BTransfer], currentImage, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, areas.size(), areas.data());
+        }
+        if(uploadedMipmaps)
+        {
+            ImageHolder::recordLayoutChangeCommands(commands, VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, currentImage, subresourceRange);
+            continue;
+        }
         ImageHolder::recordMipmapGenCommands(commands, 
             VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             VkImageLayout::VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             currentImage,
             extent,
-            cmd.dst->mipmapLevelCount,
-            cmd.dst->layout);
-        vkEndCommandBuffer(commands);
-
-        VkPipelineStageFlags stages = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT;        
-        VkSubmitInfo submitInfo = 
-        {
-            VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            nullptr,
-            firstCommandBufferRun ? 0U : 1U,
-            firstCommandBufferRun ? nullptr : &syncPool->getSemaphore(updateSemaphore),
-            firstCommandBufferRun ? nullptr : &stages,
-            1,
-            &commands,
-            1,
-            &syncPool->getSemaphore(updateSemaphore)
-        };
-        if(firstCommandBufferRun) firstCommandBufferRun = false;
-
-        checkResult(vkQueueSubmit(system->getGraphicsQueue().queue, 1, &submitInfo, syncPool->getFence(updateFence)), "Failed to submit queue.\n");
+            cmd->dst->mipmapLevelCount,
+            cmd->dst->layout);
     }
     imageUpdateCommands.clear();
+
+    submitTransferBatch();
 }
 
 void SharedMemoryObjectManagementStrategy::destroy()
 {
     vkDeviceWaitIdle(system->getDevice());
-    if(mappedTransferMemory != nullptr)
-    {
-        memoryPool.unmap(MemoryObjects::MOTransfer);
-        mappedTransferMemory = nullptr;
-    }
+    releaseCompletedResources(~0U);
+    stagingRing.destroy();
+    transferCommandPool.destroy();
     descriptorPool.destroy();
     descriptorLayoutHolder.destroy();
     bufferHolder.destroy();
@@ -0,0 +1,70 @@
+#include<RenderQueue.hpp>
+#include<utility>
+
+RenderQueue::RenderQueue(){}
+
+void RenderQueue::push(const uint64_t key, const uint32_t value)
+{
+    keys.push_back(key);
+    values.push_back(value);
+}
+
+void RenderQueue::sort()
+{
+    static const uint32_t DIGIT_BITS = 8;
+    static const uint32_t BUCKET_COUNT = 1 << DIGIT_BITS;
+    const uint32_t count = keys.size();
+    if(count < 2) return;
+    tempKeys.resize(count);
+    tempValues.resize(count);
+    for(uint32_t shift = 0; shift < 64; shift += DIGIT_BITS)
+    {
+        uint32_t offsets[BUCKET_COUNT] = {};
+        for(auto ind = 0; ind < count; ++ind) ++offsets[(keys[ind] >> shift) & (BUCKET_COUNT - 1)];
+
+        // most passes see a single digit value (unused key bits), those are skipped
+
+        if(offsets[(keys[0] >> shift) & (BUCKET_COUNT - 1)] == count) continue;
+        uint32_t sum = 0;
+        for(auto bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+        {
+            const uint32_t bucketSize = offsets[bucket];
+            offsets[bucket] = sum;
+            sum += bucketSize;
+        }
+        for(auto ind = 0; ind < count; ++ind)
+        {
+            const uint32_t destination = offsets[(keys[ind] >> shift) & (BUCKET_COUNT - 1)]++;
+            tempKeys[destination] = keys[ind];
+            tempValues[destination] = values[ind];
+        }
+        std::swap(keys, tempKeys);
+        std::swap(values, tempValues);
+    }
+}
+
+const uint32_t RenderQueue::getSize() const
+{
+    return keys.size();
+}
+
+const uint64_t RenderQueue::getKey(const uint32_t index) const
+{
+    return keys[index];
+}
+
+const uint32_t RenderQueue::getValue(const uint32_t index) const
+{
+    return values[index];
+}
+
+void RenderQueue::clear()
+{
+    keys.clear();
+    values.clear();
+}
+
+RenderQueue::~RenderQueue()
+{
+    clear();
+}
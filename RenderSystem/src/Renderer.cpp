@@ -1,14 +1,34 @@
 #include<Renderer.hpp>
+#include<cstddef>
+#include<sys/resource.h>
+
+static const float NEAR_PLANE = 0.1f;
+static const float FAR_PLANE = 100.0f;
+static const float MAX_LEVEL_PIXEL_ERROR = 1.0f;
 
 Renderer::Renderer()
 {
 }
 
-void Renderer::create(const Window& window, const std::vector<std::string>& sceneFilenames, const std::string& imagePath)
+void Renderer::create(const Window& window, const std::vector<std::string>& sceneFilenames, const std::string& imagePath, const MeshLoadOptions& meshOptions, const bool indirectDraws, const bool gpuCulling)
 {
-    VkPhysicalDeviceFeatures features = {};
+    packedVertices = meshOptions.packedVertices;
+    VkPhysicalDeviceFeatures features = {}, optionalFeatures = {};
     features.logicOp = VK_TRUE;
-    system.create(window, true, features);
+    optionalFeatures.multiDrawIndirect = indirectDraws || gpuCulling;
+    optionalFeatures.drawIndirectFirstInstance = indirectDraws || gpuCulling;
+    optionalFeatures.textureCompressionBC = meshOptions.compressTextures;
+    std::vector<const char*> optionalExtensions;
+    if(gpuCulling) optionalExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    system.create(window, true, features, optionalFeatures, optionalExtensions);
+    this->indirectDraws = (indirectDraws || gpuCulling) && system.getEnabledFeatures().drawIndirectFirstInstance;
+    this->gpuCulling = gpuCulling && this->indirectDraws;
+    if((indirectDraws || gpuCulling) && !this->indirectDraws) printLog("drawIndirectFirstInstance is not supported, falling back to direct draws culled on the CPU.\n");
+    if(this->gpuCulling && system.isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+    {
+        drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(system.getDevice(), "vkCmdDrawIndexedIndirectCountKHR"));
+    }
+    if(this->gpuCulling && !drawIndexedIndirectCount) printLog("VK_KHR_draw_indirect_count is not supported, culled draws are kept with no instances.\n");
     uint32_t swapchainImgCount;
     swapchain.create(&system, swapchainImgCount);
     commandPool.create(&system, true);
@@ -17,7 +37,7 @@ void Renderer::create(const Window& window, const std::vector<std::string>& scen
     allocator->create(&system, &syncPool, &commandPool);
 
     viewProj.view = glm::lookAt(glm::vec3(8, 5, 7), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
-    viewProj.projection = glm::perspective(glm::radians(60.0f), (float)swapchain.getExtent().width / swapchain.getExtent().height, 0.1f, 100.0f);
+    viewProj.projection = glm::perspective(glm::radians(60.0f), (float)swapchain.getExtent().width / swapchain.getExtent().height, NEAR_PLANE, FAR_PLANE);
     allocator->allocateUniformBuffer(sizeof(viewProj), VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_GEOMETRY_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, viewProjBuffer, viewProjDescriptor);
     allocator->updateBuffer(&viewProj, viewProjBuffer);
 
@@ -25,7 +45,7 @@ void Renderer::create(const Window& window, const std::vector<std::string>& scen
     for(auto ind = 0; ind < sceneFilenames.size(); ++ind)
     {
         scenes[ind].setAllocator(allocator);
-        scenes[ind].loadFromFile(imagePath, sceneFilenames[ind]);
+        scenes[ind].loadFromFile(imagePath, sceneFilenames[ind], meshOptions);
     }
 
     depthAttachments.create(swapchainImgCount);
@@ -34,16 +54,59 @@ void Renderer::create(const Window& window, const std::vector<std::string>& scen
         allocator->allocateDepthMap(swapchain.getExtent(), depthAttachments[ind]);
     }
 
+    instanceBuffers.create(swapchainImgCount);
+    for(auto ind = 0; ind < swapchainImgCount; ++ind)
+    {
+        allocator->allocateVertexBuffer(sizeof(glm::mat4) * MAX_INSTANCE_COUNT, instanceBuffers[ind]);
+    }
+    instanceData.reserve(MAX_INSTANCE_COUNT);
+    if(this->gpuCulling)
+    {
+        // every draw is one object and one command, so the instance buffer bounds them all
+
+        if(swapchainImgCount > MAX_COMPUTE_SET_COUNT) reportError("Too many swapchain images for the cull sets.\n");
+        cullBuffers.create(CullBuffers::CBCount * swapchainImgCount);
+        cullDescriptors.create(swapchainImgCount);
+        Array<uint32_t> cullBufferSizes = 
+        {
+            sizeof(CullObject) * MAX_INSTANCE_COUNT,
+            sizeof(VkDrawIndexedIndirectCommand) * MAX_INSTANCE_COUNT,
+            sizeof(CullBucket) * MAX_INSTANCE_COUNT
+        };
+        for(auto ind = 0; ind < swapchainImgCount; ++ind)
+        {
+            allocator->allocateStorageBuffers(cullBufferSizes, &cullBuffers[CullBuffers::CBCount * ind], cullDescriptors[ind]);
+        }
+        cullObjects.reserve(MAX_INSTANCE_COUNT);
+        cullBuckets.reserve(MAX_INSTANCE_COUNT);
+        cullBucketDraws.reserve(MAX_INSTANCE_COUNT);
+    }
+    else if(this->indirectDraws)
+    {
+        indirectBuffers.create(swapchainImgCount);
+        for(auto ind = 0; ind < swapchainImgCount; ++ind)
+        {
+            allocator->allocateIndirectBuffer(sizeof(VkDrawIndexedIndirectCommand) * MAX_INSTANCE_COUNT, indirectBuffers[ind]);
+        }
+        indirectCommands.reserve(MAX_INSTANCE_COUNT);
+    }
+
     allocator->load();
     allocator->update();
+    const ObjectManagementStrategy::ImageStatistics imageStatistics = allocator->getImageStatistics();
+    printLog(("Textures: " + std::to_string(imageStatistics.imageCount) + " images, " + std::to_string(imageStatistics.uploadedBytes) + " bytes uploaded, " 
+        + std::to_string(imageStatistics.memoryBytes) + " bytes of device memory\n").c_str());
 
     for(auto ind = 0; ind < sceneFilenames.size(); ++ind)
     {
         scenes[ind].clearExtraResources();
     }
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) printLog(("Peak resident memory after loading: " + std::to_string(usage.ru_maxrss) + " KiB\n").c_str());
 
     createRenderPass();
     createPipelines();
+    if(this->gpuCulling) createComputePipelines();
 }
 
 Scene& Renderer::getScene(const uint32_t index)
@@ -107,7 +170,7 @@ void Renderer::createRenderPass()
     subpasses[0] = 
     {
         0,
-        VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS,
+        VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, 
         0,
         nullptr,
         1,
@@ -153,7 +216,6 @@ void Renderer::createRenderPass()
 #include<iostream>
 void Renderer::beginRendering()
 {
-    allocator->update();
     commandPool.reset(commandBuffers[currentSubmission], true);
     currentImage = swapchain.acquireNextImage(syncPool.getSemaphore(semaphores[currentSubmission].imageAcquired), syncPool.getFence(fences[currentSubmission].imageAcquired));
     std::cout << "Current sub: " << currentSubmission << " Current image: " << currentImage << " Used subs: " << usedSubmissions << '\n';
@@ -176,7 +238,23 @@ void Renderer::beginRendering()
     };
 
     vkBeginCommandBuffer(commandPool[commandBuffers[currentSubmission]], &beginInfo);
+    VkMemoryBarrier uploadBarrier = 
+    {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT,
+        VkAccessFlagBits::VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VkAccessFlagBits::VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VkAccessFlagBits::VK_ACCESS_INDEX_READ_BIT | VkAccessFlagBits::VK_ACCESS_UNIFORM_READ_BIT | VkAccessFlagBits::VK_ACCESS_SHADER_READ_BIT | VkAccessFlagBits::VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(commandPool[commandBuffers[currentSubmission]], 
+        VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT, 
+        VkPipelineStageFlagBits::VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VkPipelineStageFlagBits::VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
+        0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
     ImageHolder::recordLayoutChangeCommands(commandPool[commandBuffers[currentSubmission]], (!(usedSubmissions & (1 << currentSubmission))) ? VkImageLayout::VK_IMAGE_LAYOUT_UNDEFINED : VkImageLayout::VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VkImageLayout::VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, swapchain.getImage(currentImage), subresource);
+}
+
+void Renderer::beginRenderPass(const VkCommandBuffer& commands)
+{
+    // begun once the draws are known, compute work of the frame has to be recorded outside of it
 
     VkRect2D renderArea;
     renderArea.extent = swapchain.getExtent();
@@ -195,82 +273,540 @@ void Renderer::beginRendering()
         2,
         clearVals
     };
-    vkCmdBeginRenderPass(commandPool[commandBuffers[currentSubmission]], &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(commands, &renderPassInfo, VkSubpassContents::VK_SUBPASS_CONTENTS_INLINE);
 }
 
-void Renderer::renderSceneNode(const Scene::Node& node)
+void Renderer::renderSceneNode(Scene& scene, const Scene::Node& node)
 {
-    static DrawableType prevType = DrawableType::DTCount;
+    queuedRenderLists.push_back(&scene.getRenderList(node));
+}
+
+void Renderer::flushRenderLists()
+{
+    // every scene's hierarchy is culled once, draws of nodes outside the view frustum are dropped before sorting
+    // (with GPU culling every draw is queued and the cull shader drops them per mesh instead);
+    // every queued draw gets a sort key, so pipelines, descriptor sets and buffers only change between groups of draws sharing them,
+    // and a level of detail; nearby draws of a mesh sort together, so they mostly share their level as well;
+    // consecutive draws of the same mesh are then instanced, a mesh used once (or not fitting into the instance buffer) uses the node's model uniform;
+    // full levels of meshes split into meshlets are drawn per node instead, as the ranges of their meshlets that pass culling
+
     const VkCommandBuffer& commands = commandPool[commandBuffers[currentSubmission]];
-    const uint32_t meshCount = node.getMeshes().getSize();
-    for(auto meshInd = 0; meshInd < meshCount; ++meshInd)
+    drawStatistics = {};
+    boundState = {};
+    boundState.pipeline = ~0U;
+    boundState.layoutType = DrawableType::DTCount;
+    extractFrustumPlanes(viewProj.projection * viewProj.view, frustumPlanes);
+    cameraPosition = glm::vec3(glm::inverse(viewProj.view)[3]);
+    nodeVisibility.resize(scenes.getSize());
+    sceneCulled.assign(scenes.getSize(), 0);
+    for(const auto* list : queuedRenderLists)
     {
-        const Mesh* mesh = node.getMeshes()[meshInd];
-        const DrawableType type = mesh->getMaterial()->getType();
-        const DescriptorInfo& nodeModelDescriptor = node.getModelMatrixDescriptor();
-        if(prevType != type)
+        const uint32_t sceneSlot = list->getScene() - scenes.getPtr();
+        std::vector<uint8_t>& visible = nodeVisibility[sceneSlot];
+        if(!sceneCulled[sceneSlot] && !gpuCulling)
+        {
+            list->getScene()->cullNodes(frustumPlanes, visible, cullTraversalStack);
+            sceneCulled[sceneSlot] = true;
+        }
+        drawStatistics.testedCount += list->getSize();
+        for(auto entry = 0; entry < list->getSize(); ++entry)
         {
-            vkCmdBindPipeline(commands, 
-                VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                pipelinePool[type]);
-
-            const auto& matDescriptors = mesh->getMaterial()->getDescriptorInfos();
-            Array<VkDescriptorSet> sets(2 + matDescriptors.getSize());
-            sets[0] = (*viewProjDescriptor.pool)[viewProjDescriptor.setIndex];
-            sets[1] = (*nodeModelDescriptor.pool)[nodeModelDescriptor.setIndex];
-            for(auto ind = 2; ind < sets.getSize(); ++ind)
+            if(!gpuCulling && !visible[list->getNodeBoundsIndices()[entry]])
             {
-                sets[ind] = (*matDescriptors[ind - 2].pool)[matDescriptors[ind - 2].setIndex];
+                ++drawStatistics.culledCount;
+                continue;
             }
+            const uint32_t level = selectLevel(list->getScene()->getMesh(list->getMeshIds()[entry]), list->getModelMatrices()[entry]);
+            if(level) ++drawStatistics.reducedCount;
+            drawQueue.push(getSortKey(sceneSlot, *list, entry), queuedDraws.size());
+            queuedDraws.push_back({list, static_cast<uint32_t>(entry), level});
+        }
+    }
+    drawQueue.sort();
+
+    instanceData.clear();
+    indirectCommands.clear();
+    if(gpuCulling) recordCulledDraws(commands);
+    else
+    {
+        beginRenderPass(commands);
+        if(indirectDraws) recordIndirectDraws(commands);
+        else recordDirectDraws(commands);
+    }
+    if(!instanceData.empty())
+    {
+        instanceUploadRange = instanceBuffers[currentSubmission];
+        instanceUploadRange.size = sizeof(glm::mat4) * instanceData.size();
+        allocator->updateBuffer(instanceData.data(), instanceUploadRange);
+    }
+    if(!indirectCommands.empty())
+    {
+        indirectUploadRange = indirectBuffers[currentSubmission];
+        indirectUploadRange.size = sizeof(VkDrawIndexedIndirectCommand) * indirectCommands.size();
+        allocator->updateBuffer(indirectCommands.data(), indirectUploadRange);
+    }
+    queuedRenderLists.clear();
+    queuedDraws.clear();
+    drawQueue.clear();
+}
+
+const Mesh& Renderer::getQueuedMesh(const QueuedDraw& draw) const
+{
+    return draw.list->getScene()->getMesh(draw.list->getMeshIds()[draw.entry]);
+}
 
-            vkCmdBindDescriptorSets(commands, 
-                VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                allocator->getPipelineLayout(type),
-                0,
-                sets.getSize(),
-                sets.getPtr(),
-                0,
-                nullptr);
+void Renderer::recordDirectDraws(const VkCommandBuffer& commands)
+{
+    const uint32_t drawCount = drawQueue.getSize();
+    for(uint32_t first = 0, last = 0; first < drawCount; first = last)
+    {
+        const QueuedDraw& firstDraw = queuedDraws[drawQueue.getValue(first)];
+        const Mesh& mesh = getQueuedMesh(firstDraw);
+        const DrawableType type = firstDraw.list->getTypes()[firstDraw.entry];
+        while(last < drawCount)
+        {
+            const QueuedDraw& draw = queuedDraws[drawQueue.getValue(last)];
+            if(&getQueuedMesh(draw) != &mesh || draw.level != firstDraw.level) break;
+            ++last;
+        }
+        const uint32_t instanceCount = last - first;
+        if(usesMeshlets(mesh, firstDraw.level))
+        {
+            for(auto ind = first; ind < last; ++ind)
+            {
+                const QueuedDraw& draw = queuedDraws[drawQueue.getValue(ind)];
+                cullMeshlets(mesh, draw.list->getModelMatrices()[draw.entry]);
+                if(meshletRanges.empty()) continue;
+                bindDrawState(commands, type, mesh, *draw.list->getNodes()[draw.entry], false);
+                for(const auto& range : meshletRanges)
+                {
+                    vkCmdDrawIndexed(commands, range.indexCount, 1, mesh.getFirstIndex() + range.firstIndex, mesh.getBaseVertex(), 0);
+                }
+                drawStatistics.drawCount += meshletRanges.size();
+                drawStatistics.instanceCount += meshletRanges.size();
+            }
+        }
+        else if(instanceCount > 1 && instanceData.size() + instanceCount <= MAX_INSTANCE_COUNT)
+        {
+            const uint32_t firstInstance = instanceData.size();
+            for(auto ind = first; ind < last; ++ind)
+            {
+                const QueuedDraw& draw = queuedDraws[drawQueue.getValue(ind)];
+                instanceData.push_back(draw.list->getModelMatrices()[draw.entry]);
+            }
+            recordDraw(commands, type, mesh, firstDraw.level, *firstDraw.list->getNodes()[firstDraw.entry], true, instanceCount, firstInstance);
         }
         else
         {
-            const auto& matDescriptors = mesh->getMaterial()->getDescriptorInfos();
-            Array<VkDescriptorSet> sets(1 + matDescriptors.getSize());
-            sets[0] = (*nodeModelDescriptor.pool)[nodeModelDescriptor.setIndex];
-            for(auto ind = 1; ind < sets.getSize(); ++ind)
+            for(auto ind = first; ind < last; ++ind)
+            {
+                const QueuedDraw& draw = queuedDraws[drawQueue.getValue(ind)];
+                recordDraw(commands, type, mesh, draw.level, *draw.list->getNodes()[draw.entry], false, 1, 0);
+            }
+        }
+    }
+}
+
+void Renderer::recordIndirectDraws(const VkCommandBuffer& commands)
+{
+    // draws sharing a pipeline type, material and index type (and position decode for packed vertices) form a bucket drawn by one indirect call;
+    // every mesh of a bucket is one command, its instances read their model matrices from the instance buffer starting at firstInstance
+
+    const uint32_t drawCount = drawQueue.getSize();
+    for(uint32_t first = 0, last = 0; first < drawCount; first = last)
+    {
+        const QueuedDraw& firstDraw = queuedDraws[drawQueue.getValue(first)];
+        const Mesh& firstMesh = getQueuedMesh(firstDraw);
+        const DrawableType type = firstDraw.list->getTypes()[firstDraw.entry];
+        const uint32_t firstCommand = indirectCommands.size();
+        const Mesh* commandMesh = nullptr;
+        uint32_t commandLevel = 0;
+        for(; last < drawCount && instanceData.size() < MAX_INSTANCE_COUNT && indirectCommands.size() < MAX_INSTANCE_COUNT; ++last)
+        {
+            const QueuedDraw& draw = queuedDraws[drawQueue.getValue(last)];
+            const Mesh& mesh = getQueuedMesh(draw);
+            if(draw.list->getTypes()[draw.entry] != type
+                || mesh.getMaterial() != firstMesh.getMaterial()
+                || mesh.getIndexType() != firstMesh.getIndexType()
+                || (packedVertices && &mesh != &firstMesh)) break;
+            if(usesMeshlets(mesh, draw.level))
+            {
+                // one command per visible range, all reading this draw's instance; a draw with more ranges
+                // than there are commands left is drawn whole
+
+                cullMeshlets(mesh, draw.list->getModelMatrices()[draw.entry]);
+                if(meshletRanges.empty()) continue;
+                if(indirectCommands.size() + meshletRanges.size() <= MAX_INSTANCE_COUNT)
+                {
+                    for(const auto& range : meshletRanges)
+                    {
+                        indirectCommands.push_back({range.indexCount, 1, mesh.getFirstIndex() + range.firstIndex, static_cast<int32_t>(mesh.getBaseVertex()), static_cast<uint32_t>(instanceData.size())});
+                    }
+                    commandMesh = nullptr;
+                    instanceData.push_back(draw.list->getModelMatrices()[draw.entry]);
+                    continue;
+                }
+            }
+            if(&mesh != commandMesh || draw.level != commandLevel)
+            {
+                indirectCommands.push_back({mesh.getIndexCount(draw.level), 0, mesh.getFirstIndex(draw.level), static_cast<int32_t>(mesh.getBaseVertex()), static_cast<uint32_t>(instanceData.size())});
+                commandMesh = &mesh;
+                commandLevel = draw.level;
+            }
+            ++indirectCommands.back().instanceCount;
+            instanceData.push_back(draw.list->getModelMatrices()[draw.entry]);
+        }
+
+        // once the instance or the indirect buffer is full the remaining draws use their nodes' model uniforms;
+        // the loop above only adds a command while one is left, so the indirect upload never exceeds the buffer
+
+        if(last == first)
+        {
+            for(; last < drawCount; ++last)
             {
-                sets[ind] = (*matDescriptors[ind - 1].pool)[matDescriptors[ind - 1].setIndex];
+                const QueuedDraw& draw = queuedDraws[drawQueue.getValue(last)];
+                recordDraw(commands, draw.list->getTypes()[draw.entry], getQueuedMesh(draw), draw.level, *draw.list->getNodes()[draw.entry], false, 1, 0);
             }
-            vkCmdBindDescriptorSets(commands, 
-                VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                allocator->getPipelineLayout(type),
-                1,
-                sets.getSize(),
-                sets.getPtr(),
-                0,
-                nullptr);
+            break;
+        }
+        recordIndirectDraw(commands, type, firstMesh, *firstDraw.list->getNodes()[firstDraw.entry], indirectBuffers[currentSubmission], firstCommand, indirectCommands.size() - firstCommand);
+        for(auto ind = firstCommand; ind < indirectCommands.size(); ++ind) drawStatistics.instanceCount += indirectCommands[ind].instanceCount;
+    }
+}
+
+void Renderer::recordCulledDraws(const VkCommandBuffer& commands)
+{
+    // buckets are formed as for indirect draws, but every draw is an object with its own command and instance;
+    // the cull shader writes the commands, so the dispatch goes before the render pass and the draws after it
+
+    const uint32_t drawCount = drawQueue.getSize();
+    cullObjects.clear();
+    cullBuckets.clear();
+    cullBucketDraws.clear();
+    uint32_t last = 0;
+    for(uint32_t first = 0; first < drawCount && instanceData.size() < MAX_INSTANCE_COUNT; first = last)
+    {
+        const QueuedDraw& firstDraw = queuedDraws[drawQueue.getValue(first)];
+        const Mesh& firstMesh = getQueuedMesh(firstDraw);
+        const DrawableType type = firstDraw.list->getTypes()[firstDraw.entry];
+        const uint32_t bucket = cullBuckets.size();
+        cullBuckets.push_back({0, static_cast<uint32_t>(cullObjects.size())});
+        cullBucketDraws.push_back(first);
+        for(; last < drawCount && instanceData.size() < MAX_INSTANCE_COUNT; ++last)
+        {
+            const QueuedDraw& draw = queuedDraws[drawQueue.getValue(last)];
+            const Mesh& mesh = getQueuedMesh(draw);
+            if(draw.list->getTypes()[draw.entry] != type
+                || mesh.getMaterial() != firstMesh.getMaterial()
+                || mesh.getIndexType() != firstMesh.getIndexType()
+                || (packedVertices && &mesh != &firstMesh)) break;
+            const glm::mat4& model = draw.list->getModelMatrices()[draw.entry];
+            const BoundingVolume bounds = transformBoundingVolume(mesh.getBounds(), model);
+            cullObjects.push_back({glm::vec4(bounds.center, 0.0f), glm::vec4(bounds.extents, 0.0f), mesh.getIndexCount(draw.level), mesh.getFirstIndex(draw.level), static_cast<int32_t>(mesh.getBaseVertex()), bucket});
+            instanceData.push_back(model);
+        }
+    }
+    recordCullDispatch(commands);
+    beginRenderPass(commands);
+
+    const BufferInfo& commandBuffer = cullBuffers[CullBuffers::CBCount * currentSubmission + CullBuffers::CBCommands];
+    const BufferInfo& bucketBuffer = cullBuffers[CullBuffers::CBCount * currentSubmission + CullBuffers::CBBuckets];
+    for(auto bucket = 0; bucket < cullBuckets.size(); ++bucket)
+    {
+        const QueuedDraw& firstDraw = queuedDraws[drawQueue.getValue(cullBucketDraws[bucket])];
+        const DrawableType type = firstDraw.list->getTypes()[firstDraw.entry];
+        const Mesh& mesh = getQueuedMesh(firstDraw);
+        const Scene::Node& node = *firstDraw.list->getNodes()[firstDraw.entry];
+        const uint32_t firstCommand = cullBuckets[bucket].firstCommand;
+        const uint32_t commandCount = (bucket + 1 < cullBuckets.size() ? cullBuckets[bucket + 1].firstCommand : cullObjects.size()) - firstCommand;
+        if(drawIndexedIndirectCount)
+        {
+            bindDrawState(commands, type, mesh, node, true);
+            drawIndexedIndirectCount(commands, 
+                (*commandBuffer.holder)[commandBuffer.index], 
+                commandBuffer.offset + sizeof(VkDrawIndexedIndirectCommand) * firstCommand, 
+                (*bucketBuffer.holder)[bucketBuffer.index], 
+                bucketBuffer.offset + sizeof(CullBucket) * bucket + offsetof(CullBucket, drawCount), 
+                commandCount, 
+                sizeof(VkDrawIndexedIndirectCommand));
+            ++drawStatistics.indirectCallCount;
+            drawStatistics.drawCount += commandCount;
+        }
+        else recordIndirectDraw(commands, type, mesh, node, commandBuffer, firstCommand, commandCount);
+    }
+
+    // draws that don't fit into the instance buffer are neither culled nor instanced
+
+    for(; last < drawCount; ++last)
+    {
+        const QueuedDraw& draw = queuedDraws[drawQueue.getValue(last)];
+        recordDraw(commands, draw.list->getTypes()[draw.entry], getQueuedMesh(draw), draw.level, *draw.list->getNodes()[draw.entry], false, 1, 0);
+    }
+}
+
+void Renderer::recordCullDispatch(const VkCommandBuffer& commands)
+{
+    if(cullObjects.empty()) return;
+    const uint32_t firstBuffer = CullBuffers::CBCount * currentSubmission;
+    cullObjectUploadRange = cullBuffers[firstBuffer + CullBuffers::CBObjects];
+    cullObjectUploadRange.size = sizeof(CullObject) * cullObjects.size();
+    allocator->updateBuffer(cullObjects.data(), cullObjectUploadRange);
+    cullBucketUploadRange = cullBuffers[firstBuffer + CullBuffers::CBBuckets];
+    cullBucketUploadRange.size = sizeof(CullBucket) * cullBuckets.size();
+    allocator->updateBuffer(cullBuckets.data(), cullBucketUploadRange);
+
+    static const uint32_t GROUP_SIZE = 64;      // local_size_x of Cull.comp
+    static_assert(sizeof(CullConstants) <= COMPUTE_PUSH_CONSTANT_SIZE, "Cull constants don't fit into the push constants.");
+    CullConstants constants;
+    std::copy(frustumPlanes, frustumPlanes + 6, constants.planes);
+    constants.objectCount = cullObjects.size();
+    constants.compact = drawIndexedIndirectCount ? 1 : 0;
+    const DescriptorInfo& descriptor = cullDescriptors[currentSubmission];
+    vkCmdBindPipeline(commands, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, computePipelinePool[0]);
+    vkCmdBindDescriptorSets(commands, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE, allocator->getComputePipelineLayout(), 0, 1, &(*descriptor.pool)[descriptor.setIndex], 0, nullptr);
+    vkCmdPushConstants(commands, allocator->getComputePipelineLayout(), VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+    vkCmdDispatch(commands, (constants.objectCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier cullBarrier = 
+    {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        nullptr,
+        VkAccessFlagBits::VK_ACCESS_SHADER_WRITE_BIT,
+        VkAccessFlagBits::VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+    };
+    vkCmdPipelineBarrier(commands, 
+        VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 
+        VkPipelineStageFlagBits::VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+const uint32_t Renderer::selectLevel(const Mesh& mesh, const glm::mat4& model) const
+{
+    // a mesh space error e at view distance d covers e * scale * projection[1][1] * height / (2 * d) pixels;
+    // the distance is taken to the nearest point of the bounding sphere, so no part of the mesh is underestimated
+
+    if(mesh.getLevelCount() == 1 || mesh.getBounds().radius <= 0.0f) return 0;
+    const BoundingVolume bounds = transformBoundingVolume(mesh.getBounds(), model);
+    const float scale = bounds.radius / mesh.getBounds().radius;
+    const float distance = std::max(glm::length(glm::vec3(viewProj.view * glm::vec4(bounds.center, 1.0f))) - bounds.radius, NEAR_PLANE);
+    const float pixelsPerUnit = viewProj.projection[1][1] * swapchain.getExtent().height * 0.5f / distance;
+    uint32_t level = 0;
+    while(level + 1 < mesh.getLevelCount() && mesh.getLevelError(level + 1) * scale * pixelsPerUnit <= MAX_LEVEL_PIXEL_ERROR) ++level;
+    return level;
+}
+
+const bool Renderer::usesMeshlets(const Mesh& mesh, const uint32_t level) const
+{
+    return level == 0 && mesh.getMeshlets().size() > 1;
+}
+
+void Renderer::cullMeshlets(const Mesh& mesh, const glm::mat4& model)
+{
+    // the frustum planes are taken into mesh space instead (transpose(model) * plane); scaling a plane doesn't change
+    // which side of it a box is on, so the meshlet boxes are tested as they were built;
+    // the cone test measures distances, it is skipped for models that scale unevenly or mirror;
+    // adjacent visible meshlets are merged into one range
+
+    static const float SCALE_TOLERANCE = 1e-3f;
+    const std::vector<MeshOptimizer::Meshlet>& meshlets = mesh.getMeshlets();
+    glm::vec4 planes[6];
+    const glm::mat4 planeTransform = glm::transpose(model);
+    for(auto ind = 0; ind < 6; ++ind) planes[ind] = planeTransform * frustumPlanes[ind];
+    meshletVisibility.resize(meshlets.size());
+    cullBoundingBoxes(planes, mesh.getMeshletCenters(), mesh.getMeshletExtents(), meshlets.size(), meshletVisibility.data());
+
+    const glm::vec3 axisX(model[0]), axisY(model[1]), axisZ(model[2]);
+    const float scale = glm::length(axisX);
+    const bool conformal = std::fabs(glm::length(axisY) - scale) <= SCALE_TOLERANCE * scale
+        && std::fabs(glm::length(axisZ) - scale) <= SCALE_TOLERANCE * scale
+        && glm::dot(glm::cross(axisX, axisY), axisZ) > 0.0f;
+    const glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    meshletRanges.clear();
+    drawStatistics.meshletCount += meshlets.size();
+    for(auto ind = 0; ind < meshlets.size(); ++ind)
+    {
+        const MeshOptimizer::Meshlet& meshlet = meshlets[ind];
+        bool visible = meshletVisibility[ind];
+        if(visible && conformal)
+        {
+            const glm::vec3 offset(meshlet.center.x - camera.x, meshlet.center.y - camera.y, meshlet.center.z - camera.z);
+            visible = glm::dot(offset, glm::vec3(meshlet.coneAxis.x, meshlet.coneAxis.y, meshlet.coneAxis.z)) < meshlet.coneCutoff * glm::length(offset) + meshlet.radius;
+        }
+        if(!visible)
+        {
+            ++drawStatistics.meshletCulledCount;
+            continue;
+        }
+        if(!meshletRanges.empty() && meshletRanges.back().firstIndex + meshletRanges.back().indexCount == meshlet.firstIndex) meshletRanges.back().indexCount += meshlet.indexCount;
+        else meshletRanges.push_back({meshlet.firstIndex, meshlet.indexCount});
+    }
+}
+
+const uint64_t Renderer::getSortKey(const uint32_t sceneSlot, const Scene::RenderList& list, const uint32_t entry) const
+{
+    // | pipeline type : 3 | scene : 4 | material : 16 | scene : 4 | mesh : 16 | depth : 21 |
+    // material and mesh ids are only unique within a scene; depth sorts front to back
+
+    static const uint32_t DEPTH_BITS = 21;
+    static const uint32_t ID_BITS = 16;
+    static const uint32_t SCENE_BITS = 4;
+    const uint64_t sceneKey = sceneSlot & ((1 << SCENE_BITS) - 1);
+    const uint64_t materialKey = (sceneKey << ID_BITS) | (list.getMaterialIds()[entry] & ((1 << ID_BITS) - 1));
+    const uint64_t meshKey = (sceneKey << ID_BITS) | (list.getMeshIds()[entry] & ((1 << ID_BITS) - 1));
+    const float viewDepth = -(viewProj.view * list.getModelMatrices()[entry][3]).z;
+    const float normalizedDepth = glm::clamp((viewDepth - NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE), 0.0f, 1.0f);
+    const uint64_t depthKey = static_cast<uint64_t>(normalizedDepth * ((1 << DEPTH_BITS) - 1));
+    return (static_cast<uint64_t>(list.getTypes()[entry]) << (DEPTH_BITS + 2 * (ID_BITS + SCENE_BITS)))
+        | (materialKey << (DEPTH_BITS + ID_BITS + SCENE_BITS))
+        | (meshKey << DEPTH_BITS)
+        | depthKey;
+}
+
+void Renderer::recordDraw(const VkCommandBuffer& commands, const DrawableType type, const Mesh& mesh, const uint32_t level, const Scene::Node& node, const bool instanced, const uint32_t instanceCount, const uint32_t firstInstance)
+{
+    bindDrawState(commands, type, mesh, node, instanced);
+    vkCmdDrawIndexed(commands, mesh.getIndexCount(level), instanceCount, mesh.getFirstIndex(level), mesh.getBaseVertex(), firstInstance);
+    ++drawStatistics.drawCount;
+    drawStatistics.instanceCount += instanceCount;
+}
+
+void Renderer::recordIndirectDraw(const VkCommandBuffer& commands, const DrawableType type, const Mesh& mesh, const Scene::Node& node, const BufferInfo& indirect, const uint32_t firstCommand, const uint32_t commandCount)
+{
+    // without multiDrawIndirect every command needs its own call, they are still read from the buffer
+
+    bindDrawState(commands, type, mesh, node, true);
+    const VkDeviceSize offset = indirect.offset + sizeof(VkDrawIndexedIndirectCommand) * firstCommand;
+    if(system.getEnabledFeatures().multiDrawIndirect)
+    {
+        vkCmdDrawIndexedIndirect(commands, (*indirect.holder)[indirect.index], offset, commandCount, sizeof(VkDrawIndexedIndirectCommand));
+        ++drawStatistics.indirectCallCount;
+    }
+    else
+    {
+        for(auto ind = 0; ind < commandCount; ++ind)
+        {
+            vkCmdDrawIndexedIndirect(commands, (*indirect.holder)[indirect.index], offset + sizeof(VkDrawIndexedIndirectCommand) * ind, 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+        drawStatistics.indirectCallCount += commandCount;
+    }
+    drawStatistics.drawCount += commandCount;
+}
+
+void Renderer::bindDrawState(const VkCommandBuffer& commands, const DrawableType type, const Mesh& mesh, const Scene::Node& node, const bool instanced)
+{
+    const uint32_t pipeline = instanced ? DrawableType::DTCount + type : type;
+    if(boundState.pipeline != pipeline)
+    {
+        vkCmdBindPipeline(commands, 
+            VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, 
+            pipelinePool[pipeline]);
+        boundState.pipeline = pipeline;
+        ++drawStatistics.pipelineBinds;
+
+        // pipelines of one type share a layout, sets bound for another type are not reused
+
+        if(boundState.layoutType != type)
+        {
+            for(auto& set : boundState.sets) set = VK_NULL_HANDLE;
+            boundState.positionDecode = nullptr;
+            boundState.layoutType = type;
+        }
+    }
+    else ++drawStatistics.pipelineBindsSkipped;
+
+    // instanced shaders don't read the model uniform, so whatever set and offset are bound there are kept;
+    // every node shares the model set, moving between nodes only changes its dynamic offset
+
+    const DescriptorInfo& nodeModelDescriptor = node.getModelMatrixDescriptor();
+    const auto& matDescriptors = mesh.getMaterial()->getDescriptorInfos();
+    VkDescriptorSet sets[MAX_SET_COUNT];
+    uint32_t setCount = 0;
+    sets[setCount++] = (*viewProjDescriptor.pool)[viewProjDescriptor.setIndex];
+    sets[setCount++] = instanced && boundState.sets[1] != VK_NULL_HANDLE ? boundState.sets[1] : (*nodeModelDescriptor.pool)[nodeModelDescriptor.setIndex];
+    const uint32_t modelOffset = instanced && boundState.sets[1] != VK_NULL_HANDLE ? boundState.modelOffset : nodeModelDescriptor.dynamicOffset;
+    for(auto ind = 0; ind < matDescriptors.getSize(); ++ind)
+    {
+        sets[setCount++] = (*matDescriptors[ind].pool)[matDescriptors[ind].setIndex];
+    }
+    for(uint32_t first = 0, last = 0; first < setCount; first = last)
+    {
+        auto isBound = [&](const uint32_t set){ return sets[set] == boundState.sets[set] && (set != 1 || modelOffset == boundState.modelOffset); };
+        if(isBound(first))
+        {
+            ++drawStatistics.descriptorSetBindsSkipped;
+            last = first + 1;
+            continue;
         }
-        const BufferInfo& vb = mesh->getVertexBuffer(), ib = mesh->getIndexBuffer();
-        vkCmdBindVertexBuffers(commands, 0, 1, &(*vb.holder)[vb.index], &vb.offset);
-        vkCmdBindIndexBuffer(commands, (*ib.holder)[ib.index], ib.offset, VkIndexType::VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(commands, mesh->getIndexCount(), 1, 0, 0, 0);
-        prevType = type;
+        last = first + 1;
+        while(last < setCount && !isBound(last)) ++last;
+        const bool bindsModel = first <= 1 && last > 1;
+        vkCmdBindDescriptorSets(commands, 
+            VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, 
+            allocator->getPipelineLayout(type),
+            first,
+            last - first,
+            sets + first,
+            bindsModel ? 1 : 0,
+            bindsModel ? &modelOffset : nullptr);
+        for(auto ind = first; ind < last; ++ind) boundState.sets[ind] = sets[ind];
+        if(bindsModel) boundState.modelOffset = modelOffset;
+        drawStatistics.descriptorSetBinds += last - first;
     }
 
-    for(const auto& kvPair : node.getChildrenNodes())
+    if(packedVertices && boundState.positionDecode != &mesh.getPositionDecode())
+    {
+        vkCmdPushConstants(commands, allocator->getPipelineLayout(type), VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PositionDecode), &mesh.getPositionDecode());
+        boundState.positionDecode = &mesh.getPositionDecode();
+    }
+
+    // meshes of one type share their buffers, so they are bound whole and the draw picks the mesh's range
+
+    static const VkDeviceSize BUFFER_START = 0;
+    const BufferInfo& vb = mesh.getVertexBuffer(), ib = mesh.getIndexBuffer();
+    if(boundState.vertexBuffer != (*vb.holder)[vb.index])
+    {
+        vkCmdBindVertexBuffers(commands, 0, 1, &(*vb.holder)[vb.index], &BUFFER_START);
+        boundState.vertexBuffer = (*vb.holder)[vb.index];
+        ++drawStatistics.vertexBufferBinds;
+    }
+    else ++drawStatistics.vertexBufferBindsSkipped;
+    if(instanced)
     {
-        renderSceneNode(kvPair.second);
+        if(!boundState.instanceBufferBound)
+        {
+            const BufferInfo& instances = instanceBuffers[currentSubmission];
+            vkCmdBindVertexBuffers(commands, 1, 1, &(*instances.holder)[instances.index], &instances.offset);
+            boundState.instanceBufferBound = true;
+            ++drawStatistics.vertexBufferBinds;
+        }
+        else ++drawStatistics.vertexBufferBindsSkipped;
+    }
+    if(boundState.indexBuffer != (*ib.holder)[ib.index] || boundState.indexType != mesh.getIndexType())
+    {
+        vkCmdBindIndexBuffer(commands, (*ib.holder)[ib.index], BUFFER_START, mesh.getIndexType());
+        boundState.indexBuffer = (*ib.holder)[ib.index];
+        boundState.indexType = mesh.getIndexType();
+        ++drawStatistics.indexBufferBinds;
     }
+    else ++drawStatistics.indexBufferBindsSkipped;
+}
 
-    prevType = DrawableType::DTCount;
+const Renderer::DrawStatistics& Renderer::getDrawStatistics() const
+{
+    return drawStatistics;
 }
 
 void Renderer::endRendering()
 {
     const VkCommandBuffer& commands = commandPool[commandBuffers[currentSubmission]];
+    flushRenderLists();
     vkCmdEndRenderPass(commands);
     vkEndCommandBuffer(commands);
 
+    // pending uploads (including this frame's instance data) go to the queue before the frame itself
+
+    allocator->update();
+
     VkPipelineStageFlags dstFlags = VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubmitInfo submit = 
@@ -318,11 +854,15 @@ void Renderer::createPipelines()
     textured.create(2);
     notTextured.create(2);
     normalMapped.create(2);
-    textured[0].create(&system, "RenderSystem/shaders/Textured.vert");
+
+    // packed vertex layouts only change the vertex shaders
+
+    const std::string vertexVariant = packedVertices ? "Packed" : "";
+    textured[0].create(&system, ("RenderSystem/shaders/Textured" + vertexVariant + ".vert").c_str());
     textured[1].create(&system, "RenderSystem/shaders/Textured.frag");
-    notTextured[0].create(&system, "RenderSystem/shaders/NotTextured.vert");
+    notTextured[0].create(&system, ("RenderSystem/shaders/NotTextured" + vertexVariant + ".vert").c_str());
     notTextured[1].create(&system, "RenderSystem/shaders/NotTextured.frag");
-    normalMapped[0].create(&system, "RenderSystem/shaders/NormalMapped.vert");
+    normalMapped[0].create(&system, ("RenderSystem/shaders/NormalMapped" + vertexVariant + ".vert").c_str());
     normalMapped[1].create(&system, "RenderSystem/shaders/NormalMapped.frag");
     Array<ShaderStageInfo> texturedInfos(textured.getSize()), notTexturedInfos(notTextured.getSize()), normalMappedInfos(normalMapped.getSize());
     for(auto ind = 0; ind < textured.getSize(); ++ind) texturedInfos[ind] = textured[ind].getShader();
@@ -347,9 +887,15 @@ void Renderer::createPipelines()
     };
     Array<VkVertexInputBindingDescription> bindings;
     Array<VkVertexInputAttributeDescription> attributes;
-    VertexBufferStandard vbs;
-    VertexBufferNotTextured vbnt;
-    VertexBufferWithNormalMap vbnm;
+    VertexBufferStandard vbsFloat;
+    VertexBufferNotTextured vbntFloat;
+    VertexBufferWithNormalMap vbnmFloat;
+    VertexBufferStandardPacked vbsPacked;
+    VertexBufferNotTexturedPacked vbntPacked;
+    VertexBufferWithNormalMapPacked vbnmPacked;
+    VertexBuffer& vbs = packedVertices ? static_cast<VertexBuffer&>(vbsPacked) : vbsFloat;
+    VertexBuffer& vbnt = packedVertices ? static_cast<VertexBuffer&>(vbntPacked) : vbntFloat;
+    VertexBuffer& vbnm = packedVertices ? static_cast<VertexBuffer&>(vbnmPacked) : vbnmFloat;
     Array<VkPipelineColorBlendAttachmentState> colorBlendStates(1);
     colorBlendStates[0] = 
     {
@@ -362,7 +908,7 @@ void Renderer::createPipelines()
         VkBlendOp::VK_BLEND_OP_ADD,
         VkColorComponentFlagBits::VK_COLOR_COMPONENT_R_BIT | VkColorComponentFlagBits::VK_COLOR_COMPONENT_G_BIT | VkColorComponentFlagBits::VK_COLOR_COMPONENT_B_BIT | VkColorComponentFlagBits::VK_COLOR_COMPONENT_A_BIT
     };
-    pipelinePool.create(&system, DrawableType::DTCount);
+    pipelinePool.create(&system, DrawableType::DTCount * 2);     // regular pipelines, then instanced ones
     PipelineInfoBuilder infoBuilder;
     infoBuilder.setShaderStages(texturedInfos);
     vbs.getGraphicsPipelineVertexInputState(bindings, attributes);
@@ -393,6 +939,56 @@ void Renderer::createPipelines()
     infoBuilder.setLayout(&allocator->getPipelineLayout(DrawableType::DTTexturedWithNormalMap));
 
     pipelinePool.createPipeline(DrawableType::DTTexturedWithNormalMap, infoBuilder.generatePipelineInfo());
+
+    // instanced variants only replace the vertex shader and take the model matrix from binding 1
+
+    instancedVertexShaders.create(DrawableType::DTCount);
+    instancedVertexShaders[DrawableType::DTTextured].create(&system, ("RenderSystem/shaders/Textured" + vertexVariant + "Instanced.vert").c_str());
+    instancedVertexShaders[DrawableType::DTNotTextured].create(&system, ("RenderSystem/shaders/NotTextured" + vertexVariant + "Instanced.vert").c_str());
+    instancedVertexShaders[DrawableType::DTTexturedWithNormalMap].create(&system, ("RenderSystem/shaders/NormalMapped" + vertexVariant + "Instanced.vert").c_str());
+    texturedInfos[0] = instancedVertexShaders[DrawableType::DTTextured].getShader();
+    notTexturedInfos[0] = instancedVertexShaders[DrawableType::DTNotTextured].getShader();
+    normalMappedInfos[0] = instancedVertexShaders[DrawableType::DTTexturedWithNormalMap].getShader();
+
+    infoBuilder.setShaderStages(texturedInfos);
+    vbs.getGraphicsPipelineVertexInputState(bindings, attributes, true);
+    infoBuilder.setVertexInputState(true, bindings, attributes);
+    infoBuilder.setLayout(&allocator->getPipelineLayout(DrawableType::DTTextured));
+
+    pipelinePool.createPipeline(DrawableType::DTCount + DrawableType::DTTextured, infoBuilder.generatePipelineInfo());
+
+    infoBuilder.setShaderStages(notTexturedInfos);
+    vbnt.getGraphicsPipelineVertexInputState(bindings, attributes, true);
+    infoBuilder.setVertexInputState(true, bindings, attributes);
+    infoBuilder.setLayout(&allocator->getPipelineLayout(DrawableType::DTNotTextured));
+
+    pipelinePool.createPipeline(DrawableType::DTCount + DrawableType::DTNotTextured, infoBuilder.generatePipelineInfo());
+
+    infoBuilder.setShaderStages(normalMappedInfos);
+    vbnm.getGraphicsPipelineVertexInputState(bindings, attributes, true);
+    infoBuilder.setVertexInputState(true, bindings, attributes);
+    infoBuilder.setLayout(&allocator->getPipelineLayout(DrawableType::DTTexturedWithNormalMap));
+
+    pipelinePool.createPipeline(DrawableType::DTCount + DrawableType::DTTexturedWithNormalMap, infoBuilder.generatePipelineInfo());
+}
+
+void Renderer::createComputePipelines()
+{
+    computeShaders.create(1);
+    computeShaders[0].create(&system, "RenderSystem/shaders/Cull.comp");
+    computePipelinePool.create(&system, 1);
+    computePipelinePool.createPipeline(0, computeShaders[0].getShader(), allocator->getComputePipelineLayout());
+}
+
+void Renderer::reloadTextures(const uint32_t sceneIndex)
+{
+    // the old images are released a few frames later, once no submitted frame samples them any more
+
+    scenes[sceneIndex].reloadTextures();
+    allocator->update();
+    scenes[sceneIndex].clearExtraResources();
+    const ObjectManagementStrategy::ImageStatistics imageStatistics = allocator->getImageStatistics();
+    printLog(("Textures reloaded: " + std::to_string(imageStatistics.imageCount) + " images, " + std::to_string(imageStatistics.memoryBytes) + " bytes of device memory\n").c_str());
 }
 
 void Renderer::destroy()
@@ -402,12 +998,15 @@ void Renderer::destroy()
     swapchain.destroy();
     renderPass.destroy();
     pipelinePool.destroy();
+    computePipelinePool.destroy();
     //for(auto ind = 0; ind < textured.getSize(); ++ind) textured[ind].destroy();
     textured.clear();
     //for(auto ind = 0; ind < notTextured.getSize(); ++ind) notTextured[ind].destroy();
     notTextured.clear();
     //for(auto ind = 0; ind < normalMapped.getSize(); ++ind) normalMapped[ind].destroy();
     normalMapped.clear();
+    instancedVertexShaders.clear();
+    computeShaders.clear();
     commandPool.destroy();
     syncPool.destroy();
     depthAttachments.clear();
@@ -415,6 +1014,13 @@ void Renderer::destroy()
     semaphores.clear();
     fences.clear();
     scenes.clear();
+    instanceBuffers.clear();
+    indirectBuffers.clear();
+    cullBuffers.clear();
+    cullDescriptors.clear();
+    queuedRenderLists.clear();
+    queuedDraws.clear();
+    drawQueue.clear();
     allocator->destroy();
     delete allocator;
 
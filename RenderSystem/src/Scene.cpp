@@ -1,74 +1,278 @@
 #include<Scene.hpp>
+#include<SimdMath.hpp>
 #include<glm/gtx/euler_angles.hpp>
+#include<chrono>
+#include<algorithm>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<thread>
+
+static void logStageTime(const char* stage, std::chrono::steady_clock::time_point& stageStart)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double milliseconds = std::chrono::duration<double, std::milli>(now - stageStart).count();
+    printLog((std::string("Scene ") + stage + ": " + std::to_string(milliseconds) + " ms\n").c_str());
+    stageStart = now;
+}
+
+// scene cache files: the header, the materials, the material index of every mesh, the mesh records from the next aligned offset,
+// then the node tree depth first with every child's name ahead of its record
+
+static const unsigned int SCENE_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+
+struct alignas(16) SceneCacheHeader
+{
+    char identifier[8];
+    uint32_t version;
+    uint32_t importFlags;       // assimp post processing steps the source was imported with
+    uint32_t options;           // SceneCacheOption bits the meshes were built with
+    uint32_t materialCount;
+    uint32_t meshCount;
+    uint64_t sourcePathHash;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;        // of the whole source, so edits that keep its size and time still miss
+};
+
+struct SceneCacheNode       // followed by the mesh indices and the children
+{
+    aiMatrix4x4 transformation;
+    uint32_t meshCount;
+    uint32_t childCount;
+};
+
+enum SceneCacheOption
+{
+    SCOPackedVertices = 1,
+    SCOOptimizeVertexCache = 2,
+    SCOLevelsOfDetail = 4,
+    SCOMeshlets = 8
+};
+
+static const char SCENE_CACHE_IDENTIFIER[8] = {'S', 'C', 'N', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t SCENE_CACHE_VERSION = 1;      // has to change with the record layouts, the vertex layouts or the output of the mesh passes
+static const size_t SCENE_CACHE_MESH_ALIGNMENT = 16;
+
+static const bool getSceneCacheKey(const std::string& file, const MeshLoadOptions& options, SceneCacheHeader& key)
+{
+    MappedFile source;
+    memcpy(key.identifier, SCENE_CACHE_IDENTIFIER, sizeof(key.identifier));
+    key.version = SCENE_CACHE_VERSION;
+    key.importFlags = SCENE_IMPORT_FLAGS;
+    key.options = (options.packedVertices ? SCOPackedVertices : 0) | (options.optimizeVertexCache ? SCOOptimizeVertexCache : 0)
+        | (options.generateLevelsOfDetail ? SCOLevelsOfDetail : 0) | (options.buildMeshlets ? SCOMeshlets : 0);
+    key.sourcePathHash = MappedFile::hashData(file.data(), file.size());
+    if(!MappedFile::getStamp(file.c_str(), key.sourceSize, key.sourceTime) || !source.open(file.c_str())) return false;
+    key.sourceHash = MappedFile::hashData(source.getData(), source.getSize());
+    return true;
+}
+
+static const bool matchesSceneCacheKey(const SceneCacheHeader& header, const SceneCacheHeader& key)
+{
+    return memcmp(header.identifier, key.identifier, sizeof(header.identifier)) == 0 && header.version == key.version && header.importFlags == key.importFlags 
+        && header.options == key.options && header.sourcePathHash == key.sourcePathHash && header.sourceSize == key.sourceSize && header.sourceTime == key.sourceTime 
+        && header.sourceHash == key.sourceHash;
+}
+
+static void saveSceneCacheNode(const aiNode* ainode, std::ostream& stream)
+{
+    const SceneCacheNode record = {ainode->mTransformation, ainode->mNumMeshes, ainode->mNumChildren};
+    const std::vector<uint32_t> meshIndices(ainode->mMeshes, ainode->mMeshes + ainode->mNumMeshes);
+    stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    stream.write(reinterpret_cast<const char*>(meshIndices.data()), meshIndices.size() * sizeof(uint32_t));
+    for(auto i = 0; i < ainode->mNumChildren; ++i)
+    {
+        const aiNode* child = *(ainode->mChildren + i);
+        const std::string name = child->mName.C_Str();
+        const uint32_t nameLength = name.size();
+        stream.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+        stream.write(name.data(), name.size());
+        saveSceneCacheNode(child, stream);
+    }
+}
+
+Scene::Node::Node(): allocator(nullptr), scene(nullptr), parent(nullptr), position(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scaleFactors(1.0f), localMatrix(1.0f), worldMatrix(1.0f), boundsIndex(~0U), transformDirty(true), hasDirtyDescendant(false) {}
+
+Scene::Node::Node(const Node& other): scene(nullptr), parent(nullptr), boundsIndex(~0U)
+{
+    *this = other;
+}
 
-Scene::Node::Node(): modelMatrix(1.0f) {}
+Scene::Node& Scene::Node::operator=(const Node& other)
+{
+    // the copy keeps its own place in the tree, copied children are attached to it
+
+    if(this == &other) return *this;
+    allocator = other.allocator;
+    position = other.position;
+    rotation = other.rotation;
+    scaleFactors = other.scaleFactors;
+    localMatrix = other.localMatrix;
+    worldMatrix = other.worldMatrix;
+    worldBounds = other.worldBounds;
+    modelMatrixBuffer = other.modelMatrixBuffer;
+    modelMatrixDescriptor = other.modelMatrixDescriptor;
+    meshes = other.meshes;
+    children = other.children;
+    for(auto& kvPair : children) kvPair.second.parent = this;
+    setScene(scene);
+    transformDirty = false;
+    hasDirtyDescendant = false;
+    markTransformDirty();
+    return *this;
+}
+
+void Scene::Node::markHierarchyChanged()
+{
+    if(scene) ++scene->hierarchyRevision;
+}
+
+void Scene::Node::setScene(Scene* scene)
+{
+    this->scene = scene;
+    for(auto& kvPair : children) kvPair.second.setScene(scene);
+}
 
 void Scene::Node::create(ObjectManagementStrategy* allocator, const uint32_t maxMeshCount)
 {
+    this->allocator = allocator;
     meshes.create(maxMeshCount);
-    allocator->allocateUniformBuffer(sizeof(modelMatrix), VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_GEOMETRY_BIT | VkShaderStageFlagBits::VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, modelMatrixBuffer, modelMatrixDescriptor);
-    allocator->updateBuffer(&modelMatrix, modelMatrixBuffer);
+    allocator->allocateObjectUniformBuffer(sizeof(worldMatrix), modelMatrixBuffer, modelMatrixDescriptor);
+    allocator->updateBuffer(&worldMatrix, modelMatrixBuffer);
+    markTransformDirty();
+}
+
+void Scene::Node::markTransformDirty()
+{
+    // ancestors only need to know that something below them moved, the walk stops at the first one that already knows
+
+    transformDirty = true;
+    for(Node* node = parent; node && !node->hasDirtyDescendant; node = node->parent) node->hasDirtyDescendant = true;
+}
+
+void Scene::Node::updateWorldTransform(const glm::mat4& parentWorld, const bool parentChanged, uint32_t& updatedCount)
+{
+    if(transformDirty)
+    {
+        localMatrix = glm::mat4_cast(rotation);
+        localMatrix[0] *= scaleFactors.x;
+        localMatrix[1] *= scaleFactors.y;
+        localMatrix[2] *= scaleFactors.z;
+        localMatrix[3] = glm::vec4(position, 1.0f);
+    }
+    const bool changed = transformDirty || parentChanged;
+    if(changed)
+    {
+        multiplyMatrices(parentWorld, localMatrix, worldMatrix);
+        if(allocator) allocator->updateBuffer(&worldMatrix, modelMatrixBuffer);
+        worldBounds = BoundingVolume();
+        for(auto ind = 0; ind < meshes.getSize(); ++ind)
+        {
+            if(meshes[ind]) worldBounds = mergeBoundingVolumes(worldBounds, transformBoundingVolume(meshes[ind]->getBounds(), worldMatrix));
+        }
+        ++updatedCount;
+        if(scene) ++scene->transformRevision;
+    }
+    if(changed || hasDirtyDescendant)
+    {
+        for(auto& kvPair : children) kvPair.second.updateWorldTransform(worldMatrix, changed, updatedCount);
+    }
+    transformDirty = false;
+    hasDirtyDescendant = false;
 }
 
 void Scene::Node::rotate(const float radians, const glm::vec3 axis)
 {
-    modelMatrix = glm::rotate(modelMatrix, radians, axis);
+    rotation = rotation * glm::angleAxis(radians, glm::normalize(axis));
+    markTransformDirty();
 }
 
 void Scene::Node::rotate(const glm::vec3 eulerAngles)
 {
-    modelMatrix *= glm::orientate4(eulerAngles);
+    rotation = rotation * glm::quat_cast(glm::orientate3(eulerAngles));
+    markTransformDirty();
 }
 
 void Scene::Node::scale(const glm::vec3 s)
 {
-    modelMatrix = glm::scale(modelMatrix, s);
+    scaleFactors *= s;
+    markTransformDirty();
 }
 
 void Scene::Node::move(const glm::vec3 m)
 {
-    modelMatrix = glm::translate(modelMatrix, m);
+    // the offset is given in the node's own space, as with glm::translate on the model matrix
+
+    position += rotation * (scaleFactors * m);
+    markTransformDirty();
+}
+
+void Scene::Node::setPosition(const glm::vec3 p)
+{
+    position = p;
+    markTransformDirty();
+}
+
+void Scene::Node::setRotation(const glm::quat r)
+{
+    rotation = r;
+    markTransformDirty();
+}
+
+void Scene::Node::setScale(const glm::vec3 s)
+{
+    scaleFactors = s;
+    markTransformDirty();
 }
 
-//#include<iostream>
 void Scene::Node::setModelMatrix(const aiMatrix4x4& mat)
 {
-    aiVector3D aiscale, airotation, aiposition;
+    aiVector3D aiscale, aiposition;
+    aiQuaternion airotation;
     mat.Decompose(aiscale, airotation, aiposition);
-    //std::cout << s.x << ' ' << s.y << ' ' << s.z << " <- scale\n";
-    //std::cout << p.x << ' ' << p.y << ' ' << p.z << " <- pos\n";
-    //std::cout << r.x << ' ' << r.y << ' ' << r.z << " <- rot\n";
-    rotate({airotation.x, airotation.y, airotation.z});
-    move({aiposition.x, aiposition.y, aiposition.z});
-    scale({aiscale.x, aiscale.y, aiscale.z});
-//    std::cout << "Model: \n";
-//    for(int i = 0; i < 4; ++i)
-//    {
-//        for(int j = 0; j < 4; ++j)
-//        {
-//            std::cout << modelMatrix[i][j] << ' ';
-//        }
-//        std::cout << '\n';
-//    }
+    position = {aiposition.x, aiposition.y, aiposition.z};
+    rotation = glm::quat(airotation.w, airotation.x, airotation.y, airotation.z);
+    scaleFactors = {aiscale.x, aiscale.y, aiscale.z};
+    markTransformDirty();
 }
 
 void Scene::Node::setMesh(const uint32_t index, Mesh* mesh)
 {
     meshes[index] = mesh;
+    markHierarchyChanged();
+    markTransformDirty();
 }
 
 void Scene::Node::addChild(const std::string& name)
 {
     children[name] = Node();
+    children[name].parent = this;
+    children[name].setScene(scene);
+    children[name].markTransformDirty();
+    markHierarchyChanged();
 }
 
 void Scene::Node::addChild(const std::string& name, Node&& node)
 {
     children[name] = node;
+    children[name].parent = this;
+    children[name].setScene(scene);
+    children[name].markTransformDirty();
+    markHierarchyChanged();
 }
 
 Scene::Node& Scene::Node::operator[](const std::string& key)
 {
+    if(children.find(key) == children.end())
+    {
+        Node& child = children[key];
+        child.parent = this;
+        child.setScene(scene);
+        child.markTransformDirty();
+        markHierarchyChanged();
+        return child;
+    }
     return children[key];
 }
 
@@ -92,11 +296,54 @@ const DescriptorInfo& Scene::Node::getModelMatrixDescriptor() const
     return modelMatrixDescriptor;
 }
 
+const glm::mat4& Scene::Node::getModelMatrix() const
+{
+    return worldMatrix;
+}
+
+const glm::mat4& Scene::Node::getLocalMatrix() const
+{
+    return localMatrix;
+}
+
+const BoundingVolume& Scene::Node::getWorldBounds() const
+{
+    return worldBounds;
+}
+
+const glm::vec3& Scene::Node::getPosition() const
+{
+    return position;
+}
+
+const glm::quat& Scene::Node::getRotation() const
+{
+    return rotation;
+}
+
+const glm::vec3& Scene::Node::getScale() const
+{
+    return scaleFactors;
+}
+
+const Scene::Node* Scene::Node::getParent() const
+{
+    return parent;
+}
+
 void Scene::Node::destroy()
 {
-    modelMatrix = glm::mat4(1.0f);
+    position = glm::vec3(0.0f);
+    rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    scaleFactors = glm::vec3(1.0f);
+    localMatrix = glm::mat4(1.0f);
+    worldMatrix = glm::mat4(1.0f);
+    allocator = nullptr;
+    transformDirty = true;
+    hasDirtyDescendant = false;
     meshes.clear();
     children.clear();
+    markHierarchyChanged();
 }
 
 Scene::Node::~Node()
@@ -106,7 +353,7 @@ Scene::Node::~Node()
 
 Scene::Scene()
 {
-
+    root.setScene(this);
 }
 
 void Scene::setAllocator(ObjectManagementStrategy* allocator)
@@ -130,14 +377,51 @@ void Scene::loadNode(const aiNode* ainode, Node& node)
     }
 }
 
-void Scene::loadFromFile(const std::string& imagePath, const std::string& file)
+void Scene::loadFromFile(const std::string& imagePath, const std::string& file, const MeshLoadOptions& meshOptions)
 {
-    importedScene = importer.ReadFile(file, aiProcess_Triangulate | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
-    meshes.create(importedScene->mNumMeshes);
-    materials.create(importedScene->mNumMaterials);
-    loadMaterials(imagePath);
-    loadMeshes();
-    loadNode(importedScene->mRootNode, root);
+    // texture decoding and vertex conversion run on worker threads, 
+    // GPU resources are registered afterwards on this thread in scene order;
+    // a valid scene cache replaces the import and the mesh building, only the textures are still loaded
+
+    auto loadStart = std::chrono::steady_clock::now(), stageStart = loadStart;
+    VkFormat textureFormat, normalMapFormat;
+    pickTextureFormats(meshOptions, textureFormat, normalMapFormat);
+    importedScene = nullptr;
+    const bool cached = meshOptions.cacheScene && loadSceneCache(imagePath, file, textureFormat, normalMapFormat, meshOptions);
+    if(cached) logStageTime("cache loading", stageStart);
+    else
+    {
+        importedScene = importer.ReadFile(file, SCENE_IMPORT_FLAGS);
+        if(!importedScene) reportError("Failed to import scene.\n");
+        meshes.create(importedScene->mNumMeshes);
+        materials.create(importedScene->mNumMaterials);
+        loadMaterials(imagePath, textureFormat, normalMapFormat, meshOptions);
+        logStageTime("import", stageStart);
+    }
+
+    ThreadPool workers;
+    workers.create();
+    loadImages(workers);
+    if(!cached) loadMeshes(workers, meshOptions);
+    workers.wait();
+    workers.destroy();
+    logStageTime("texture decoding and mesh building", stageStart);
+    if(meshOptions.cacheScene && !cached) saveSceneCache(file, meshOptions);
+    if(meshOptions.cacheTextures) logTextureCacheStatistics();
+    if(meshOptions.optimizeVertexCache) logVertexCacheStatistics();
+
+    createResources();
+    logStageTime("resource registration", stageStart);
+
+    if(cached)
+    {
+        size_t offset = sceneCacheNodeOffset;
+        loadCachedNode(offset, &root);
+    }
+    else loadNode(importedScene->mRootNode, root);
+    updateTransforms();
+    logStageTime("node loading", stageStart);
+    logStageTime(cached ? "total, from the scene cache" : "total", loadStart);
 }
 
 Material& Scene::getMaterial(const uint32_t index)
@@ -160,6 +444,201 @@ Mesh& Scene::getMesh(const uint32_t index)
     return meshes[index];
 }
 
+const Material& Scene::getMaterial(const uint32_t index) const
+{
+    return materials[index];
+}
+
+const Mesh& Scene::getMesh(const uint32_t index) const
+{
+    return meshes[index];
+}
+
+const uint32_t Scene::updateTransforms()
+{
+    uint32_t updatedCount = 0;
+    root.updateWorldTransform(glm::mat4(1.0f), false, updatedCount);
+    return updatedCount;
+}
+
+const uint32_t Scene::getMeshCount() const
+{
+    return meshes.getSize();
+}
+
+const uint64_t Scene::getHierarchyRevision() const
+{
+    return hierarchyRevision;
+}
+
+const uint64_t Scene::getTransformRevision() const
+{
+    return transformRevision;
+}
+
+const Scene::RenderList& Scene::getRenderList(const Node& subtreeRoot)
+{
+    updateTransforms();
+    updateBoundingVolumeHierarchy();
+    RenderList& list = renderLists[&subtreeRoot];
+    if(list.root != &subtreeRoot || list.hierarchyRevision != hierarchyRevision) buildRenderList(subtreeRoot, list);
+    else if(list.transformRevision != transformRevision) refreshRenderListTransforms(list);
+    return list;
+}
+
+void Scene::updateBoundingVolumeHierarchy()
+{
+    // only nodes with meshes are primitives, empty nodes contribute nothing to cull or hit
+
+    if(boundsHierarchyRevision != hierarchyRevision)
+    {
+        boundedNodes.clear();
+        std::vector<Node*> pendingNodes = {&root};
+        while(!pendingNodes.empty())
+        {
+            Node* node = pendingNodes.back();
+            pendingNodes.pop_back();
+            node->boundsIndex = ~0U;
+            if(node->getMeshes().getSize())
+            {
+                node->boundsIndex = boundedNodes.size();
+                boundedNodes.push_back(node);
+            }
+            for(auto& kvPair : node->children) pendingNodes.push_back(&kvPair.second);
+        }
+        boundedNodeVolumes.resize(boundedNodes.size());
+        for(auto ind = 0; ind < boundedNodes.size(); ++ind) boundedNodeVolumes[ind] = boundedNodes[ind]->getWorldBounds();
+        boundingVolumeHierarchy.build(boundedNodeVolumes);
+    }
+    else if(boundsTransformRevision != transformRevision)
+    {
+        for(auto ind = 0; ind < boundedNodes.size(); ++ind) boundedNodeVolumes[ind] = boundedNodes[ind]->getWorldBounds();
+        boundingVolumeHierarchy.refit(boundedNodeVolumes);
+    }
+    boundsHierarchyRevision = hierarchyRevision;
+    boundsTransformRevision = transformRevision;
+}
+
+void Scene::cullNodes(const glm::vec4* planes, std::vector<uint8_t>& visible, std::vector<uint32_t>& traversalStack) const
+{
+    visible.resize(boundingVolumeHierarchy.getPrimitiveCount());
+    boundingVolumeHierarchy.cull(planes, visible.data(), traversalStack);
+}
+
+const Scene::Node* Scene::raycast(const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+    updateTransforms();
+    updateBoundingVolumeHierarchy();
+    const float length = glm::length(direction);
+    if(length <= 0.0f) return nullptr;
+    std::vector<uint32_t> traversalStack;
+    const uint32_t hit = boundingVolumeHierarchy.raycast(origin, direction / length, distance, traversalStack);
+    return hit != ~0U ? boundedNodes[hit] : nullptr;
+}
+
+void Scene::buildRenderList(const Node& subtreeRoot, RenderList& list) const
+{
+    struct Draw
+    {
+        const Node* node;
+        uint32_t meshId;
+        uint32_t materialId;
+        DrawableType type;
+    };
+
+    std::vector<Draw> draws;
+    std::vector<const Node*> pendingNodes = {&subtreeRoot};
+    while(!pendingNodes.empty())
+    {
+        const Node* node = pendingNodes.back();
+        pendingNodes.pop_back();
+        const Array<Mesh*>& nodeMeshes = node->getMeshes();
+        for(auto ind = 0; ind < nodeMeshes.getSize(); ++ind)
+        {
+            const Mesh* mesh = nodeMeshes[ind];
+            const Material* material = mesh->getMaterial();
+            draws.push_back({node, static_cast<uint32_t>(mesh - meshes.getPtr()), static_cast<uint32_t>(material - materials.getPtr()), material->getType()});
+        }
+        for(const auto& kvPair : node->getChildrenNodes()) pendingNodes.push_back(&kvPair.second);
+    }
+
+    // draws of one mesh end up next to each other, so the renderer can instance them without searching
+
+    std::stable_sort(draws.begin(), draws.end(), [](const Draw& a, const Draw& b)
+    {
+        if(a.type != b.type) return a.type < b.type;
+        if(a.materialId != b.materialId) return a.materialId < b.materialId;
+        return a.meshId < b.meshId;
+    });
+
+    list.scene = this;
+    list.root = &subtreeRoot;
+    list.hierarchyRevision = hierarchyRevision;
+    list.meshIds.resize(draws.size());
+    list.materialIds.resize(draws.size());
+    list.types.resize(draws.size());
+    list.nodes.resize(draws.size());
+    list.nodeBoundsIndices.resize(draws.size());
+    list.modelMatrices.resize(draws.size());
+    for(auto ind = 0; ind < draws.size(); ++ind)
+    {
+        list.meshIds[ind] = draws[ind].meshId;
+        list.materialIds[ind] = draws[ind].materialId;
+        list.types[ind] = draws[ind].type;
+        list.nodes[ind] = draws[ind].node;
+        list.nodeBoundsIndices[ind] = draws[ind].node->boundsIndex;
+    }
+    refreshRenderListTransforms(list);
+}
+
+void Scene::refreshRenderListTransforms(RenderList& list) const
+{
+    for(auto ind = 0; ind < list.nodes.size(); ++ind) list.modelMatrices[ind] = list.nodes[ind]->getModelMatrix();
+    list.transformRevision = transformRevision;
+}
+
+Scene::RenderList::RenderList(){}
+
+const uint32_t Scene::RenderList::getSize() const
+{
+    return nodes.size();
+}
+
+const Scene* Scene::RenderList::getScene() const
+{
+    return scene;
+}
+
+const glm::mat4* Scene::RenderList::getModelMatrices() const
+{
+    return modelMatrices.data();
+}
+
+const uint32_t* Scene::RenderList::getMeshIds() const
+{
+    return meshIds.data();
+}
+
+const uint32_t* Scene::RenderList::getMaterialIds() const
+{
+    return materialIds.data();
+}
+
+const DrawableType* Scene::RenderList::getTypes() const
+{
+    return types.data();
+}
+
+const Scene::Node* const* Scene::RenderList::getNodes() const
+{
+    return nodes.data();
+}
+
+const uint32_t* Scene::RenderList::getNodeBoundsIndices() const
+{
+    return nodeBoundsIndices.data();
+}
+
 Scene::Node& Scene::operator[](const std::string& key)
 {
     return root[key];
@@ -170,34 +649,239 @@ const Scene::Node& Scene::operator[](const std::string& key) const
     return root[key];
 }
 
-void Scene::loadMaterials(const std::string& imagePath)
+void Scene::pickTextureFormats(const MeshLoadOptions& options, VkFormat& textureFormat, VkFormat& normalMapFormat) const
+{
+    // compressed formats are picked here, the image jobs only encode
+
+    const VkFormat mipmappedFormat = options.cacheTextures ? VkFormat::VK_FORMAT_R8G8B8A8_UNORM : VkFormat::VK_FORMAT_UNDEFINED;
+    textureFormat = mipmappedFormat;
+    normalMapFormat = mipmappedFormat;
+    if(options.compressTextures)
+    {
+        if(!allocator->pickCompressedImageFormat(false, textureFormat)) printLog("No block compressed color formats are supported, textures stay uncompressed.\n");
+        if(!allocator->pickCompressedImageFormat(true, normalMapFormat)) printLog("No block compressed normal map formats are supported, normal maps stay uncompressed.\n");
+    }
+}
+
+void Scene::loadMaterials(const std::string& imagePath, const VkFormat textureFormat, const VkFormat normalMapFormat, const MeshLoadOptions& options)
 {
+    // material types are needed by the mesh jobs, so they are resolved here before any job starts
+
     for(auto ind = 0; ind < importedScene->mNumMaterials; ++ind)
     {
-        materials[ind].create(allocator, *(importedScene->mMaterials + ind), imagePath);
+        materials[ind].load(*(importedScene->mMaterials + ind), imagePath, textureFormat, normalMapFormat, options.cacheTextures);
+    }
+}
+
+void Scene::loadImages(ThreadPool& workers)
+{
+    for(auto ind = 0; ind < materials.getSize(); ++ind)
+    {
+        Material* material = &materials[ind];
+        workers.enqueue([material]{ material->loadImages(); });
     }
 }
 
+void Scene::createResources()
+{
+    for(auto ind = 0; ind < materials.getSize(); ++ind) materials[ind].create(allocator);
+    for(auto ind = 0; ind < meshes.getSize(); ++ind) meshes[ind].create(allocator);
+}
+
+void Scene::reloadTextures()
+{
+    for(auto ind = 0; ind < materials.getSize(); ++ind) materials[ind].reloadImages();
+}
+
 void Scene::clearExtraResources()
 {
     for(auto ind = 0; ind < materials.getSize(); ++ind) materials[ind].clearExtraResources();
     for(auto ind = 0; ind < meshes.getSize(); ++ind) meshes[ind].clearExtraResources();
+    sceneCache.close();
 }
 
-void Scene::loadMeshes()
+void Scene::loadMeshes(ThreadPool& workers, const MeshLoadOptions& meshOptions)
 {
     for(auto ind = 0; ind < importedScene->mNumMeshes; ++ind)
     {
-        meshes[ind].create(allocator, *(importedScene->mMeshes + ind), &materials[(*(importedScene->mMeshes + ind))->mMaterialIndex]);
+        Mesh* mesh = &meshes[ind];
+        const aiMesh* aimesh = *(importedScene->mMeshes + ind);
+        const Material* material = &materials[aimesh->mMaterialIndex];
+        workers.enqueue([mesh, aimesh, material, meshOptions]{ mesh->load(aimesh, material, meshOptions); });
     }
 }
 
+const bool Scene::loadSceneCache(const std::string& imagePath, const std::string& file, const VkFormat textureFormat, const VkFormat normalMapFormat, const MeshLoadOptions& meshOptions)
+{
+    // the whole file is checked before the scene uses any of it, so a stale or damaged cache only falls back to importing;
+    // meshes keep pointers into the mapping, nothing is copied until the allocator uploads them
+
+    SceneCacheHeader key, header;
+    if(!getSceneCacheKey(file, meshOptions, key)) return false;
+    if(!sceneCache.open((file + ".scene").c_str())) return false;
+    const unsigned char* data = sceneCache.getData();
+    const size_t size = sceneCache.getSize();
+    if(size >= sizeof(header))
+    {
+        memcpy(&header, data, sizeof(header));
+        bool valid = matchesSceneCacheKey(header, key);
+        size_t offset = sizeof(header);
+
+        // the counts are checked against the file before anything is allocated for them, every record takes at least its fixed part
+
+        const uint64_t minimumSize = static_cast<uint64_t>(header.materialCount) * Material::getMinimumCacheSize() 
+            + static_cast<uint64_t>(header.meshCount) * (sizeof(uint32_t) + Mesh::getMinimumCacheSize());
+        valid = valid && minimumSize <= size - offset;
+        if(valid)
+        {
+            materials.create(header.materialCount);
+            meshes.create(header.meshCount);
+        }
+        for(uint32_t ind = 0; valid && ind < header.materialCount; ++ind)
+        {
+            valid = materials[ind].loadCache(data, size, offset, imagePath, textureFormat, normalMapFormat, meshOptions.cacheTextures);
+        }
+        std::vector<uint32_t> materialIndices(valid ? header.meshCount : 0);
+        valid = valid && size - offset >= materialIndices.size() * sizeof(uint32_t);
+        if(valid)
+        {
+            memcpy(materialIndices.data(), data + offset, materialIndices.size() * sizeof(uint32_t));
+            offset += materialIndices.size() * sizeof(uint32_t);
+            offset = (offset + SCENE_CACHE_MESH_ALIGNMENT - 1) / SCENE_CACHE_MESH_ALIGNMENT * SCENE_CACHE_MESH_ALIGNMENT;
+        }
+        for(uint32_t ind = 0; valid && ind < header.meshCount; ++ind)
+        {
+            valid = materialIndices[ind] < header.materialCount && meshes[ind].loadCache(data, size, offset, &materials[materialIndices[ind]]);
+        }
+        sceneCacheNodeOffset = offset;
+        if(valid && loadCachedNode(offset, nullptr) && offset == size) return true;
+    }
+    sceneCache.close();
+    return false;
+}
+
+const bool Scene::loadCachedNode(size_t& offset, Node* node)
+{
+    // without a node the records are only checked, so a damaged tree is found before any node is created;
+    // the tree is walked with an explicit stack of the nodes whose children are still being read, a deep one can't overflow the call stack
+
+    struct PendingNode
+    {
+        Node* node;
+        uint32_t childCount;
+    };
+    const unsigned char* data = sceneCache.getData();
+    const size_t size = sceneCache.getSize();
+    std::vector<PendingNode> pendingNodes;
+    std::vector<uint32_t> meshIndices;
+    while(true)
+    {
+        SceneCacheNode record;
+        if(offset > size || size - offset < sizeof(record)) return false;
+        memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(record);
+        if(size - offset < static_cast<uint64_t>(record.meshCount) * sizeof(uint32_t)) return false;
+        meshIndices.resize(record.meshCount);
+        memcpy(meshIndices.data(), data + offset, meshIndices.size() * sizeof(uint32_t));
+        offset += meshIndices.size() * sizeof(uint32_t);
+        for(const uint32_t meshIndex : meshIndices)
+        {
+            if(meshIndex >= meshes.getSize()) return false;
+        }
+        if(node)
+        {
+            node->create(allocator, record.meshCount);
+            node->setModelMatrix(record.transformation);
+            for(auto i = 0; i < record.meshCount; ++i) node->setMesh(i, &meshes[meshIndices[i]]);
+        }
+        pendingNodes.push_back({node, record.childCount});
+
+        // the next record is the first unread child of the deepest node that has one
+
+        while(!pendingNodes.empty() && pendingNodes.back().childCount == 0) pendingNodes.pop_back();
+        if(pendingNodes.empty()) return true;
+        PendingNode& parent = pendingNodes.back();
+        --parent.childCount;
+        uint32_t nameLength;
+        if(size - offset < sizeof(nameLength)) return false;
+        memcpy(&nameLength, data + offset, sizeof(nameLength));
+        offset += sizeof(nameLength);
+        if(size - offset < nameLength) return false;
+        const std::string name(reinterpret_cast<const char*>(data + offset), nameLength);
+        offset += nameLength;
+        if(parent.node) parent.node->addChild(name);
+        node = parent.node ? &(*parent.node)[name] : nullptr;
+    }
+}
+
+void Scene::saveSceneCache(const std::string& file, const MeshLoadOptions& meshOptions) const
+{
+    // written under a name only this thread uses and renamed, so readers never see a partly written file;
+    // a cache that can't be written is only reported, the next run imports the scene again
+
+    static const char PADDING[SCENE_CACHE_MESH_ALIGNMENT] = {};
+    SceneCacheHeader header = {};
+    if(!getSceneCacheKey(file, meshOptions, header)) return;
+    header.materialCount = materials.getSize();
+    header.meshCount = meshes.getSize();
+    std::vector<uint32_t> materialIndices(meshes.getSize());
+    for(auto ind = 0; ind < meshes.getSize(); ++ind) materialIndices[ind] = meshes[ind].getMaterial() - materials.getPtr();
+    const std::string filename = file + ".scene";
+    const std::string temporaryFilename = filename + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(auto ind = 0; ind < materials.getSize(); ++ind) materials[ind].saveCache(stream);
+    stream.write(reinterpret_cast<const char*>(materialIndices.data()), materialIndices.size() * sizeof(uint32_t));
+    const size_t position = stream.tellp();
+    stream.write(PADDING, (SCENE_CACHE_MESH_ALIGNMENT - position % SCENE_CACHE_MESH_ALIGNMENT) % SCENE_CACHE_MESH_ALIGNMENT);
+    for(auto ind = 0; ind < meshes.getSize(); ++ind) meshes[ind].saveCache(stream);
+    saveSceneCacheNode(importedScene->mRootNode, stream);
+    stream.close();
+    std::error_code error;
+    if(stream) std::filesystem::rename(temporaryFilename, filename, error);
+    if(!stream || error)
+    {
+        std::filesystem::remove(temporaryFilename, error);
+        printLog(("Failed to write scene cache " + filename + "\n").c_str());
+    }
+}
+
+void Scene::logVertexCacheStatistics() const
+{
+    MeshOptimizer::Statistics original = {}, optimized = {};
+    for(auto ind = 0; ind < meshes.getSize(); ++ind)
+    {
+        const MeshOptimizer::Statistics& before = meshes[ind].getOriginalCacheStatistics(), & after = meshes[ind].getCacheStatistics();
+        original.triangleCount += before.triangleCount;
+        original.vertexCount += before.vertexCount;
+        original.transformedVertexCount += before.transformedVertexCount;
+        optimized.triangleCount += after.triangleCount;
+        optimized.vertexCount += after.vertexCount;
+        optimized.transformedVertexCount += after.transformedVertexCount;
+    }
+    printLog(("Scene vertex cache: ACMR " + std::to_string(MeshOptimizer::getACMR(original)) + " -> " + std::to_string(MeshOptimizer::getACMR(optimized))
+        + ", ATVR " + std::to_string(MeshOptimizer::getATVR(original)) + " -> " + std::to_string(MeshOptimizer::getATVR(optimized)) + "\n").c_str());
+}
+
+void Scene::logTextureCacheStatistics() const
+{
+    uint32_t cachedImageCount = 0;
+    for(auto ind = 0; ind < materials.getSize(); ++ind) cachedImageCount += materials[ind].getCachedImageCount();
+    printLog(("Scene texture cache: " + std::to_string(cachedImageCount) + " images loaded with their mipmaps\n").c_str());
+}
+
 void Scene::destroy()
 {
     importer.FreeScene();
+    renderLists.clear();
+    boundingVolumeHierarchy.clear();
+    boundedNodes.clear();
+    boundedNodeVolumes.clear();
+    boundsHierarchyRevision = ~0ull;
     root.destroy();
     materials.clear();
     meshes.clear();
+    sceneCache.close();
 }
 
 Scene::~Scene()
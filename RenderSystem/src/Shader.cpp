@@ -1,6 +1,11 @@
 #include<Shader.hpp>
+#include<algorithm>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
 #include<iostream>
 #include<string>
+#include<thread>
 
 Shader::Shader(){}
 
@@ -55,35 +60,155 @@ const EShLanguage parseAndSetType(const std::string& suffix, VkShaderStageFlagBi
     return EShLangCount;
 }
 
+// the files a source includes, directly or through other includes, found by scanning its #include lines the way the includer resolves them:
+// next to the including file first, then next to the shader; false if one of them can't be read
+
+const bool collectIncludes(const std::string& filename, const std::string& shaderPath, std::vector<std::string>& includes)
+{
+    std::ifstream stream(filename);
+    if(!stream) return false;
+    std::string line;
+    while(std::getline(stream, line))
+    {
+        auto start = line.find_first_not_of(" \t");
+        if(start == std::string::npos || line[start] != '#') continue;
+        start = line.find_first_not_of(" \t", start + 1);
+        if(start == std::string::npos || line.compare(start, 7, "include") != 0) continue;
+        const auto open = line.find_first_of("\"<", start + 7);
+        if(open == std::string::npos) continue;
+        const auto close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if(close == std::string::npos) continue;
+        const std::string name = line.substr(open + 1, close - open - 1);
+        std::string include = getFilePath(filename) + "/" + name;
+        if(!std::filesystem::exists(include)) include = shaderPath + "/" + name;
+        if(std::find(includes.begin(), includes.end(), include) != includes.end()) continue;
+        includes.push_back(include);
+        if(!collectIncludes(include, shaderPath, includes)) return false;
+    }
+    return true;
+}
+
+// SPIR-V cache files: the header, then the code; shaders without includes are keyed by their source,
+// the others by their preprocessed source, which still takes glslang's preprocessor but skips parsing, linking and code generation
+
+struct SpirvCacheHeader
+{
+    char identifier[8];
+    uint32_t version;
+    uint32_t includeCount;      // of the compiled source, 0 means the source alone decides the code
+    uint64_t optionsHash;
+    uint64_t sourceHash;
+    uint64_t preprocessedHash;
+    uint64_t codeSize;          // in bytes
+};
+
+static const char SPIRV_CACHE_IDENTIFIER[8] = {'S', 'P', 'V', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t SPIRV_CACHE_VERSION = 1;      // of the file layout, the compiler version is part of the options hash
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+class CountingIncluder : public DirStackFileIncluder
+{
+public:
+    virtual IncludeResult* includeLocal(const char* headerName, const char* includerName, size_t inclusionDepth) override
+    {
+        ++includeCount;
+        return DirStackFileIncluder::includeLocal(headerName, includerName, inclusionDepth);
+    }
+
+    virtual IncludeResult* includeSystem(const char* headerName, const char* includerName, size_t inclusionDepth) override
+    {
+        ++includeCount;
+        return DirStackFileIncluder::includeSystem(headerName, includerName, inclusionDepth);
+    }
+
+    uint32_t includeCount = 0;
+};
+
+const uint64_t Shader::getOptionsHash(const EShLanguage shaderType)
+{
+    // glslang bumps its generator version whenever the code it generates changes, the same value goes into every module's header
+
+    const int64_t options[] = {shaderType, clientInputSematicsVersion, vulkanClientVersion, targetLangVersion, messages, glslang::GetKhronosToolId(), glslang::GetSpirvGeneratorVersion()};
+    return MappedFile::hashData(options, sizeof(options));
+}
+
+const bool Shader::loadPrecompiled(const char* filename, MappedFile& code)
+{
+    // blobs come from the Makefile's shaders target, which only knows about the source, so the includes are checked here;
+    // the mapping is page aligned, so the code is used in place
+
+    const std::string codeFilename = std::string(filename) + ".spv";
+    uint64_t sourceSize, codeSize;
+    int64_t sourceTime, codeTime;
+    if(!MappedFile::getStamp(filename, sourceSize, sourceTime) || !MappedFile::getStamp(codeFilename.c_str(), codeSize, codeTime) || codeTime < sourceTime) return false;
+    std::vector<std::string> includes;
+    if(!collectIncludes(filename, getFilePath(filename), includes)) return false;
+    for(const auto& include : includes)
+    {
+        if(!MappedFile::getStamp(include.c_str(), sourceSize, sourceTime) || codeTime < sourceTime) return false;
+    }
+    if(!code.open(codeFilename.c_str())) return false;
+    if(code.getSize() % sizeof(uint32_t) == 0 && *reinterpret_cast<const uint32_t*>(code.getData()) == SPIRV_MAGIC) return true;
+    code.close();
+    return false;
+}
+
 void Shader::create(const System* system, const char* filename)
 {
     this->system = system;
 
-    std::vector<uint32_t> compiled;
+    EShLanguage shaderType = parseAndSetType(std::move(getSuffix(filename)), shader.stage);
+    MappedFile precompiled;
+    if(loadPrecompiled(filename, precompiled))
+    {
+        createModule(reinterpret_cast<const uint32_t*>(precompiled.getData()), precompiled.getSize());
+        return;
+    }
 
-    glslang::InitializeProcess();
-    
-    std::ifstream file(filename);
+    // the source is handed to glslang straight from the mapping, it isn't null terminated so its length goes along
 
-    if(!file.is_open())
+    MappedFile file;
+
+    if(!file.open(filename))
     {
-        glslang::FinalizeProcess();
         throw std::runtime_error("Shader file not found.");
     }
 
-    std::string glslInput{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
-    const char* glslInputCStr = glslInput.c_str();
+    const std::string cacheFilename = std::string(filename) + ".spvcache";
+    MappedFile cache;
+    SpirvCacheHeader header = {}, cachedHeader;
+    memcpy(header.identifier, SPIRV_CACHE_IDENTIFIER, sizeof(header.identifier));
+    header.version = SPIRV_CACHE_VERSION;
+    header.optionsHash = getOptionsHash(shaderType);
+    header.sourceHash = MappedFile::hashData(file.getData(), file.getSize());
+    bool cached = cache.open(cacheFilename.c_str()) && cache.getSize() >= sizeof(cachedHeader);
+    if(cached)
+    {
+        memcpy(&cachedHeader, cache.getData(), sizeof(cachedHeader));
+        cached = memcmp(cachedHeader.identifier, header.identifier, sizeof(header.identifier)) == 0 && cachedHeader.version == header.version && cachedHeader.optionsHash == header.optionsHash
+            && cachedHeader.codeSize == cache.getSize() - sizeof(cachedHeader) && cachedHeader.codeSize && cachedHeader.codeSize % sizeof(uint32_t) == 0;
+    }
+    const uint32_t* cachedCode = cached ? reinterpret_cast<const uint32_t*>(cache.getData() + sizeof(cachedHeader)) : nullptr;
+    if(cached && !cachedHeader.includeCount && cachedHeader.sourceHash == header.sourceHash)
+    {
+        createModule(cachedCode, cachedHeader.codeSize);
+        return;
+    }
+
+    std::vector<uint32_t> compiled;
+
+    glslang::InitializeProcess();
+
+    const char* glslInput = reinterpret_cast<const char*>(file.getData());
+    const int glslInputLength = file.getSize();
 
-    EShLanguage shaderType = parseAndSetType(std::move(getSuffix(filename)), shader.stage);
     glslang::TShader glslShader(shaderType);
-    glslShader.setStrings(&glslInputCStr, 1);
+    glslShader.setStringsWithLengths(&glslInput, &glslInputLength, 1);
     glslShader.setEnvInput(glslang::EShSourceGlsl, shaderType, glslang::EShClientVulkan, clientInputSematicsVersion);
     glslShader.setEnvClient(glslang::EShClientVulkan, vulkanClientVersion);
     glslShader.setEnvTarget(glslang::EshTargetSpv, targetLangVersion);
 
-    const EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
-
-    DirStackFileIncluder includer;
+    CountingIncluder includer;
     includer.pushExternalLocalDirectory(getFilePath(filename));
 
     std::string glslPreprocessed;
@@ -93,15 +218,25 @@ void Shader::create(const System* system, const char* filename)
         std::cout << glslShader.getInfoLog() << std::endl;
         std::cout << glslShader.getInfoDebugLog() << std::endl;
     }
+    header.includeCount = includer.includeCount;
+    header.preprocessedHash = MappedFile::hashData(glslPreprocessed.data(), glslPreprocessed.size());
+    if(cached && cachedHeader.preprocessedHash == header.preprocessedHash)
+    {
+        glslang::FinalizeProcess();
+        createModule(cachedCode, cachedHeader.codeSize);
+        return;
+    }
 
     const char* preprocessedCStr = glslPreprocessed.c_str();
     glslShader.setStrings(&preprocessedCStr, 1);
 
+    bool succeeded = true;
     if (!glslShader.parse(&DefaultTBuiltInResource, clientInputSematicsVersion, false, messages))
     {
         std::cout << "GLSL Parsing Failed for: " << filename << std::endl;
         std::cout << glslShader.getInfoLog() << std::endl;
         std::cout << glslShader.getInfoDebugLog() << std::endl;
+        succeeded = false;
     }
 
     glslang::TProgram program;
@@ -111,21 +246,47 @@ void Shader::create(const System* system, const char* filename)
         std::cout << "GLSL Linking Failed for: " << filename << std::endl;
         std::cout << glslShader.getInfoLog() << std::endl;
         std::cout << glslShader.getInfoDebugLog() << std::endl;
+        succeeded = false;
     }
 
     spv::SpvBuildLogger logger;
     glslang::SpvOptions spvOptions;
     glslang::GlslangToSpv(*program.getIntermediate(shaderType), compiled, &logger, &spvOptions);
+    glslang::FinalizeProcess();
 
+    // written under a name only this thread uses and renamed, so readers never see a partly written file;
+    // shaders that failed to compile are never cached
+
+    cache.close();
+    header.codeSize = compiled.size() * sizeof(uint32_t);
+    if(succeeded && header.codeSize)
+    {
+        const std::string temporaryFilename = cacheFilename + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        std::ofstream stream(temporaryFilename, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(compiled.data()), header.codeSize);
+        stream.close();
+        std::error_code error;
+        if(stream) std::filesystem::rename(temporaryFilename, cacheFilename, error);
+        if(!stream || error)
+        {
+            std::filesystem::remove(temporaryFilename, error);
+            printLog(("Failed to write shader cache " + cacheFilename + "\n").c_str());
+        }
+    }
+    createModule(compiled.data(), header.codeSize);
+}
+
+void Shader::createModule(const uint32_t* code, const size_t size)
+{
     VkShaderModuleCreateInfo info;
     info.flags = 0;
     info.pNext = nullptr;
     info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    info.codeSize = compiled.size() * sizeof(uint32_t);
-    info.pCode = compiled.data();
+    info.codeSize = size;
+    info.pCode = code;
 
     checkResult(vkCreateShaderModule(system->getDevice(), &info, nullptr, &shader.module), "Failed to create shader.\n");
-    glslang::FinalizeProcess();
 }
 
 const ShaderStageInfo& Shader::getShader() const
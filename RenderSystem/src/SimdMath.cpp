@@ -0,0 +1,143 @@
+#include<SimdMath.hpp>
+#include<algorithm>
+#include<cmath>
+#if defined(__SSE__) || defined(_M_X64)
+#include<xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#include<immintrin.h>
+#endif
+
+void multiplyMatrices(const glm::mat4& left, const glm::mat4& right, glm::mat4& result)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    // every result column is a combination of the left columns weighted by the right column
+
+    const __m128 left0 = _mm_loadu_ps(&left[0][0]);
+    const __m128 left1 = _mm_loadu_ps(&left[1][0]);
+    const __m128 left2 = _mm_loadu_ps(&left[2][0]);
+    const __m128 left3 = _mm_loadu_ps(&left[3][0]);
+    for(auto column = 0; column < 4; ++column)
+    {
+        const __m128 rightColumn = _mm_loadu_ps(&right[column][0]);
+        __m128 resultColumn = _mm_mul_ps(left0, _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(0, 0, 0, 0)));
+        resultColumn = _mm_add_ps(resultColumn, _mm_mul_ps(left1, _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(1, 1, 1, 1))));
+        resultColumn = _mm_add_ps(resultColumn, _mm_mul_ps(left2, _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(2, 2, 2, 2))));
+        resultColumn = _mm_add_ps(resultColumn, _mm_mul_ps(left3, _mm_shuffle_ps(rightColumn, rightColumn, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_storeu_ps(&result[column][0], resultColumn);
+    }
+#else
+    result = left * right;
+#endif
+}
+
+
+const BoundingVolume transformBoundingVolume(const BoundingVolume& volume, const glm::mat4& matrix)
+{
+    // every axis of the new box spans the absolute projections of the old extents, the sphere grows with the largest scale
+
+    if(volume.radius < 0.0f) return volume;
+    BoundingVolume result;
+    result.center = glm::vec3(matrix * glm::vec4(volume.center, 1.0f));
+    float maxScale = 0.0f;
+    for(auto row = 0; row < 3; ++row)
+    {
+        result.extents[row] = std::fabs(matrix[0][row]) * volume.extents.x + std::fabs(matrix[1][row]) * volume.extents.y + std::fabs(matrix[2][row]) * volume.extents.z;
+        maxScale = std::max(maxScale, glm::length(glm::vec3(matrix[row])));
+    }
+    result.radius = volume.radius * maxScale;
+    return result;
+}
+
+const BoundingVolume mergeBoundingVolumes(const BoundingVolume& first, const BoundingVolume& second)
+{
+    if(first.radius < 0.0f) return second;
+    if(second.radius < 0.0f) return first;
+    const glm::vec3 min = glm::min(first.center - first.extents, second.center - second.extents);
+    const glm::vec3 max = glm::max(first.center + first.extents, second.center + second.extents);
+    BoundingVolume result;
+    result.center = (min + max) * 0.5f;
+    result.extents = (max - min) * 0.5f;
+    result.radius = std::max(glm::length(first.center - result.center) + first.radius, glm::length(second.center - result.center) + second.radius);
+    return result;
+}
+
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planes)
+{
+    // rows of the matrix combined as in Gribb & Hartmann, with 0 <= z <= w for the near and far planes
+
+    const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row2;
+    planes[5] = row3 - row2;
+    for(auto ind = 0; ind < 6; ++ind) planes[ind] /= glm::length(glm::vec3(planes[ind]));
+}
+
+void cullBoundingBoxes(const glm::vec4* planes, const float* const* centers, const float* const* extents, const uint32_t count, uint8_t* visible)
+{
+    // a box is outside once its center is further behind a plane than the box reaches towards it: dot(n, c) + d < -dot(|n|, e)
+
+    uint32_t first = 0;
+#if defined(__AVX__)
+    const __m256 wideSignMask = _mm256_set1_ps(-0.0f);
+    for(; first + 8 <= count; first += 8)
+    {
+        const __m256 centerX = _mm256_loadu_ps(centers[0] + first), centerY = _mm256_loadu_ps(centers[1] + first), centerZ = _mm256_loadu_ps(centers[2] + first);
+        const __m256 extentX = _mm256_loadu_ps(extents[0] + first), extentY = _mm256_loadu_ps(extents[1] + first), extentZ = _mm256_loadu_ps(extents[2] + first);
+        __m256 outside = _mm256_setzero_ps();
+        for(auto plane = 0; plane < 6; ++plane)
+        {
+            const __m256 normalX = _mm256_set1_ps(planes[plane].x), normalY = _mm256_set1_ps(planes[plane].y), normalZ = _mm256_set1_ps(planes[plane].z);
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(normalX, centerX), _mm256_set1_ps(planes[plane].w));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(normalY, centerY));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(normalZ, centerZ));
+            __m256 reach = _mm256_mul_ps(_mm256_andnot_ps(wideSignMask, normalX), extentX);
+            reach = _mm256_add_ps(reach, _mm256_mul_ps(_mm256_andnot_ps(wideSignMask, normalY), extentY));
+            reach = _mm256_add_ps(reach, _mm256_mul_ps(_mm256_andnot_ps(wideSignMask, normalZ), extentZ));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        const int mask = _mm256_movemask_ps(outside);
+        for(auto ind = 0; ind < 8; ++ind) visible[first + ind] = !(mask & (1 << ind));
+    }
+#endif
+#if defined(__SSE__) || defined(_M_X64)
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    for(; first + 4 <= count; first += 4)
+    {
+        const __m128 centerX = _mm_loadu_ps(centers[0] + first), centerY = _mm_loadu_ps(centers[1] + first), centerZ = _mm_loadu_ps(centers[2] + first);
+        const __m128 extentX = _mm_loadu_ps(extents[0] + first), extentY = _mm_loadu_ps(extents[1] + first), extentZ = _mm_loadu_ps(extents[2] + first);
+        __m128 outside = _mm_setzero_ps();
+        for(auto plane = 0; plane < 6; ++plane)
+        {
+            const __m128 normalX = _mm_set1_ps(planes[plane].x), normalY = _mm_set1_ps(planes[plane].y), normalZ = _mm_set1_ps(planes[plane].z);
+            __m128 distance = _mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_set1_ps(planes[plane].w));
+            distance = _mm_add_ps(distance, _mm_mul_ps(normalY, centerY));
+            distance = _mm_add_ps(distance, _mm_mul_ps(normalZ, centerZ));
+            __m128 reach = _mm_mul_ps(_mm_andnot_ps(signMask, normalX), extentX);
+            reach = _mm_add_ps(reach, _mm_mul_ps(_mm_andnot_ps(signMask, normalY), extentY));
+            reach = _mm_add_ps(reach, _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+        const int mask = _mm_movemask_ps(outside);
+        for(auto ind = 0; ind < 4; ++ind) visible[first + ind] = !(mask & (1 << ind));
+    }
+#endif
+    for(; first < count; ++first)
+    {
+        bool outside = false;
+        for(auto plane = 0; plane < 6 && !outside; ++plane)
+        {
+            const glm::vec4& p = planes[plane];
+            const float distance = p.x * centers[0][first] + p.y * centers[1][first] + p.z * centers[2][first] + p.w;
+            const float reach = std::fabs(p.x) * extents[0][first] + std::fabs(p.y) * extents[1][first] + std::fabs(p.z) * extents[2][first];
+            outside = distance + reach < 0.0f;
+        }
+        visible[first] = !outside;
+    }
+}
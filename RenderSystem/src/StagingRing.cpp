@@ -0,0 +1,111 @@
+#include<StagingRing.hpp>
+
+StagingRing::StagingRing(){}
+
+void StagingRing::create(const System* system, const SynchronizationPool* syncPool, MemoryPool* memoryPool, const MemoryAllocation& memory, const VkDeviceSize size, const VkDeviceSize alignment)
+{
+    this->syncPool = syncPool;
+    this->memoryPool = memoryPool;
+    this->memory = memory;
+    this->size = size;
+    this->alignment = alignment;
+    if(size % alignment != 0) reportError("Staging ring size must be a multiple of its alignment.\n");
+    mappedMemory = memoryPool->map(memory);
+    head = tail = 0;
+}
+
+const bool StagingRing::isIdle() const
+{
+    return regions.empty() && !hasPending;
+}
+
+const bool StagingRing::allocate(const VkDeviceSize size, VkDeviceSize& offset)
+{
+    if(size > this->size) reportError("Allocation doesn't fit into staging ring.\n");
+    reclaim();
+    if(isIdle()) head = tail = 0;
+    else if(head == tail) return false;     // full
+
+    VkDeviceSize begin = head % alignment != 0 ? (head / alignment + 1) * alignment : head;
+    bool wrapped = false;
+    if(head >= tail)    // free space is [head, size) and [0, tail)
+    {
+        if(begin + size > this->size)
+        {
+            if(size > tail) return false;
+            begin = 0;
+            wrapped = true;
+        }
+    }
+    else if(begin + size > tail) return false;  // free space is [head, tail)
+
+    if(!hasPending)
+    {
+        pendingBegin = begin;
+        pendingWrapped = false;
+        hasPending = true;
+    }
+    else if(wrapped)
+    {
+        pendingWrapEnd = head;
+        pendingWrapped = true;
+    }
+    head = begin + size;
+    offset = begin;
+    return true;
+}
+
+void* StagingRing::getPtr(const VkDeviceSize offset) const
+{
+    return (char*)mappedMemory + offset;
+}
+
+const VkDeviceSize StagingRing::getSize() const
+{
+    return size;
+}
+
+void StagingRing::flushPending()
+{
+    if(!hasPending) return;
+    auto alignEnd = [this](const VkDeviceSize end)
+    {
+        return end % alignment != 0 ? (end / alignment + 1) * alignment : end;
+    };
+    if(pendingWrapped)
+    {
+        memoryPool->flush(memory, pendingBegin, alignEnd(pendingWrapEnd) - pendingBegin);
+        memoryPool->flush(memory, 0, alignEnd(head));
+    }
+    else memoryPool->flush(memory, pendingBegin, alignEnd(head) - pendingBegin);
+}
+
+void StagingRing::submit(const uint32_t fence)
+{
+    if(!hasPending) return;
+    regions.push_back({head, fence});
+    hasPending = false;
+    pendingWrapped = false;
+}
+
+void StagingRing::reclaim()
+{
+    while(!regions.empty() && syncPool->isFenceSignaled(regions.front().fence))
+    {
+        tail = regions.front().end;
+        regions.pop_front();
+    }
+}
+
+void StagingRing::destroy()
+{
+    mappedMemory = nullptr;
+    regions.clear();
+    hasPending = false;
+    head = tail = 0;
+}
+
+StagingRing::~StagingRing()
+{
+    destroy();
+}
@@ -69,6 +69,13 @@ void SynchronizationPool::resetFences(const uint32_t first, const uint32_t count
     checkResult(vkResetFences(system->getDevice(), count, &fences[first]), "Failed to reset fences.\n");
 }
 
+const bool SynchronizationPool::isFenceSignaled(const uint32_t index) const
+{
+    const VkResult status = vkGetFenceStatus(system->getDevice(), fences[index]);
+    if(status != VK_SUCCESS && status != VK_NOT_READY) checkResult(status, "Failed to get fence status.\n");
+    return status == VK_SUCCESS;
+}
+
 void SynchronizationPool::destroy()
 {
     for(auto ind = 0; ind < fences.size(); ++ind)
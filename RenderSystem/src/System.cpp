@@ -6,14 +6,28 @@ System::System()
 {
 }
 
-void System::create(const Window& window, const bool enableDebug, const VkPhysicalDeviceFeatures& enabledFeatures)
+void System::create(const Window& window, const bool enableDebug, const VkPhysicalDeviceFeatures& enabledFeatures, const VkPhysicalDeviceFeatures& optionalFeatures, const std::vector<const char*>& optionalExtensions)
 {
     uint32_t count;
     const char** ext;
     ext = window.getVulkanExtensions(count);
     createInstance(ext, count, enableDebug);
     surface = window.getVulkanSurface(instance);
-    createDevice(enabledFeatures);
+    createDevice(enabledFeatures, optionalFeatures, optionalExtensions);
+}
+
+const VkPhysicalDeviceFeatures& System::getEnabledFeatures() const
+{
+    return enabledFeatures;
+}
+
+const bool System::isExtensionEnabled(const char* name) const
+{
+    for(const auto& extension : enabledExtensions)
+    {
+        if(extension == name) return true;
+    }
+    return false;
 }
 
 const VkSurfaceCapabilitiesKHR System::getSurfaceCapabilities() const
@@ -38,6 +52,16 @@ const QueueInfo& System::getPresentQueue() const
     return presentQueue;
 }
 
+const QueueInfo& System::getTransferQueue() const
+{
+    return transferQueue;
+}
+
+const bool System::hasDedicatedTransferQueue() const
+{
+    return transferQueue.familyIndex != graphicsQueue.familyIndex;
+}
+
 const QueueInfo& System::getGraphicsQueue() const
 {
     return graphicsQueue;
@@ -118,6 +142,10 @@ void System::pickPhysicalDevice()
     vkEnumeratePhysicalDevices(instance, &count, nullptr);
     Array<VkPhysicalDevice> devices(count);
     vkEnumeratePhysicalDevices(instance, &count, devices.getPtr());
+    // a discrete GPU is preferred, otherwise the first device is used (e.g. an integrated GPU or a software implementation)
+
+    if(!count) reportError("No Vulkan devices found.\n");
+    physicalDevice = devices[0];
     for(uint32_t ind = 0; ind < count; ++ind)
     {
         VkPhysicalDeviceProperties properties;
@@ -162,16 +190,44 @@ void System::pickQueueFamilies()
             }
         }
     }
+
+    // transfer-only families usually map to the DMA engines; any other non-graphics family is the second best choice
+
+    transferQueue.familyIndex = graphicsQueue.familyIndex;
+    for(uint32_t ind = 0; ind < count; ++ind)
+    {
+        const VkQueueFlags flags = properties[ind].queueFlags;
+        if(!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) continue;
+        if(!(flags & VK_QUEUE_COMPUTE_BIT))
+        {
+            transferQueue.familyIndex = ind;
+            break;
+        }
+        if(transferQueue.familyIndex == graphicsQueue.familyIndex) transferQueue.familyIndex = ind;
+    }
 }
 
-void System::createDevice(const VkPhysicalDeviceFeatures& enabledFeatures)
+void System::createDevice(const VkPhysicalDeviceFeatures& requiredFeatures, const VkPhysicalDeviceFeatures& optionalFeatures, const std::vector<const char*>& optionalExtensions)
 {
     pickPhysicalDevice();
     pickQueueFamilies();
 
+    // the feature struct is nothing but VkBool32 members, so it is merged member by member
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    const VkBool32* required = reinterpret_cast<const VkBool32*>(&requiredFeatures);
+    const VkBool32* optional = reinterpret_cast<const VkBool32*>(&optionalFeatures);
+    const VkBool32* supported = reinterpret_cast<const VkBool32*>(&supportedFeatures);
+    VkBool32* enabled = reinterpret_cast<VkBool32*>(&enabledFeatures);
+    for(auto ind = 0; ind < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); ++ind)
+    {
+        enabled[ind] = required[ind] || (optional[ind] && supported[ind]) ? VK_TRUE : VK_FALSE;
+    }
+
     const float queuePriorities[1] = {1};
     uint32_t queueCount = 1;
-    VkDeviceQueueCreateInfo queueInfos[2];
+    VkDeviceQueueCreateInfo queueInfos[3];
     // Graphics queue
     queueInfos[0] = 
     {
@@ -196,9 +252,39 @@ void System::createDevice(const VkPhysicalDeviceFeatures& enabledFeatures)
         };
         queueCount = 2;
     }
+    // Transfer queue
+    if(transferQueue.familyIndex != graphicsQueue.familyIndex && transferQueue.familyIndex != presentQueue.familyIndex)
+    {
+        queueInfos[queueCount] = 
+        {
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            nullptr,
+            0,
+            transferQueue.familyIndex,
+            1,
+            queuePriorities
+        };
+        ++queueCount;
+    }
 
     std::vector<const char*> extensions(1);
     extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    Array<VkExtensionProperties> supportedExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, supportedExtensions.getPtr());
+    for(const char* name : optionalExtensions)
+    {
+        for(auto ind = 0; ind < extensionCount; ++ind)
+        {
+            if(!strcmp(supportedExtensions[ind].extensionName, name))
+            {
+                extensions.push_back(name);
+                break;
+            }
+        }
+    }
+    enabledExtensions.assign(extensions.begin(), extensions.end());
     
     VkDeviceCreateInfo deviceInfo = 
     {
@@ -228,6 +314,14 @@ void System::obtainQueues()
     {
         presentQueue.queue = graphicsQueue.queue;
     }
+    if(transferQueue.familyIndex != graphicsQueue.familyIndex)
+    {
+        vkGetDeviceQueue(device, transferQueue.familyIndex, 0, &transferQueue.queue);
+    }
+    else
+    {
+        transferQueue.queue = graphicsQueue.queue;
+    }
 }
 
 void System::destroy()
@@ -0,0 +1,419 @@
+#include<TextureCompressor.hpp>
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+static const uint32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+static const uint32_t BC7_REFINEMENT_COUNT = 2;
+static const uint32_t POWER_ITERATION_COUNT = 8;
+
+static const float clampChannel(const float value)
+{
+    return std::min(std::max(value, 0.0f), 255.0f);
+}
+
+const uint32_t TextureCompressor::getBlockSize(const VkFormat format)
+{
+    switch(format)
+    {
+        case VkFormat::VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            return 8;
+        case VkFormat::VK_FORMAT_BC3_UNORM_BLOCK:
+        case VkFormat::VK_FORMAT_BC5_UNORM_BLOCK:
+        case VkFormat::VK_FORMAT_BC7_UNORM_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+const uint32_t TextureCompressor::getMipmapLevelCount(const VkExtent2D& extent)
+{
+    uint32_t levelCount = 1;
+    for(auto size = std::max(extent.width, extent.height); size > 1; size /= 2) ++levelCount;
+    return levelCount;
+}
+
+const VkExtent2D TextureCompressor::getMipmapExtent(const VkExtent2D& extent, const uint32_t level)
+{
+    return {std::max(extent.width >> level, 1U), std::max(extent.height >> level, 1U)};
+}
+
+const size_t TextureCompressor::getCompressedSize(const VkFormat format, const VkExtent2D& extent)
+{
+    return static_cast<size_t>((extent.width + 3) / 4) * ((extent.height + 3) / 4) * getBlockSize(format);
+}
+
+void TextureCompressor::compress(const VkFormat format, const unsigned char* pixels, const VkExtent2D& extent, unsigned char* blocks)
+{
+    const uint32_t blockSize = getBlockSize(format);
+    if(!blockSize) reportError("Unsupported block compressed format.\n");
+    const uint32_t blockColumnCount = (extent.width + 3) / 4, blockRowCount = (extent.height + 3) / 4;
+    unsigned char block[64];
+    for(auto row = 0; row < blockRowCount; ++row)
+    {
+        for(auto column = 0; column < blockColumnCount; ++column)
+        {
+            loadBlock(pixels, extent, column * 4, row * 4, block);
+            unsigned char* result = blocks + (static_cast<size_t>(row) * blockColumnCount + column) * blockSize;
+            switch(format)
+            {
+                case VkFormat::VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                    compressBC1(block, result);
+                    break;
+                case VkFormat::VK_FORMAT_BC3_UNORM_BLOCK:
+                    compressBC4(block, 3, result);
+                    compressBC1(block, result + 8);
+                    break;
+                case VkFormat::VK_FORMAT_BC5_UNORM_BLOCK:
+                    compressBC4(block, 0, result);
+                    compressBC4(block, 1, result + 8);
+                    break;
+                default:
+                    compressBC7(block, result);
+                    break;
+            }
+        }
+    }
+}
+
+void TextureCompressor::downsample(const unsigned char* pixels, const VkExtent2D& extent, const bool normalMap, unsigned char* result)
+{
+    // odd rows and columns are dropped, the last texel is reused where the source is only 1 texel wide
+
+    const VkExtent2D nextExtent = getMipmapExtent(extent, 1);
+    for(auto y = 0; y < nextExtent.height; ++y)
+    {
+        const uint32_t rows[2] = {std::min(y * 2U, extent.height - 1), std::min(y * 2U + 1, extent.height - 1)};
+        for(auto x = 0; x < nextExtent.width; ++x)
+        {
+            const uint32_t columns[2] = {std::min(x * 2U, extent.width - 1), std::min(x * 2U + 1, extent.width - 1)};
+            const unsigned char* texels[4] =
+            {
+                pixels + (static_cast<size_t>(rows[0]) * extent.width + columns[0]) * 4,
+                pixels + (static_cast<size_t>(rows[0]) * extent.width + columns[1]) * 4,
+                pixels + (static_cast<size_t>(rows[1]) * extent.width + columns[0]) * 4,
+                pixels + (static_cast<size_t>(rows[1]) * extent.width + columns[1]) * 4
+            };
+            unsigned char* target = result + (static_cast<size_t>(y) * nextExtent.width + x) * 4;
+            const uint32_t firstAveragedChannel = normalMap ? 3 : 0;
+            for(auto channel = firstAveragedChannel; channel < 4; ++channel)
+            {
+                target[channel] = (texels[0][channel] + texels[1][channel] + texels[2][channel] + texels[3][channel] + 2) / 4;
+            }
+            if(!normalMap) continue;
+
+            // averaged normals get shorter where they diverge, a mipmap of unit normals needs them stretched back
+
+            float normal[3] = {};
+            for(auto texel = 0; texel < 4; ++texel)
+            {
+                for(auto channel = 0; channel < 3; ++channel) normal[channel] += texels[texel][channel] / 127.5f - 1.0f;
+            }
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if(length < 1e-6f)
+            {
+                normal[0] = normal[1] = 0;
+                normal[2] = length = 1;
+            }
+            for(auto channel = 0; channel < 3; ++channel) target[channel] = static_cast<unsigned char>(std::lround(clampChannel((normal[channel] / length + 1.0f) * 127.5f)));
+        }
+    }
+}
+
+void TextureCompressor::loadBlock(const unsigned char* pixels, const VkExtent2D& extent, const uint32_t x, const uint32_t y, unsigned char* block)
+{
+    for(auto row = 0; row < 4; ++row)
+    {
+        const size_t sourceRow = std::min(y + row, extent.height - 1);
+        for(auto column = 0; column < 4; ++column)
+        {
+            const size_t sourceColumn = std::min(x + column, extent.width - 1);
+            memcpy(block + (row * 4 + column) * 4, pixels + (sourceRow * extent.width + sourceColumn) * 4, 4);
+        }
+    }
+}
+
+void TextureCompressor::computePrincipalAxis(const unsigned char* block, const uint32_t channelCount, float* mean, float* axis)
+{
+    // power iteration on the covariance matrix, started from the column of the channel that varies the most
+
+    float covariance[4][4] = {};
+    for(auto channel = 0; channel < 4; ++channel)
+    {
+        mean[channel] = 0;
+        axis[channel] = 0;
+    }
+    for(auto texel = 0; texel < 16; ++texel)
+    {
+        for(auto channel = 0; channel < channelCount; ++channel) mean[channel] += block[texel * 4 + channel] / 16.0f;
+    }
+    for(auto texel = 0; texel < 16; ++texel)
+    {
+        float difference[4];
+        for(auto channel = 0; channel < channelCount; ++channel) difference[channel] = block[texel * 4 + channel] - mean[channel];
+        for(auto row = 0; row < channelCount; ++row)
+        {
+            for(auto column = 0; column < channelCount; ++column) covariance[row][column] += difference[row] * difference[column];
+        }
+    }
+    uint32_t largest = 0;
+    for(auto channel = 1; channel < channelCount; ++channel)
+    {
+        if(covariance[channel][channel] > covariance[largest][largest]) largest = channel;
+    }
+    if(covariance[largest][largest] < 1e-3f) return;
+    for(auto channel = 0; channel < channelCount; ++channel) axis[channel] = covariance[channel][largest];
+    for(auto iteration = 0; iteration < POWER_ITERATION_COUNT; ++iteration)
+    {
+        float next[4] = {}, scale = 0;
+        for(auto row = 0; row < channelCount; ++row)
+        {
+            for(auto column = 0; column < channelCount; ++column) next[row] += covariance[row][column] * axis[column];
+            scale = std::max(scale, std::fabs(next[row]));
+        }
+        if(scale < 1e-6f) break;
+        for(auto channel = 0; channel < channelCount; ++channel) axis[channel] = next[channel] / scale;
+    }
+    float length = 0;
+    for(auto channel = 0; channel < channelCount; ++channel) length += axis[channel] * axis[channel];
+    length = std::sqrt(length);
+    for(auto channel = 0; channel < channelCount; ++channel) axis[channel] /= length;
+}
+
+void TextureCompressor::compressBC1(const unsigned char* block, unsigned char* result)
+{
+    // endpoints are the block's extremes along its principal axis, always ordered for the 4 color mode
+
+    float mean[4], axis[4], minProjection = 0, maxProjection = 0;
+    computePrincipalAxis(block, 3, mean, axis);
+    for(auto texel = 0; texel < 16; ++texel)
+    {
+        float projection = 0;
+        for(auto channel = 0; channel < 3; ++channel) projection += (block[texel * 4 + channel] - mean[channel]) * axis[channel];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    uint32_t colors[2];
+    for(auto endpoint = 0; endpoint < 2; ++endpoint)
+    {
+        const float projection = endpoint ? minProjection : maxProjection;
+        const uint32_t red = std::lround(clampChannel(mean[0] + projection * axis[0]) * 31 / 255);
+        const uint32_t green = std::lround(clampChannel(mean[1] + projection * axis[1]) * 63 / 255);
+        const uint32_t blue = std::lround(clampChannel(mean[2] + projection * axis[2]) * 31 / 255);
+        colors[endpoint] = (red << 11) | (green << 5) | blue;
+    }
+    if(colors[0] < colors[1]) std::swap(colors[0], colors[1]);
+
+    uint32_t indices = 0;
+    if(colors[0] != colors[1])
+    {
+        int32_t palette[4][3];
+        for(auto endpoint = 0; endpoint < 2; ++endpoint)
+        {
+            const uint32_t red = colors[endpoint] >> 11, green = (colors[endpoint] >> 5) & 63, blue = colors[endpoint] & 31;
+            palette[endpoint][0] = (red << 3) | (red >> 2);
+            palette[endpoint][1] = (green << 2) | (green >> 4);
+            palette[endpoint][2] = (blue << 3) | (blue >> 2);
+        }
+        for(auto channel = 0; channel < 3; ++channel)
+        {
+            palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+        for(auto texel = 0; texel < 16; ++texel)
+        {
+            uint32_t bestIndex = 0, bestError = ~0U;
+            for(auto index = 0; index < 4; ++index)
+            {
+                uint32_t error = 0;
+                for(auto channel = 0; channel < 3; ++channel)
+                {
+                    const int32_t difference = block[texel * 4 + channel] - palette[index][channel];
+                    error += difference * difference;
+                }
+                if(error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = index;
+                }
+            }
+            indices |= bestIndex << (texel * 2);
+        }
+    }
+    result[0] = colors[0] & 0xFF;
+    result[1] = colors[0] >> 8;
+    result[2] = colors[1] & 0xFF;
+    result[3] = colors[1] >> 8;
+    for(auto byte = 0; byte < 4; ++byte) result[4 + byte] = (indices >> (byte * 8)) & 0xFF;
+}
+
+void TextureCompressor::compressBC4(const unsigned char* block, const uint32_t channel, unsigned char* result)
+{
+    // the 8 value mode between the block's minimum and maximum
+
+    uint32_t minimum = 255, maximum = 0;
+    for(auto texel = 0; texel < 16; ++texel)
+    {
+        minimum = std::min(minimum, static_cast<uint32_t>(block[texel * 4 + channel]));
+        maximum = std::max(maximum, static_cast<uint32_t>(block[texel * 4 + channel]));
+    }
+    result[0] = maximum;
+    result[1] = minimum;
+    uint64_t indices = 0;
+    if(maximum != minimum)
+    {
+        int32_t palette[8] = {static_cast<int32_t>(maximum), static_cast<int32_t>(minimum)};
+        for(auto index = 2; index < 8; ++index) palette[index] = ((8 - index) * maximum + (index - 1) * minimum) / 7;
+        for(auto texel = 0; texel < 16; ++texel)
+        {
+            uint32_t bestIndex = 0;
+            for(auto index = 1; index < 8; ++index)
+            {
+                if(std::abs(block[texel * 4 + channel] - palette[index]) < std::abs(block[texel * 4 + channel] - palette[bestIndex])) bestIndex = index;
+            }
+            indices |= static_cast<uint64_t>(bestIndex) << (texel * 3);
+        }
+    }
+    for(auto byte = 0; byte < 6; ++byte) result[2 + byte] = (indices >> (byte * 8)) & 0xFF;
+}
+
+void TextureCompressor::compressBC7(const unsigned char* block, unsigned char* result)
+{
+    // endpoints start at the extremes along the principal axis and are refitted to the chosen indices by least squares
+
+    float mean[4], axis[4], minProjection = 0, maxProjection = 0;
+    computePrincipalAxis(block, 4, mean, axis);
+    for(auto texel = 0; texel < 16; ++texel)
+    {
+        float projection = 0;
+        for(auto channel = 0; channel < 4; ++channel) projection += (block[texel * 4 + channel] - mean[channel]) * axis[channel];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float endpoints[2][4];
+    for(auto channel = 0; channel < 4; ++channel)
+    {
+        endpoints[0][channel] = clampChannel(mean[channel] + minProjection * axis[channel]);
+        endpoints[1][channel] = clampChannel(mean[channel] + maxProjection * axis[channel]);
+    }
+    BC7Block encoded;
+    quantizeBC7Endpoint(endpoints[0], encoded.endpoints[0], encoded.pBits[0]);
+    quantizeBC7Endpoint(endpoints[1], encoded.endpoints[1], encoded.pBits[1]);
+    uint32_t error = fitBC7Indices(block, encoded);
+    for(auto refinement = 0; refinement < BC7_REFINEMENT_COUNT && error; ++refinement)
+    {
+        float squaredStart = 0, squaredEnd = 0, mixed = 0, startSums[4] = {}, endSums[4] = {};
+        for(auto texel = 0; texel < 16; ++texel)
+        {
+            const float weight = BC7_WEIGHTS[encoded.indices[texel]] / 64.0f;
+            squaredStart += (1 - weight) * (1 - weight);
+            squaredEnd += weight * weight;
+            mixed += weight * (1 - weight);
+            for(auto channel = 0; channel < 4; ++channel)
+            {
+                startSums[channel] += (1 - weight) * block[texel * 4 + channel];
+                endSums[channel] += weight * block[texel * 4 + channel];
+            }
+        }
+        const float determinant = squaredStart * squaredEnd - mixed * mixed;
+        if(std::fabs(determinant) < 1e-6f) break;
+        for(auto channel = 0; channel < 4; ++channel)
+        {
+            endpoints[0][channel] = clampChannel((squaredEnd * startSums[channel] - mixed * endSums[channel]) / determinant);
+            endpoints[1][channel] = clampChannel((squaredStart * endSums[channel] - mixed * startSums[channel]) / determinant);
+        }
+        BC7Block refined;
+        quantizeBC7Endpoint(endpoints[0], refined.endpoints[0], refined.pBits[0]);
+        quantizeBC7Endpoint(endpoints[1], refined.endpoints[1], refined.pBits[1]);
+        const uint32_t refinedError = fitBC7Indices(block, refined);
+        if(refinedError >= error) break;
+        encoded = refined;
+        error = refinedError;
+    }
+
+    // the first index is stored without its high bit, so it has to be in the lower half of the palette
+
+    if(encoded.indices[0] & 8)
+    {
+        for(auto channel = 0; channel < 4; ++channel) std::swap(encoded.endpoints[0][channel], encoded.endpoints[1][channel]);
+        std::swap(encoded.pBits[0], encoded.pBits[1]);
+        for(auto texel = 0; texel < 16; ++texel) encoded.indices[texel] = 15 - encoded.indices[texel];
+    }
+
+    memset(result, 0, 16);
+    uint32_t position = 0;
+    auto writeBits = [result, &position](const uint32_t value, const uint32_t count)
+    {
+        for(auto bit = 0; bit < count; ++bit, ++position)
+        {
+            if((value >> bit) & 1) result[position / 8] |= 1 << (position % 8);
+        }
+    };
+    writeBits(1 << 6, 7);
+    for(auto channel = 0; channel < 4; ++channel)
+    {
+        writeBits(encoded.endpoints[0][channel], 7);
+        writeBits(encoded.endpoints[1][channel], 7);
+    }
+    writeBits(encoded.pBits[0], 1);
+    writeBits(encoded.pBits[1], 1);
+    writeBits(encoded.indices[0], 3);
+    for(auto texel = 1; texel < 16; ++texel) writeBits(encoded.indices[texel], 4);
+}
+
+void TextureCompressor::quantizeBC7Endpoint(const float* endpoint, uint32_t* quantized, uint32_t& pBit)
+{
+    // the p-bit is the lowest bit of all 4 channels, whichever reproduces them better is kept
+
+    float bestError = -1;
+    for(uint32_t bit = 0; bit < 2; ++bit)
+    {
+        uint32_t channels[4];
+        float error = 0;
+        for(auto channel = 0; channel < 4; ++channel)
+        {
+            channels[channel] = std::min(static_cast<uint32_t>(std::max(std::lround((endpoint[channel] - bit) / 2), 0L)), 127U);
+            const float difference = static_cast<float>((channels[channel] << 1) | bit) - endpoint[channel];
+            error += difference * difference;
+        }
+        if(bestError < 0 || error < bestError)
+        {
+            bestError = error;
+            pBit = bit;
+            for(auto channel = 0; channel < 4; ++channel) quantized[channel] = channels[channel];
+        }
+    }
+}
+
+const uint32_t TextureCompressor::fitBC7Indices(const unsigned char* block, BC7Block& encoded)
+{
+    int32_t palette[16][4];
+    for(auto channel = 0; channel < 4; ++channel)
+    {
+        const uint32_t start = (encoded.endpoints[0][channel] << 1) | encoded.pBits[0], end = (encoded.endpoints[1][channel] << 1) | encoded.pBits[1];
+        for(auto index = 0; index < 16; ++index) palette[index][channel] = ((64 - BC7_WEIGHTS[index]) * start + BC7_WEIGHTS[index] * end + 32) >> 6;
+    }
+    uint32_t totalError = 0;
+    for(auto texel = 0; texel < 16; ++texel)
+    {
+        uint32_t bestIndex = 0, bestError = ~0U;
+        for(auto index = 0; index < 16; ++index)
+        {
+            uint32_t error = 0;
+            for(auto channel = 0; channel < 4; ++channel)
+            {
+                const int32_t difference = block[texel * 4 + channel] - palette[index][channel];
+                error += difference * difference;
+            }
+            if(error < bestError)
+            {
+                bestError = error;
+                bestIndex = index;
+            }
+        }
+        encoded.indices[texel] = bestIndex;
+        totalError += bestError;
+    }
+    return totalError;
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include<ThreadPool.hpp>
+
+ThreadPool::ThreadPool(){}
+
+void ThreadPool::create(const uint32_t threadCount)
+{
+    uint32_t count = threadCount;
+    if(count == 0) count = std::thread::hardware_concurrency();
+    if(count == 0) count = 1;
+    stopping = false;
+    threads.reserve(count);
+    for(auto ind = 0; ind < count; ++ind)
+    {
+        threads.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+const uint32_t ThreadPool::getThreadCount() const
+{
+    return threads.size();
+}
+
+void ThreadPool::enqueue(std::function<void()>&& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsFinished.wait(lock, [this]{ return jobs.empty() && runningJobCount == 0; });
+    if(firstException)
+    {
+        std::exception_ptr exception = firstException;
+        firstException = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void ThreadPool::work()
+{
+    while(true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this]{ return stopping || !jobs.empty(); });
+            if(jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            ++runningJobCount;
+        }
+
+        // a failed job must not take the worker down, the error is handed to whoever waits
+
+        std::exception_ptr exception;
+        try
+        {
+            job();
+        }
+        catch(...)
+        {
+            exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(exception && !firstException) firstException = exception;
+            --runningJobCount;
+        }
+        jobsFinished.notify_all();
+    }
+}
+
+void ThreadPool::destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for(auto& thread : threads)
+    {
+        if(thread.joinable()) thread.join();
+    }
+    threads.clear();
+    jobs.clear();
+    firstException = nullptr;
+}
+
+ThreadPool::~ThreadPool()
+{
+    destroy();
+}
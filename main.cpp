@@ -1,20 +1,91 @@
 #include<Renderer.hpp>
 #include<chrono>
+#include<cstdlib>
+#include<cstring>
 #include<iostream>
 
-int main()
+// renders frameCount frames as fast as possible and returns the average frame time in milliseconds
+
+static double benchmark(const Window& window, const std::vector<std::string>& scenes, const std::string& imagePath, const MeshLoadOptions& meshOptions, const bool indirectDraws, const bool gpuCulling, const uint32_t frameCount, double& bytesPerVertex)
+{
+    static const uint32_t WARMUP_FRAME_COUNT = 30;
+    Renderer renderer;
+    renderer.create(window, scenes, imagePath, meshOptions, indirectDraws, gpuCulling);
+    uint64_t vertexBytes = 0, vertexCount = 0;
+    const Scene& scene = renderer.getScene(0);
+    for(auto ind = 0; ind < scene.getMeshCount(); ++ind)
+    {
+        vertexBytes += scene.getMesh(ind).getVertexBuffer().size;
+        vertexCount += scene.getMesh(ind).getVertexCount();
+    }
+    bytesPerVertex = vertexCount ? static_cast<double>(vertexBytes) / vertexCount : 0;
+
+    std::chrono::steady_clock::time_point begin;
+    for(auto frame = 0; frame < WARMUP_FRAME_COUNT + frameCount; ++frame)
+    {
+        if(frame == WARMUP_FRAME_COUNT) begin = std::chrono::steady_clock::now();
+        glfwPollEvents();
+        renderer.beginRendering();
+        renderer.renderSceneNode(renderer.getScene(0), renderer.getScene(0)["Cylinder"]);
+        renderer.endRendering();
+    }
+    const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - begin;
+    renderer.destroy();
+    return duration.count() / frameCount;
+}
+
+int main(int argc, char** argv)
 {
+    // --packed renders with quantized vertices, --optimize-meshes reorders them for the vertex cache, --lod adds simplified levels of every mesh, --meshlets culls meshes in parts,
+    // --compressed-textures keeps textures block compressed (the texture log line compares upload and memory sizes), --texture-cache reuses mipmaps filtered on the CPU,
+    // --scene-cache maps the scene with its built meshes from a file next to it instead of importing it (the scene log lines time both),
+    // --indirect records one indirect draw per bucket of draws, --gpu-culling culls them in a compute pass instead of on the CPU,
+    // --benchmark [frames] compares both vertex layouts and exits; R reloads the textures from disk while rendering
+
+    MeshLoadOptions meshOptions;
+    bool indirectDraws = false;
+    bool gpuCulling = false;
+    uint32_t benchmarkFrameCount = 0;
+    for(auto ind = 1; ind < argc; ++ind)
+    {
+        if(!strcmp(argv[ind], "--packed")) meshOptions.packedVertices = true;
+        else if(!strcmp(argv[ind], "--optimize-meshes")) meshOptions.optimizeVertexCache = true;
+        else if(!strcmp(argv[ind], "--lod")) meshOptions.generateLevelsOfDetail = true;
+        else if(!strcmp(argv[ind], "--meshlets")) meshOptions.buildMeshlets = true;
+        else if(!strcmp(argv[ind], "--compressed-textures")) meshOptions.compressTextures = true;
+        else if(!strcmp(argv[ind], "--texture-cache")) meshOptions.cacheTextures = true;
+        else if(!strcmp(argv[ind], "--scene-cache")) meshOptions.cacheScene = true;
+        else if(!strcmp(argv[ind], "--indirect")) indirectDraws = true;
+        else if(!strcmp(argv[ind], "--gpu-culling")) gpuCulling = true;
+        else if(!strcmp(argv[ind], "--benchmark")) benchmarkFrameCount = (ind + 1 < argc && atoi(argv[ind + 1]) > 0) ? atoi(argv[++ind]) : 1000;
+    }
     glfwInit();
     Window window;
     VkExtent2D windowExtent = {1366, 768};
     window.create("TEST", windowExtent);
-    Renderer renderer;
     std::vector<std::string> scenes = {"Models/WoodenCup.dae"};
     std::string imagePath = "Models/";
-    renderer.create(window, scenes, imagePath);
+    if(benchmarkFrameCount)
+    {
+        double floatBytesPerVertex, packedBytesPerVertex;
+        MeshLoadOptions floatOptions = meshOptions, packedOptions = meshOptions;
+        floatOptions.packedVertices = false;
+        packedOptions.packedVertices = true;
+        const double floatFrameTime = benchmark(window, scenes, imagePath, floatOptions, indirectDraws, gpuCulling, benchmarkFrameCount, floatBytesPerVertex);
+        const double packedFrameTime = benchmark(window, scenes, imagePath, packedOptions, indirectDraws, gpuCulling, benchmarkFrameCount, packedBytesPerVertex);
+        std::cout << "float vertices:  " << floatBytesPerVertex << " bytes per vertex, " << floatFrameTime << " ms per frame\n";
+        std::cout << "packed vertices: " << packedBytesPerVertex << " bytes per vertex, " << packedFrameTime << " ms per frame\n";
+        std::cout << "frame time delta: " << packedFrameTime - floatFrameTime << " ms\n";
+        window.destroy();
+        glfwTerminate();
+        return 0;
+    }
+    Renderer renderer;
+    renderer.create(window, scenes, imagePath, meshOptions, indirectDraws, gpuCulling);
     std::chrono::system_clock::time_point begin = std::chrono::system_clock::now();
     float fps = 1 / 5.0f;
     float passedTime = 0;
+    bool reloadPressed = false;
     //const auto& map = renderer.getScene(0).getRootNode().getChildrenNodes();
     //std::cout << (*map.at("Cylinder").getChildrenNodes().begin()).first << "<-Size\n";
     //for(const auto& kv : map) std::cout << kv.first << '\n';
@@ -26,10 +97,13 @@ int main()
         passedTime += duration.count();
         //std::cout << passedTime << '\n';
         begin = end;
+        const bool reloadDown = glfwGetKey(window.getWindow(), GLFW_KEY_R) == GLFW_PRESS;
+        if(reloadDown && !reloadPressed) renderer.reloadTextures(0);
+        reloadPressed = reloadDown;
         if(passedTime > fps)
         {
             renderer.beginRendering();
-            renderer.renderSceneNode(renderer.getScene(0)["Cylinder"]);
+            renderer.renderSceneNode(renderer.getScene(0), renderer.getScene(0)["Cylinder"]);
             renderer.endRendering();
             passedTime -= fps;
         }